@@ -0,0 +1,264 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "bvh.hpp"
+#include "frustum-culler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::pair;
+using std::size_t;
+using std::uint32_t;
+using std::vector;
+
+using glm::mat4;
+using glm::vec3;
+using glm::vec4;
+
+using steadyclock = std::chrono::steady_clock;
+using milliseconds = std::chrono::duration<float, std::milli>;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    int const QUERIES = 1000;
+
+    float const INFINITE = std::numeric_limits<float>::infinity();
+
+    // Six planes facing into a box far larger than any scene below
+    vec4 const EVERYWHERE[6] = {
+            {1.0f, 0.0f, 0.0f, 1e30f}, {-1.0f, 0.0f, 0.0f, 1e30f},
+            {0.0f, 1.0f, 0.0f, 1e30f}, {0.0f, -1.0f, 0.0f, 1e30f},
+            {0.0f, 0.0f, 1.0f, 1e30f}, {0.0f, 0.0f, -1.0f, 1e30f}};
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    using Ray = pair<vec3, vec3>;
+
+    // Random boxes spread like a large flat scene
+    vector<Aabb> flatScene(size_t const count, std::mt19937 &random) {
+        std::uniform_real_distribution<float> across(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> height(-5.0f, 5.0f);
+        std::uniform_real_distribution<float> halfSize(0.25f, 1.0f);
+
+        vector<Aabb> boxes(count);
+        for (Aabb &box : boxes) {
+            vec3 const center(across(random), height(random), across(random));
+            vec3 const extent(halfSize(random));
+            box = {center - extent, center + extent};
+        }
+        return boxes;
+    }
+
+    // Boxes whose spacing grows exponentially along every axis, so the
+    // heuristic keeps splitting off a few items at a time
+    vector<Aabb> skewedScene(size_t const count, std::mt19937 &random) {
+        std::uniform_real_distribution<float> exponent(0.0f, 40.0f);
+
+        vector<Aabb> boxes(count);
+        for (Aabb &box : boxes) {
+            vec3 const center(std::exp2(exponent(random)),
+                              std::exp2(exponent(random)),
+                              std::exp2(exponent(random)));
+            vec3 const extent = center * 1e-3f;
+            box = {center - extent, center + extent};
+        }
+        return boxes;
+    }
+
+    // Nearest entry over every box; the same slab test as Bvh::raycast
+    float bruteForceRaycast(vector<Aabb> const &boxes, Ray const &ray) {
+        vec3 const inverse = 1.0f / ray.second;
+        float nearest = INFINITE;
+        for (Aabb const &box : boxes) {
+            vec3 const t0 = (box.min - ray.first) * inverse;
+            vec3 const t1 = (box.max - ray.first) * inverse;
+            vec3 const entry = glm::min(t0, t1);
+            vec3 const exit = glm::max(t0, t1);
+            float const enter = std::max(std::max(entry.x, entry.y),
+                                         std::max(entry.z, 0.0f));
+            float const leave = std::min(std::min(exit.x, exit.y), exit.z);
+            if (enter <= leave && enter < nearest) {
+                nearest = enter;
+            }
+        }
+        return nearest;
+    }
+
+    // Rays from above the scene's bounds towards random boxes, so most
+    // of them hit something however the scene is spread
+    vector<Ray> randomRays(vector<Aabb> const &boxes, std::mt19937 &random) {
+        Aabb bounds = Aabb::empty();
+        for (Aabb const &box : boxes) {
+            bounds.extend(box);
+        }
+        std::uniform_real_distribution<float> tilt(-0.5f, 0.5f);
+
+        vector<Ray> rays(QUERIES);
+        for (Ray &ray : rays) {
+            vec3 const target = boxes[random() % boxes.size()].center();
+            vec3 const up = glm::normalize(
+                    vec3(tilt(random), 1.0f, tilt(random)));
+            ray.first = target + up * (bounds.max.y - target.y + 1.0f);
+            ray.second = -up;
+        }
+        return rays;
+    }
+
+    // Counts the broken invariants: a tree deeper than the traversal
+    // stacks, items that a frustum around everything misses or reaches
+    // twice, and rays that disagree with a scan over every box
+    size_t invariantFailures(Bvh const &bvh, vector<Aabb> const &boxes,
+                             vector<Ray> const &rays) {
+        size_t failures = 0;
+        if (bvh.statistics().depth > static_cast<size_t>(Bvh::STACK_SIZE)) {
+            cerr << "  depth " << bvh.statistics().depth
+                 << " exceeds the traversal stack" << endl;
+            ++failures;
+        }
+
+        vector<uint32_t> reached;
+        bvh.frustumQuery(EVERYWHERE, reached);
+        std::sort(reached.begin(), reached.end());
+        bool everyItemOnce = reached.size() == boxes.size();
+        for (size_t i = 0; everyItemOnce && i < reached.size(); ++i) {
+            everyItemOnce = reached[i] == i;
+        }
+        if (!everyItemOnce) {
+            cerr << "  " << reached.size() << " of " << boxes.size()
+                 << " items reached, or some twice" << endl;
+            ++failures;
+        }
+
+        size_t mismatches = 0;
+        for (Ray const &ray : rays) {
+            uint32_t item;
+            float distance;
+            bool const hit = bvh.raycast(ray.first, ray.second, item,
+                                         distance);
+            float const expected = bruteForceRaycast(boxes, ray);
+            if (hit != (expected < INFINITE) ||
+                (hit && distance != expected)) {
+                ++mismatches;
+            }
+        }
+        if (mismatches > 0) {
+            cerr << "  " << mismatches << " rays disagree with the scan"
+                 << endl;
+            ++failures;
+        }
+        return failures;
+    }
+
+    // Returns whether every invariant holds, before and after moving
+    // items around
+    bool check(char const *name, vector<Aabb> boxes, std::mt19937 &random) {
+        vector<Ray> const rays = randomRays(boxes, random);
+
+        // '''''''''''''''''''''''''''''''''''''''''''''''''''' Maintenance
+        Bvh bvh;
+        auto startTime = steadyclock::now();
+        bvh.build(boxes);
+        milliseconds const build = steadyclock::now() - startTime;
+        size_t failures = invariantFailures(bvh, boxes, rays);
+
+        startTime = steadyclock::now();
+        bvh.refit();
+        milliseconds const refit = steadyclock::now() - startTime;
+
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        startTime = steadyclock::now();
+        for (int i = 0; i < QUERIES; ++i) {
+            uint32_t const item =
+                    static_cast<uint32_t>(random() % boxes.size());
+            Aabb &box = boxes[item];
+            vec3 const offset = (box.max - box.min) *
+                                vec3(unit(random), 0.0f, unit(random));
+            box = {box.min + offset, box.max + offset};
+            bvh.update(item, box);
+        }
+        milliseconds const updates = steadyclock::now() - startTime;
+        failures += invariantFailures(bvh, boxes, rays);
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Queries
+        vec3 const eye(-60.0f, 10.0f, -60.0f);
+        mat4 const vp = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f,
+                                         0.1f, 100.0f) *
+                        glm::lookAt(eye, vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+        vec4 planes[6];
+        extractFrustumPlanes(vp, planes);
+
+        vector<uint32_t> visible;
+        startTime = steadyclock::now();
+        bvh.frustumQuery(planes, visible);
+        milliseconds const query = steadyclock::now() - startTime;
+
+        FrustumCuller linear;
+        for (Aabb const &box : boxes) {
+            linear.add(box.min, box.max,
+                       glm::length(box.max - box.min) * 0.5f, mat4(1.0f));
+        }
+        startTime = steadyclock::now();
+        linear.cull(vp);
+        milliseconds const scan = steadyclock::now() - startTime;
+
+        int hits = 0;
+        startTime = steadyclock::now();
+        for (Ray const &ray : rays) {
+            uint32_t item;
+            float distance;
+            hits += bvh.raycast(ray.first, ray.second, item, distance);
+        }
+        milliseconds const cast = steadyclock::now() - startTime;
+
+        int linearHits = 0;
+        startTime = steadyclock::now();
+        for (Ray const &ray : rays) {
+            linearHits += bruteForceRaycast(boxes, ray) < INFINITE;
+        }
+        milliseconds const linearCast = steadyclock::now() - startTime;
+
+        Bvh::Statistics const stats = bvh.statistics();
+        cout << name << ", " << boxes.size() << " boxes: " << stats.nodes
+             << " nodes, depth " << stats.depth << endl
+             << "  build " << build.count() << " ms, refit "
+             << refit.count() << " ms, " << QUERIES << " updates "
+             << updates.count() << " ms" << endl
+             << "  frustum " << query.count() << " ms (" << visible.size()
+             << " visible), linear " << scan.count() << " ms ("
+             << linear.visibleCount() << " visible)" << endl
+             << "  " << QUERIES << " rays " << cast.count() << " ms ("
+             << hits << " hits), linear " << linearCast.count() << " ms ("
+             << linearHits << " hits)" << endl;
+
+        if (failures > 0) {
+            cerr << name << ": FAILED" << endl;
+        }
+        return failures == 0;
+    }
+}
+
+// //////////////////////////////////////////////////////////////// Main //
+// Times the hierarchy against linear scans and checks its invariants on
+// random scenes. Exits with a failure when any invariant is broken.
+int main() {
+    std::mt19937 random(216920);
+    bool passed = true;
+    for (size_t const count : {10000, 30000, 100000}) {
+        passed &= check("flat scene", flatScene(count, random), random);
+    }
+    passed &= check("skewed scene", skewedScene(30000, random), random);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,110 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "scene-graph.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::size_t;
+using std::vector;
+
+using glm::mat4;
+using glm::vec3;
+
+using steadyclock = std::chrono::steady_clock;
+using microseconds = std::chrono::duration<float, std::micro>;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    int const FRAMES = 1000;
+    int const SCATTERED_MOVES = 100;
+
+    // The pivot and its one child
+    size_t const CHAIN_LENGTH = 2;
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    // Whether every world matrix is its parent's times its local one
+    bool consistent(SceneGraph const &graph) {
+        for (SceneGraph::NodeId node = 1; node < graph.size(); ++node) {
+            mat4 const expected =
+                    graph.world(graph.parent(node)) * graph.local(node);
+            if (graph.world(node) != expected) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Returns whether every bound holds
+    bool check(SceneGraph::NodeId const count, std::mt19937 &random) {
+        // Each node hangs off a random earlier one, so the graph gets
+        // both deep chains and wide fans
+        SceneGraph graph;
+        vector<SceneGraph::NodeId> nodes = {SceneGraph::ROOT};
+        nodes.reserve(count + 1);
+        for (SceneGraph::NodeId i = 0; i < count; ++i) {
+            nodes.push_back(graph.add(
+                    nodes[random() % nodes.size()],
+                    glm::translate(mat4(1.0f), vec3(1.0f, 0.0f, 0.0f))));
+        }
+        SceneGraph::NodeId const pivot = graph.add(SceneGraph::ROOT);
+        graph.add(pivot, glm::translate(mat4(1.0f), vec3(25.0f, 5.0f, 0.0f)));
+        graph.update();
+
+        // '''''''''''''''''''''''''''''''''''''''''''''''''''' Moving chain
+        size_t wrongChanges = 0;
+        auto startTime = steadyclock::now();
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            graph.setLocal(pivot, glm::rotate(mat4(1.0f), 0.01f * frame,
+                                              vec3(0.0f, 1.0f, 0.0f)));
+            wrongChanges += graph.update().size() != CHAIN_LENGTH;
+        }
+        microseconds const chain = steadyclock::now() - startTime;
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''' Scattered moves
+        startTime = steadyclock::now();
+        for (int i = 0; i < SCATTERED_MOVES; ++i) {
+            graph.setLocal(nodes[random() % nodes.size()],
+                           glm::translate(mat4(1.0f), vec3(0.0f, 1.0f, 0.0f)));
+        }
+        size_t const changed = graph.update().size();
+        microseconds const scattered = steadyclock::now() - startTime;
+
+        bool const worldsMatch = consistent(graph);
+        cout << count << " nodes: moving one chain "
+             << chain.count() / FRAMES << " us per frame, "
+             << SCATTERED_MOVES << " scattered moves " << scattered.count()
+             << " us (" << changed << " nodes updated), " << wrongChanges
+             << " frames updating more than the chain" << endl;
+
+        bool const passed = wrongChanges == 0 && worldsMatch;
+        if (!passed) {
+            cerr << count << " nodes: FAILED" << endl;
+        }
+        return passed;
+    }
+}
+
+// //////////////////////////////////////////////////////////////// Main //
+// Times frames that move one two-node chain in graphs of otherwise static
+// nodes, and one frame that moves nodes all over the graph. Exits with a
+// failure when a frame recomputes more than what moved, or a world
+// matrix disagrees with its parent's.
+int main() {
+    std::mt19937 random(216920);
+    bool passed = true;
+    for (SceneGraph::NodeId const count : {1000u, 100000u, 1000000u}) {
+        passed &= check(count, random);
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
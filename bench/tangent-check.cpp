@@ -0,0 +1,166 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "tangent-generator.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::size_t;
+using std::vector;
+
+using glm::vec2;
+using glm::vec3;
+using glm::vec4;
+
+using steadyclock = std::chrono::steady_clock;
+using milliseconds = std::chrono::duration<float, std::milli>;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    float const PI = 3.14159265358979f;
+
+    // Frames are orthonormalised in single precision
+    float const MAX_NORMAL_DOT = 1e-4f;
+    float const MAX_LENGTH_ERROR = 1e-4f;
+
+    // Large enough for the triangle and vertex passes to use the pool
+    int const BENCH_RINGS = 512;
+    int const BENCH_SEGMENTS = 1024;
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    struct TestMesh {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        // By vertex, the sign w must have
+        vector<float> handedness;
+    };
+
+    Vertex vertex(vec3 const &position, vec3 const &normal,
+                  vec2 const &texCoords) {
+        Vertex result = {};
+        result.position = position;
+        result.normal = normal;
+        result.texCoords = texCoords;
+        return result;
+    }
+
+    void addQuads(TestMesh &mesh, size_t const first, int const columns,
+                  int const rows) {
+        for (int row = 0; row < rows; ++row) {
+            for (int column = 0; column < columns; ++column) {
+                auto const corner = [&](int const x, int const y) {
+                    return static_cast<unsigned int>(
+                            first + (row + y) * (columns + 1) + column + x);
+                };
+                mesh.indices.insert(mesh.indices.end(),
+                                    {corner(0, 0), corner(1, 0),
+                                     corner(1, 1), corner(0, 0),
+                                     corner(1, 1), corner(0, 1)});
+            }
+        }
+    }
+
+    // Unit sphere between the polar caps, u around and v up, so tangents
+    // follow the parallels and the frame is right-handed
+    TestMesh sphere(int const rings, int const segments) {
+        TestMesh mesh;
+        for (int ring = 0; ring <= rings; ++ring) {
+            float const latitude =
+                    (-0.45f + 0.9f * ring / rings) * PI;
+            for (int segment = 0; segment <= segments; ++segment) {
+                float const longitude = 2.0f * PI * segment / segments;
+                vec3 const normal(std::cos(latitude) * std::cos(longitude),
+                                  std::sin(latitude),
+                                  -std::cos(latitude) * std::sin(longitude));
+                mesh.vertices.push_back(vertex(
+                        normal, normal,
+                        vec2(static_cast<float>(segment) / segments,
+                             static_cast<float>(ring) / rings)));
+                mesh.handedness.push_back(1.0f);
+            }
+        }
+        addQuads(mesh, 0, segments, rings);
+        return mesh;
+    }
+
+    // Flat grid facing +Z whose left half mirrors u, as tools lay out
+    // symmetric models; the halves do not share vertices
+    TestMesh mirroredGrid(int const size) {
+        TestMesh mesh;
+        for (int half = 0; half < 2; ++half) {
+            size_t const first = mesh.vertices.size();
+            float const side = half == 0 ? 1.0f : -1.0f;
+            for (int y = 0; y <= size; ++y) {
+                for (int x = 0; x <= size; ++x) {
+                    float const u = static_cast<float>(x) / size,
+                                v = static_cast<float>(y) / size;
+                    mesh.vertices.push_back(vertex(
+                            vec3(side * u, v, 0.0f), vec3(0.0f, 0.0f, 1.0f),
+                            vec2(u, v)));
+                    mesh.handedness.push_back(side);
+                }
+            }
+            addQuads(mesh, first, size, size);
+
+            // Mirroring flips the winding too; keep the faces outward
+            if (half == 1) {
+                for (size_t i = mesh.indices.size() - size * size * 6;
+                     i < mesh.indices.size(); i += 3) {
+                    std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // Returns whether every bound holds
+    bool check(char const *name, TestMesh mesh) {
+        auto const startTime = steadyclock::now();
+        size_t const fallbacks =
+                generateTangents(mesh.vertices, mesh.indices);
+        milliseconds const time = steadyclock::now() - startTime;
+
+        TangentStatistics const statistics = checkTangents(mesh.vertices);
+        size_t wrongHandedness = 0;
+        for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+            wrongHandedness += mesh.vertices[v].tangent.w !=
+                               mesh.handedness[v];
+        }
+
+        cout << name << ": " << mesh.indices.size() / 3 << " triangles in "
+             << time.count() << " ms, max |N.T| " << statistics.maxNormalDot
+             << ", max ||T|-1| " << statistics.maxLengthError << ", "
+             << wrongHandedness << " wrong handedness, " << fallbacks
+             << " without UV gradient" << endl;
+
+        bool const passed = statistics.maxNormalDot <= MAX_NORMAL_DOT &&
+                            statistics.maxLengthError <= MAX_LENGTH_ERROR &&
+                            wrongHandedness == 0 && fallbacks == 0;
+        if (!passed) {
+            cerr << name << ": FAILED" << endl;
+        }
+        return passed;
+    }
+}
+
+// //////////////////////////////////////////////////////////////// Main //
+// Checks generateTangents against meshes with known frames and times it
+// on a large one. Exits with a failure when any bound is exceeded.
+int main() {
+    bool passed = true;
+    passed &= check("sphere", sphere(16, 32));
+    passed &= check("mirrored grid", mirroredGrid(16));
+    passed &= check("large sphere", sphere(BENCH_RINGS, BENCH_SEGMENTS));
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,90 @@
+// //////////////////////////////////////////////////////// GLSL version //
+#version 430 core
+
+// ////////////////////////////////////////////////////////// Work group //
+// One invocation per cluster; LightClusters dispatches with this size
+layout (local_size_x = 64) in;
+
+// //////////////////////////////////////////////////////////// Includes //
+#include "../common/lights.glsl"
+
+// //////////////////////////////////////////////////////////// Clusters //
+layout (std430, binding = 2) writeonly buffer ClusterCounts {
+    uint clusterCounts[];
+};
+
+layout (std430, binding = 3) writeonly buffer ClusterIndices {
+    uint clusterIndices[];
+};
+
+// Clusters reached by more lights than their list holds
+layout (std430, binding = 11) buffer ClusterOverflow {
+    uint overflowingClusters;
+};
+
+// ////////////////////////////////////////////////////// Cluster bounds //
+// View-space box around one froxel, as in LightClusters::buildOnCpu
+void clusterBounds(uvec3 cell, out vec3 boundsMin, out vec3 boundsMax) {
+    float start = projection.z;
+    float ratio = projection.w / start;
+    float slices = float(clusterGrid.z);
+    float depths[2] = float[2](
+        cell.z == 0u ? 0.0 : start * pow(ratio, float(cell.z) / slices),
+        start * pow(ratio, float(cell.z + 1u) / slices));
+
+    vec2 tiles = vec2(clusterGrid.xy);
+    vec2 ndcMin = vec2(cell.xy) / tiles * 2.0 - 1.0;
+    vec2 ndcMax = vec2(cell.xy + 1u) / tiles * 2.0 - 1.0;
+
+    boundsMin = vec3(3.4e38);
+    boundsMax = vec3(-3.4e38);
+    for (int d = 0; d < 2; ++d) {
+        for (int corner = 0; corner < 4; ++corner) {
+            vec2 ndc = vec2((corner & 1) != 0 ? ndcMax.x : ndcMin.x,
+                            (corner & 2) != 0 ? ndcMax.y : ndcMin.y);
+            vec3 point = vec3(ndc * depths[d] * projection.xy, -depths[d]);
+            boundsMin = min(boundsMin, point);
+            boundsMax = max(boundsMax, point);
+        }
+    }
+}
+
+// //////////////////////////////////////////////////////////////// Main //
+void main() {
+    uint cluster = gl_GlobalInvocationID.x;
+    if (cluster >= clusterGrid.x * clusterGrid.y * clusterGrid.z) {
+        return;
+    }
+
+    uvec3 cell = uvec3(cluster % clusterGrid.x,
+                       cluster / clusterGrid.x % clusterGrid.y,
+                       cluster / (clusterGrid.x * clusterGrid.y));
+    vec3 boundsMin, boundsMax;
+    clusterBounds(cell, boundsMin, boundsMax);
+
+    uint base = cluster * clusterGrid.w;
+    uint count = 0u;
+    for (int i = 0; i < lightCount; ++i) {
+        vec4 position = lights[i].position;
+
+        // A negative range marks lights that reach every cluster
+        bool reaches = position.w < 0.0;
+        if (!reaches) {
+            vec3 center = (view * vec4(position.xyz, 1.0)).xyz;
+            vec3 offset = center - clamp(center, boundsMin, boundsMax);
+            reaches = dot(offset, offset) <= position.w * position.w;
+        }
+
+        if (reaches) {
+            if (count == clusterGrid.w) {
+                atomicAdd(overflowingClusters, 1u);
+                break;
+            }
+            clusterIndices[base + count] = uint(i);
+            ++count;
+        }
+    }
+    clusterCounts[cluster] = count;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,24 @@
+// //////////////////////////////////////////////////////////// Clusters //
+// Built by res/shaders/clusters/compute.glsl or on the CPU; needs the
+// Lights block from lights.glsl
+layout (std430, binding = 2) readonly buffer ClusterCounts {
+    uint clusterCounts[];
+};
+
+layout (std430, binding = 3) readonly buffer ClusterIndices {
+    uint clusterIndices[];
+};
+
+// ////////////////////////////////////////////////////// Cluster lookup //
+uint findCluster(vec3 position) {
+    float depth = -(view * vec4(position, 1.0)).z;
+
+    uvec3 cell;
+    cell.xy = uvec2(gl_FragCoord.xy * clusterScale.xy);
+    cell.z = uint(max(log(depth) * clusterScale.z + clusterScale.w, 0.0));
+    cell = min(cell, clusterGrid.xyz - 1u);
+
+    return (cell.z * clusterGrid.y + cell.y) * clusterGrid.x + cell.x;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
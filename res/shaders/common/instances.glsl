@@ -0,0 +1,12 @@
+// /////////////////////////////////////////////////////////// Instances //
+// Mirrors InstanceData, bound by InstanceBuffer
+struct Instance {
+    mat4 model;
+    mat4 normal;    // inverse transpose of model
+};
+
+layout (std430, binding = 4) readonly buffer Instances {
+    Instance instances[];
+};
+
+// ///////////////////////////////////////////////////////////////////// //
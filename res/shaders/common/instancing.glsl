@@ -0,0 +1,50 @@
+// ///////////////////////////////////////////////////////////// Purpose //
+// Model-space position of an instanced vertex. Every program drawing the
+// scene geometry goes through here, so the depth pre-pass and the shading
+// passes compute bit-identical positions and GL_EQUAL depth tests hold.
+
+// //////////////////////////////////////////////////////////// Includes //
+#include "instances.glsl"
+
+// //////////////////////////////////////////////////////////// Uniforms //
+// Dequantization of compact positions (identity for full floats)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// Places the mesh within its model, as the model's node tree has it
+uniform mat4 nodeTransform;
+uniform mat4 nodeNormal;
+
+// First of this draw's entries in the instance order
+uniform int instanceBase;
+
+// ////////////////////////////////////////////////////// Instance order //
+// Indices into instances: in submission order, or the visible ones as
+// compacted by res/shaders/culling/instances.glsl
+layout (std430, binding = 5) readonly buffer InstanceOrder {
+    uint instanceOrder[];
+};
+
+uint currentInstance() {
+    return instanceOrder[instanceBase + gl_InstanceID];
+}
+
+// /////////////////////////////////////////////////// Instance position //
+vec3 instancedPosition(vec3 storedPosition) {
+    vec3 position = positionOffset + positionScale * storedPosition;
+    return (instances[currentInstance()].model *
+            (nodeTransform * vec4(position, 1.0))).xyz;
+}
+
+// Normals go through the inverse transpose, tangents like positions
+vec3 instancedNormal(vec3 normal) {
+    return mat3(instances[currentInstance()].normal) *
+           (mat3(nodeNormal) * normal);
+}
+
+vec3 instancedTangent(vec3 tangent) {
+    return mat3(instances[currentInstance()].model) *
+           (mat3(nodeTransform) * tangent);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
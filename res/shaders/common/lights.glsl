@@ -0,0 +1,34 @@
+// //////////////////////////////////////////////////// Light parameters //
+// Mirrors LightData
+struct LightParameters {
+    vec4 direction;     // xyz: unit direction, w: enable
+    vec4 position;      // xyz: position, w: range, negative if none
+    vec4 attenuation;   // constant, linear, quadratic, unused
+    vec4 ambient;       // rgb: color * intensity
+    vec4 diffuse;       // rgb: color, a: intensity
+    vec4 specular;      // rgb: color * intensity, a: shininess
+    float cosAngle;
+    float inverseFalloff;   // 1 / (1 - cosAngle)
+    int type;
+    int padding;
+};
+
+const int LT_POINT = 0;
+const int LT_DIRECTIONAL = 1;
+const int LT_SPOT = 2;
+
+// ////////////////////////////////////////////////////////////// Lights //
+// Mirrors LightBlock
+layout (std140, binding = 0) uniform Lights {
+    mat4 view;
+    vec4 projection;    // 1 / P[0][0], 1 / P[1][1], first slice, far
+    vec4 clusterScale;  // xy: tiles per pixel, zw: log depth to slice
+    uvec4 clusterGrid;  // tiles across, tiles down, slices, capacity
+    int lightCount;
+};
+
+layout (std430, binding = 1) readonly buffer LightList {
+    LightParameters lights[];
+};
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,25 @@
+// ////////////////////////////////////////////////// Octahedral normals //
+// Unit vectors folded onto an octahedron and flattened to [-1, 1]^2,
+// which keeps the precision even over the sphere in two channels. The
+// encoding is remapped to [0, 1]^2, as GL only guarantees that unsigned
+// normalized targets can be rendered to.
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n) {
+    vec2 p = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+    p = n.z >= 0.0 ? p : (1.0 - abs(p.yx)) * signNotZero(p);
+    return p * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    }
+    return normalize(n);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,20 @@
+// ////////////////////////////////////////////////////// Normal mapping //
+// Needs fNormal, fTangent, fTexCoords and texNormal from the includer.
+// Without NORMAL_MAPPING in the permutation the interpolated normal is
+// used and the normal map is never sampled.
+vec3 calculateMappedNormal() {
+#if defined(NORMAL_MAPPING)
+    vec3 tangent = normalize(fTangent.xyz - dot(fTangent.xyz, fNormal) * fNormal);
+    vec3 bitangent = (fTangent.w < 0.0 ? -1.0 : 1.0) * cross(fNormal, tangent);
+
+    // The BC5 normal map only stores X and Y, Z is rebuilt from unit length
+    vec2 xy = 2.0 * texture(texNormal, fTexCoords).rg - vec2(1.0);
+    vec3 mapped = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+
+    return normalize(mat3(tangent, bitangent, fNormal) * mapped);
+#else
+    return normalize(fNormal);
+#endif
+}
+
+// ///////////////////////////////////////////////////////////////////// //
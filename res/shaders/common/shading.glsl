@@ -0,0 +1,158 @@
+// /////////////////////////////////////////////////////////// Constants //
+const float PI = 3.14159265359;
+
+// ///////////////////////////////////////////////////////////// Surface //
+// Everything lighting needs to know about a shaded point. The material
+// is fetched once per fragment and prepareSurface derives the view terms,
+// so the light loop only evaluates what depends on the light.
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;        // linear
+    float roughness;
+    float metalness;
+    float occlusion;
+
+    // Filled in by prepareSurface
+    vec3 viewDir;
+    float nDotV;
+    vec3 f0;            // reflectance at normal incidence
+    float alpha;        // GGX alpha squared
+    float k;            // Schlick-GGX remapping for direct light
+};
+
+void prepareSurface(inout Surface surface, vec3 viewPos) {
+    surface.viewDir = normalize(viewPos - surface.position);
+    surface.nDotV = max(dot(surface.normal, surface.viewDir), 0.0);
+    surface.f0 = mix(vec3(0.04), surface.albedo, surface.metalness);
+    surface.alpha = pow(surface.roughness, 4.0);
+    surface.k = pow(surface.roughness + 1.0, 2.0) / 8.0;
+}
+
+// ///////////////////////////////////////////////////////// Light types //
+float attenuate(LightParameters light, float distance) {
+    float attenuation = 1.0 / (light.attenuation.x
+                               + light.attenuation.y * distance
+                               + light.attenuation.z * distance * distance);
+
+    // Fade out towards the range the clusters were built with, so the
+    // cut-off does not show
+    float range = light.position.w;
+    if (range > 0.0) {
+        float window = clamp(1.0 - pow(distance / range, 4.0), 0.0, 1.0);
+        attenuation *= window * window;
+    }
+    return attenuation;
+}
+
+// Direction towards the light and how much of it reaches the position;
+// zero outside a spot's cone. Only the light types defined by the
+// program's permutation (DIRECTIONAL_LIGHTS, POINT_LIGHTS, SPOT_LIGHTS)
+// are compiled in, and types are only told apart when several are.
+float illuminate(LightParameters light, vec3 position, out vec3 lightDir) {
+    lightDir = -light.direction.xyz;
+    float factor = light.direction.w;
+
+#if defined(POINT_LIGHTS) || defined(SPOT_LIGHTS)
+#if defined(DIRECTIONAL_LIGHTS)
+    if (light.type == LT_DIRECTIONAL) {
+        return factor;
+    }
+#endif
+    vec3 toLight = light.position.xyz - position;
+    float distance = length(toLight);
+    lightDir = toLight / distance;
+    factor *= attenuate(light, distance);
+
+#if defined(SPOT_LIGHTS)
+#if defined(POINT_LIGHTS)
+    if (light.type != LT_SPOT) {
+        return factor;
+    }
+#endif
+    float spotCosAngle = dot(lightDir, -light.direction.xyz);
+    if (spotCosAngle < light.cosAngle) {
+        return 0.0;
+    }
+    factor *= (spotCosAngle - light.cosAngle) * light.inverseFalloff;
+#endif
+#endif
+    return factor;
+}
+
+// /////////////////////////////////////////////// Lambert + Blinn-Phong //
+vec3 lambertBlinnPhong(LightParameters light, Surface surface,
+                       vec3 lightDir) {
+    vec3 ambient = light.ambient.rgb;
+
+    float diffuseFactor = clamp(dot(lightDir, surface.normal), 0.0, 1.0);
+    vec3 diffuse = diffuseFactor * light.diffuse.a * light.diffuse.rgb;
+
+    float specularFactor = pow(
+            clamp(dot(surface.normal, normalize(lightDir + surface.viewDir)),
+                  0.0, 1.0),
+            light.specular.a);
+    vec3 specular = specularFactor * light.specular.rgb;
+
+    return ambient + diffuse + specular;
+}
+
+// //////////////////////////////////////////// Physical Based Rendering //
+float distributionGGX(float nDotH, float alpha) {
+    float d = nDotH * nDotH * (alpha - 1.0) + 1.0;
+    return alpha / (PI * d * d);
+}
+float geometrySchlickGGX(float nDotX, float k) {
+    return nDotX / (nDotX * (1.0 - k) + k);
+}
+vec3 fresnelSchlick(float cosTheta, vec3 f0) {
+    return f0 + (1.0 - f0) * pow(1.0 - cosTheta, 5.0);
+}
+vec3 cookTorrance(LightParameters light, Surface surface, vec3 lightDir) {
+    vec3 h = normalize(surface.viewDir + lightDir);
+    float nDotL = max(dot(surface.normal, lightDir), 0.0);
+
+    float ndf = distributionGGX(max(dot(surface.normal, h), 0.0),
+                                surface.alpha);
+    float g = geometrySchlickGGX(nDotL, surface.k) *
+              geometrySchlickGGX(surface.nDotV, surface.k);
+    vec3 f = fresnelSchlick(max(dot(h, surface.viewDir), 0.0), surface.f0);
+
+    vec3 kD = (vec3(1.0) - f) * (1.0 - surface.metalness);
+
+    vec3 specular = (ndf * g * f) /
+            max(4.0 * surface.nDotV * nDotL, 0.001);
+
+    return (kD * surface.albedo / PI + specular) * light.diffuse.rgb * nDotL;
+}
+
+// ///////////////////////////////////////////////////////////// Shading //
+// The lighting model is chosen by the permutation: LIGHTING_PBR or
+// Lambert + Blinn-Phong. The surface must have been prepared.
+vec3 shadeSurface(LightParameters light, Surface surface) {
+    vec3 lightDir;
+    float factor = illuminate(light, surface.position, lightDir);
+    if (factor <= 0.0) {
+        return vec3(0.0);
+    }
+
+#if defined(LIGHTING_PBR)
+    return factor * cookTorrance(light, surface, lightDir);
+#else
+    return factor * lambertBlinnPhong(light, surface, lightDir);
+#endif
+}
+
+// ////////////////////////////////////////////////////////// Tone curve //
+// Final colour from the summed lighting, shared by the forward and the
+// deferred path. Blinn-Phong lights are coloured by the albedo here rather
+// than per light.
+vec4 finishSurface(Surface surface, vec3 lighting) {
+    vec3 pixelColor = surface.occlusion * clamp(lighting, vec3(0.0), vec3(1.0));
+#if !defined(LIGHTING_PBR)
+    pixelColor *= surface.albedo;
+#endif
+    return vec4(pow(pixelColor, vec3(1.0 / 2.2)), 1.0);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,42 @@
+// //////////////////////////////////////////////////////// GLSL version //
+#version 430 core
+
+// ////////////////////////////////////////////////////////// Work group //
+layout (local_size_x = 64) in;
+
+// /////////////////////////////////////////////////////// Draw commands //
+// DrawElementsIndirectCommand; one per mesh and level of detail of every
+// culled entry
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 8) buffer DrawCommands {
+    DrawCommand commands[];
+};
+
+// The visible count each command draws: entry * MAX_LOD_LEVELS + level
+layout (std430, binding = 9) readonly buffer CommandEntries {
+    uint commandEntries[];
+};
+
+layout (std430, binding = 7) readonly buffer VisibleCounts {
+    uint visibleCounts[];
+};
+
+uniform int commandCount;
+
+// //////////////////////////////////////////////////////////////// Main //
+void main() {
+    uint command = gl_GlobalInvocationID.x;
+    if (command >= uint(commandCount)) {
+        return;
+    }
+    commands[command].instanceCount = visibleCounts[commandEntries[command]];
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,152 @@
+// //////////////////////////////////////////////////////// GLSL version //
+#version 430 core
+
+// ////////////////////////////////////////////////////////// Work group //
+// One invocation per instance of one entry; InstanceCuller dispatches
+// with this size
+layout (local_size_x = 64) in;
+
+// //////////////////////////////////////////////////////////// Includes //
+#include "../common/instances.glsl"
+
+// /////////////////////////////////////////////////////// Culling input //
+// Mirrors the entries InstanceCuller writes
+struct CullEntry {
+    mat4 world;
+    vec4 sphere;            // model space; negative radius: never culled
+    uint firstInstance;     // in instances
+    uint instanceCount;
+    uint outputBase;        // in visibleInstances, level 0
+    uint levelCount;
+    vec4 lodErrors;         // model space, finest level first
+    uint stateBase;         // in lodStates
+    uint padding[3];
+};
+
+layout (std430, binding = 6) readonly buffer CullInput {
+    vec4 planes[6];         // world-space frustum, facing inwards
+    vec4 eye;
+    vec4 lodSelection;      // pixel scale, threshold, hysteresis; see
+                            // src/lod-selection.hpp
+    CullEntry entries[];
+};
+
+uniform int entry;
+
+// Must match MAX_LOD_LEVELS
+const uint MAX_LOD_LEVELS = 4u;
+
+// ////////////////////////////////////////////////////// Culling output //
+// Becomes the instance order of the draws
+layout (std430, binding = 5) writeonly buffer InstanceOrder {
+    uint visibleInstances[];
+};
+
+// One per level of every entry
+layout (std430, binding = 7) buffer VisibleCounts {
+    uint visibleCounts[];
+};
+
+// Level each instance of each entry was last drawn at
+layout (std430, binding = 10) buffer LodStates {
+    uint lodStates[];
+};
+
+// ////////////////////////////////////////////////////////// Visibility //
+// Also returns the world-space sphere and how the instance scales sizes
+bool visible(CullEntry cull, uint instance, out vec3 center,
+             out float radius, out float scale) {
+    mat4 toWorld = cull.world * instances[instance].model;
+    center = (toWorld * vec4(cull.sphere.xyz, 1.0)).xyz;
+    scale = sqrt(max(dot(toWorld[0].xyz, toWorld[0].xyz),
+                     max(dot(toWorld[1].xyz, toWorld[1].xyz),
+                         dot(toWorld[2].xyz, toWorld[2].xyz))));
+    radius = cull.sphere.w * scale;
+    if (cull.sphere.w < 0.0) {
+        return true;
+    }
+
+    for (int i = 0; i < 6; ++i) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ///////////////////////////////////////////////////// Level of detail //
+// The same as selectLod in src/lod-selection.cpp
+uint selectLod(CullEntry cull, uint current, float scale, float distance) {
+    if (lodSelection.x <= 0.0 || cull.levelCount <= 1u) {
+        return 0u;
+    }
+
+    float pixels = lodSelection.x * scale / max(distance, 0.01);
+    float threshold = lodSelection.y;
+    uint level = min(current, cull.levelCount - 1u);
+
+    if (cull.lodErrors[level] * pixels > threshold) {
+        while (level > 0u && cull.lodErrors[level] * pixels > threshold) {
+            --level;
+        }
+        return level;
+    }
+
+    float coarsening = threshold * (1.0 - lodSelection.z);
+    while (level + 1u < cull.levelCount &&
+           cull.lodErrors[level + 1u] * pixels <= coarsening) {
+        ++level;
+    }
+    return level;
+}
+
+// //////////////////////////////////////////////////////////////// Main //
+// Visible instances are counted in shared memory first, so each group
+// makes one global atomic per level instead of one per instance
+shared uint groupVisible[MAX_LOD_LEVELS];
+shared uint groupBase[MAX_LOD_LEVELS];
+
+void main() {
+    CullEntry cull = entries[entry];
+    uint index = gl_GlobalInvocationID.x;
+    uint instance = cull.firstInstance + index;
+
+    if (gl_LocalInvocationIndex < MAX_LOD_LEVELS) {
+        groupVisible[gl_LocalInvocationIndex] = 0u;
+    }
+    memoryBarrierShared();
+    barrier();
+
+    vec3 center;
+    float radius, scale;
+    bool isVisible = index < cull.instanceCount &&
+                     visible(cull, instance, center, radius, scale);
+    uint level = 0u;
+    uint slot = 0u;
+    if (isVisible) {
+        // Instances out of view keep the level they were last drawn at
+        uint state = cull.stateBase + index;
+        level = selectLod(cull, lodStates[state], scale,
+                          distance(eye.xyz, center) - radius);
+        lodStates[state] = level;
+        slot = atomicAdd(groupVisible[level], 1u);
+    }
+    memoryBarrierShared();
+    barrier();
+
+    if (gl_LocalInvocationIndex < cull.levelCount) {
+        uint counter = uint(entry) * MAX_LOD_LEVELS + gl_LocalInvocationIndex;
+        groupBase[gl_LocalInvocationIndex] =
+            atomicAdd(visibleCounts[counter],
+                      groupVisible[gl_LocalInvocationIndex]);
+    }
+    memoryBarrierShared();
+    barrier();
+
+    if (isVisible) {
+        visibleInstances[cull.outputBase + level * cull.instanceCount +
+                         groupBase[level] + slot] = instance;
+    }
+}
+
+// ///////////////////////////////////////////////////////////////////// //
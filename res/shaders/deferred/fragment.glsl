@@ -0,0 +1,68 @@
+// //////////////////////////////////////////////////////// GLSL version //
+#version 430 core
+
+// ////////////////////////////////////////////////////////////// Inputs //
+in vec2 fTexCoords;
+
+// ///////////////////////////////////////////////////////////// Outputs //
+out vec4 outColor;
+
+// //////////////////////////////////////////////////////////// Includes //
+#include "../common/lights.glsl"
+#include "../common/clusters.glsl"
+#include "../common/shading.glsl"
+#include "../common/normal-encoding.glsl"
+
+// //////////////////////////////////////////////////////////// G-buffer //
+uniform sampler2D texGAlbedo;       // rgb: albedo as stored, a: occlusion
+uniform sampler2D texGNormal;       // octahedral world-space normal
+uniform sampler2D texGMaterial;     // roughness, metalness
+uniform sampler2D texGDepth;
+
+// //////////////////////////////////////////////////////////// Uniforms //
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPos;
+
+// //////////////////////////////////////////////////////////////// Main //
+// Every pixel is shaded exactly once, by the lights of its cluster only
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+
+    // The scene's depth goes on to the overlay drawn after this pass
+    float depth = texelFetch(texGDepth, texel, 0).r;
+    gl_FragDepth = depth;
+    if (depth == 1.0) {
+        outColor = vec4(0.0);
+        return;
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''' Position reconstruction
+    vec4 position = inverseViewProjection *
+                    vec4(vec3(fTexCoords, depth) * 2.0 - 1.0, 1.0);
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Surface
+    vec4 albedo = texelFetch(texGAlbedo, texel, 0);
+    vec2 material = texelFetch(texGMaterial, texel, 0).rg;
+
+    Surface surface;
+    surface.position = position.xyz / position.w;
+    surface.normal = decodeNormal(texelFetch(texGNormal, texel, 0).rg);
+    surface.albedo = pow(albedo.rgb, vec3(2.2));
+    surface.roughness = material.r;
+    surface.metalness = material.g;
+    surface.occlusion = albedo.a;
+    prepareSurface(surface, viewPos);
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Lighting
+    uint cluster = findCluster(surface.position);
+    uint base = cluster * clusterGrid.w;
+    uint count = clusterCounts[cluster];
+
+    vec3 lighting = vec3(0.0);
+    for (uint i = 0u; i < count; ++i) {
+        lighting += shadeSurface(lights[clusterIndices[base + i]], surface);
+    }
+    outColor = finishSurface(surface, lighting);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
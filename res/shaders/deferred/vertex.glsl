@@ -0,0 +1,17 @@
+// //////////////////////////////////////////////////////// GLSL version //
+#version 430 core
+
+// ///////////////////////////////////////////////////////////// Outputs //
+out vec2 fTexCoords;
+
+// ///////////////////////////////////////////////// Fullscreen triangle //
+// Drawn without vertex data: vertices 0, 1 and 2 land on (-1, -1),
+// (3, -1) and (-1, 3), which covers the whole viewport
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+
+    fTexCoords = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
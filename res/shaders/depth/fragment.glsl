@@ -0,0 +1,9 @@
+// //////////////////////////////////////////////////////// GLSL version //
+#version 430 core
+
+// //////////////////////////////////////////////////////////////// Main //
+// Depth only; colour writes are masked during the pre-pass
+void main() {
+}
+
+// ///////////////////////////////////////////////////////////////////// //
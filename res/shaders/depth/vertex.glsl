@@ -0,0 +1,23 @@
+// //////////////////////////////////////////////////////// GLSL version //
+#version 430 core
+
+// ////////////////////////////////////////////////////////////// Inputs //
+// Bound through the position-only vertex arrays of the meshes
+layout (location = 0) in vec3 vPosition;
+
+// ///////////////////////////////////////////////////////////// Outputs //
+// Must match the shading passes exactly
+invariant gl_Position;
+
+// //////////////////////////////////////////////////////////// Uniforms //
+uniform mat4 transform;
+
+// //////////////////////////////////////////////////////////// Includes //
+#include "../common/instancing.glsl"
+
+// //////////////////////////////////////////////////////////////// Main //
+void main() {
+    gl_Position = transform * vec4(instancedPosition(vPosition), 1.0);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,37 @@
+// //////////////////////////////////////////////////////// GLSL version //
+#version 430 core
+
+// ////////////////////////////////////////////////////////////// Inputs //
+// From the vertex shader, or the optional pass-through geometry shader
+in VertexData {
+    vec3 fPosition;
+    vec3 fNormal;
+    vec2 fTexCoords;
+    vec4 fTangent;    // w: bitangent sign
+};
+
+// ///////////////////////////////////////////////////////////// Outputs //
+// Read back by res/shaders/deferred/fragment.glsl
+layout (location = 0) out vec4 gAlbedo;     // rgb: albedo as stored, a: occlusion
+layout (location = 1) out vec2 gNormal;     // octahedral world-space normal
+layout (location = 2) out vec2 gMaterial;   // roughness, metalness
+
+// //////////////////////////////////////////////////////////// Uniforms //
+uniform sampler2D texOrm;       // R: ambient occlusion, G: roughness, B: metalness
+uniform sampler2D texAlbedo;
+uniform sampler2D texNormal;
+
+// //////////////////////////////////////////////////////////// Includes //
+#include "../common/normal-mapping.glsl"
+#include "../common/normal-encoding.glsl"
+
+// //////////////////////////////////////////////////////////////// Main //
+void main() {
+    vec3 orm = texture(texOrm, fTexCoords).rgb;
+
+    gAlbedo = vec4(texture(texAlbedo, fTexCoords).rgb, orm.r);
+    gNormal = encodeNormal(calculateMappedNormal());
+    gMaterial = orm.gb;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -12,10 +12,8 @@ out vec4 outColor;
 // //////////////////////////////////////////////////////////// Uniforms //
 uniform vec3 viewPos;
 
-uniform sampler2D texAo;
+uniform sampler2D texOrm;
 uniform sampler2D texAlbedo;
-uniform sampler2D texMetalness;
-uniform sampler2D texRoughness;
 uniform sampler2D texNormal;
 
 uniform mat4 vpMatrix;
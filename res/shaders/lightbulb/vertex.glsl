@@ -5,24 +5,37 @@
 layout (location = 0) in vec3 vPosition;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec2 vTexCoords;
-layout (location = 3) in vec3 vTangent;
+layout (location = 3) in vec4 vTangent;
 
 // ///////////////////////////////////////////////////////////// Outputs //
-out vec3 gPosition;
-out vec3 gNormal;
-out vec2 gTexCoords;
+out vec3 fPosition;
+out vec3 fNormal;
+out vec2 fTexCoords;
 
 // //////////////////////////////////////////////////////////// Uniforms //
 uniform mat4 world;
 uniform mat4 transform;
 
+// Dequantization of compact positions (identity for full floats)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// Placement within the model, as the model's node tree has it
+uniform mat4 nodeTransform;
+uniform mat4 nodeNormal;
+
 // //////////////////////////////////////////////////////////////// Main //
 void main() {
-    gPosition = (world * vec4(vPosition, 1.0)).xyz;
-    gNormal = normalize((world * vec4(vNormal, 1.0)).xyz);
-    gTexCoords = vTexCoords;
+    vec3 position = (nodeTransform *
+                     vec4(positionOffset + positionScale * vPosition,
+                          1.0)).xyz;
+
+    fPosition = (world * vec4(position, 1.0)).xyz;
+    fNormal = normalize((world * vec4(mat3(nodeNormal) * vNormal,
+                                      1.0)).xyz);
+    fTexCoords = vTexCoords;
 
-    gl_Position = transform * vec4(vPosition, 1.0);
+    gl_Position = transform * vec4(position, 1.0);
 }
 
 // ///////////////////////////////////////////////////////////////////// //
@@ -1,29 +1,40 @@
 // //////////////////////////////////////////////////////// GLSL version //
 #version 430 core
 
+// ///////////////////////////////////////////////////////////// Purpose //
+// Pass-through stage, not part of the default model pipeline. It is kept
+// to measure what an idle geometry shader costs.
+
 // ////////////////////////////////////////////////////////// Primitives //
 layout (triangles) in;
 layout (triangle_strip, max_vertices = 3) out;
 
 // ////////////////////////////////////////////////////////////// Inputs //
-in vec3 gPosition[3];
-in vec3 gNormal[3];
-in vec2 gTexCoords[3];
-in vec3 gTangent[3];
+in VertexData {
+    vec3 fPosition;
+    vec3 fNormal;
+    vec2 fTexCoords;
+    vec4 fTangent;
+} vertices[];
 
 // ///////////////////////////////////////////////////////////// Outputs //
-out vec3 fPosition;
-out vec3 fNormal;
-out vec2 fTexCoords;
-out vec3 fTangent;
+out VertexData {
+    vec3 fPosition;
+    vec3 fNormal;
+    vec2 fTexCoords;
+    vec4 fTangent;
+};
+
+// Copied through unchanged, but must stay invariant for the depth pre-pass
+invariant gl_Position;
 
 // //////////////////////////////////////////////////////////////// Main //
 void main() {
     for (int i = 0; i < gl_in.length(); ++i) {
-        fPosition = gPosition[i];
-        fNormal = gNormal[i];
-        fTexCoords = gTexCoords[i];
-        fTangent = gTangent[i];
+        fPosition = vertices[i].fPosition;
+        fNormal = vertices[i].fNormal;
+        fTexCoords = vertices[i].fTexCoords;
+        fTangent = vertices[i].fTangent;
 
         gl_Position = gl_in[i].gl_Position;
         EmitVertex();
@@ -5,50 +5,39 @@
 layout (location = 0) in vec3 vPosition;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec2 vTexCoords;
-layout (location = 3) in vec3 vTangent;
+layout (location = 3) in vec4 vTangent;     // w: bitangent sign
 
 // ///////////////////////////////////////////////////////////// Outputs //
-out vec3 gPosition;
-out vec3 gNormal;
-out vec2 gTexCoords;
-out vec3 gTangent;
+// A block, so the optional geometry shader can pass it on under the
+// same names
+out VertexData {
+    vec3 fPosition;
+    vec3 fNormal;
+    vec2 fTexCoords;
+    vec4 fTangent;
+};
+
+// Must match the depth pre-pass exactly
+invariant gl_Position;
 
 // //////////////////////////////////////////////////////////// Uniforms //
 uniform mat4 world;
 uniform mat4 transform;
 
-uniform int instances;
-uniform vec3 offset;
-
-// /////////////////////////////////////////////// Instance translations //
-vec3 translations[25];
-void createTranslations() {
-    int i = 0;
-    for (float z = -16.0; z < 16.0; z += 6.4) {
-        for (float x = -16.0; x < 16.0; x += 6.4) {
-            translations[i++] = vec3(x, 0.0, z) + offset;
-        }
-    }
-}
+// //////////////////////////////////////////////////////////// Includes //
+#include "../common/instancing.glsl"
 
 // //////////////////////////////////////////////////////////////// Main //
 void main() {
-    // If needed, translate instanced objects
-    if (instances > 1) {
-        createTranslations();
-    } else {
-        for (int i = 0; i < 25; ++i) {
-            translations[i] = vec3(0);
-        }
-    }
-
-    // Pass variables to geometry shader
-    gPosition = (world * vec4(vPosition + translations[gl_InstanceID], 1.0)).xyz;
-    gNormal = normalize((world * vec4(vNormal, 1.0)).xyz);
-    gTexCoords = vTexCoords;
-    gTangent = normalize((world * vec4(vTangent, 1.0)).xyz);
-
-    gl_Position = transform * vec4(vPosition + translations[gl_InstanceID], 1.0);
+    vec3 position = instancedPosition(vPosition);
+
+    fPosition = (world * vec4(position, 1.0)).xyz;
+    fNormal = normalize(mat3(world) * instancedNormal(vNormal));
+    fTexCoords = vTexCoords;
+    fTangent = vec4(normalize(mat3(world) * instancedTangent(vTangent.xyz)),
+                    vTangent.w);
+
+    gl_Position = transform * vec4(position, 1.0);
 }
 
 // ///////////////////////////////////////////////////////////////////// //
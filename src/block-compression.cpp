@@ -0,0 +1,385 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "block-compression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    uint16_t packRGB565(float const r, float const g, float const b) {
+        auto const quantize = [](float const value, int const maximum) {
+            return static_cast<uint16_t>(std::lround(
+                    std::min(std::max(value, 0.0f), 255.0f)
+                    * maximum / 255.0f));
+        };
+        return static_cast<uint16_t>((quantize(r, 31) << 11) |
+                                     (quantize(g, 63) << 5) |
+                                     quantize(b, 31));
+    }
+
+    void unpackRGB565(uint16_t const color, int rgb[3]) {
+        int const r = (color >> 11) & 31,
+                  g = (color >> 5) & 63,
+                  b = color & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // Mean of the RGB texels and the direction they spread along most
+    void principalAxis(unsigned char const texels[16][4],
+                       float mean[3], float axis[3]) {
+        // '''''''''''''''''''''''''''''''''''''''''''' Mean and covariance
+        mean[0] = mean[1] = mean[2] = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                mean[c] += texels[i][c] / 16.0f;
+            }
+        }
+
+        float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; ++i) {
+            float const r = texels[i][0] - mean[0],
+                        g = texels[i][1] - mean[1],
+                        b = texels[i][2] - mean[2];
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+
+        // ''''''''''''''''''''''''''''' Principal axis by power iteration
+        axis[0] = axis[1] = axis[2] = 1.0f;
+        for (int iteration = 0; iteration < 4; ++iteration) {
+            float const x = covariance[0] * axis[0]
+                            + covariance[1] * axis[1]
+                            + covariance[2] * axis[2],
+                        y = covariance[1] * axis[0]
+                            + covariance[3] * axis[1]
+                            + covariance[4] * axis[2],
+                        z = covariance[2] * axis[0]
+                            + covariance[4] * axis[1]
+                            + covariance[5] * axis[2];
+            float const length = std::max({std::fabs(x), std::fabs(y),
+                                           std::fabs(z)});
+            if (length < 1e-6f) {
+                break;
+            }
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+    }
+
+    // BC7 palette weights for 4-bit indices, out of 64
+    int const BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30,
+                                 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // Mode 6 endpoints: 7 bits per channel plus a p-bit shared by the
+    // endpoint's channels, so every channel ends up with 8 bits
+    struct BC7Endpoint {
+        int color[3];
+        int pBit;
+
+        int value(int const c) const {
+            return (color[c] << 1) | pBit;
+        }
+    };
+
+    BC7Endpoint quantizeBC7(float const rgb[3]) {
+        BC7Endpoint best = {{0, 0, 0}, 0};
+        float bestError = 1e30f;
+        for (int pBit = 0; pBit < 2; ++pBit) {
+            BC7Endpoint endpoint = {{0, 0, 0}, pBit};
+            float error = 0.0f;
+            for (int c = 0; c < 3; ++c) {
+                float const clamped = std::min(std::max(rgb[c], 0.0f),
+                                               255.0f);
+                endpoint.color[c] = std::min(std::max(static_cast<int>(
+                        std::lround((clamped - pBit) / 2.0f)), 0), 127);
+                float const difference = clamped - endpoint.value(c);
+                error += difference * difference;
+            }
+            if (error < bestError) {
+                bestError = error;
+                best = endpoint;
+            }
+        }
+        return best;
+    }
+
+    // Picks the nearest palette entry for every texel; returns the total
+    // squared error
+    int indexBC7(unsigned char const texels[16][4],
+                 BC7Endpoint const &first, BC7Endpoint const &second,
+                 int indices[16]) {
+        int palette[16][3];
+        for (int index = 0; index < 16; ++index) {
+            for (int c = 0; c < 3; ++c) {
+                palette[index][c] =
+                        ((64 - BC7_WEIGHTS[index]) * first.value(c)
+                         + BC7_WEIGHTS[index] * second.value(c) + 32) >> 6;
+            }
+        }
+
+        int total = 0;
+        for (int i = 0; i < 16; ++i) {
+            int bestError = 1 << 30;
+            for (int index = 0; index < 16; ++index) {
+                int error = 0;
+                for (int c = 0; c < 3; ++c) {
+                    int const difference = texels[i][c] - palette[index][c];
+                    error += difference * difference;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    indices[i] = index;
+                }
+            }
+            total += bestError;
+        }
+        return total;
+    }
+
+    // Least-squares endpoints for fixed indices, per channel; false when
+    // every texel uses the same weight
+    bool fitBC7(unsigned char const texels[16][4], int const indices[16],
+                float first[3], float second[3]) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[3] = {0.0f, 0.0f, 0.0f}, bx[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; ++i) {
+            float const b = BC7_WEIGHTS[indices[i]] / 64.0f,
+                        a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < 3; ++c) {
+                ax[c] += a * texels[i][c];
+                bx[c] += b * texels[i][c];
+            }
+        }
+
+        float const determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f) {
+            return false;
+        }
+        for (int c = 0; c < 3; ++c) {
+            first[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+            second[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+        }
+        return true;
+    }
+
+    // Writes count bits of value at bit offset, least significant first
+    void putBits(unsigned char block[16], int &offset, int const count,
+                 int const value) {
+        for (int bit = 0; bit < count; ++bit, ++offset) {
+            if ((value >> bit) & 1) {
+                block[offset / 8] |=
+                        static_cast<unsigned char>(1 << (offset % 8));
+            }
+        }
+    }
+}
+
+// ////////////////////////////////////////////////////// Block encoders //
+void encodeBlockBC1(unsigned char const texels[16][4],
+                    unsigned char block[8]) {
+    float mean[3], axis[3];
+    principalAxis(texels, mean, axis);
+
+    // ''''''''''''''''''''''''''''''''''''''''' Endpoints along the axis
+    float minimum = 1e30f, maximum = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float const projection = (texels[i][0] - mean[0]) * axis[0]
+                                 + (texels[i][1] - mean[1]) * axis[1]
+                                 + (texels[i][2] - mean[2]) * axis[2];
+        minimum = std::min(minimum, projection);
+        maximum = std::max(maximum, projection);
+    }
+
+    // Inset the endpoints slightly, which lowers the average error
+    float const inset = (maximum - minimum) / 16.0f;
+    float const axisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1]
+                                    + axis[2] * axis[2];
+    minimum = (minimum + inset) / axisLengthSquared;
+    maximum = (maximum - inset) / axisLengthSquared;
+
+    uint16_t color0 = packRGB565(mean[0] + maximum * axis[0],
+                                 mean[1] + maximum * axis[1],
+                                 mean[2] + maximum * axis[2]),
+             color1 = packRGB565(mean[0] + minimum * axis[0],
+                                 mean[1] + minimum * axis[1],
+                                 mean[2] + minimum * axis[2]);
+
+    // Four-colour mode requires color0 > color1
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''' Build palette
+    int palette[4][3];
+    unpackRGB565(color0, palette[0]);
+    unpackRGB565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''' Choose indices
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        for (int i = 0; i < 16; ++i) {
+            int bestIndex = 0, bestError = 1 << 30;
+            for (int index = 0; index < 4; ++index) {
+                int error = 0;
+                for (int c = 0; c < 3; ++c) {
+                    int const difference = texels[i][c] - palette[index][c];
+                    error += difference * difference;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    bestIndex = index;
+                }
+            }
+            indices |= static_cast<uint32_t>(bestIndex) << (2 * i);
+        }
+    }
+
+    block[0] = static_cast<unsigned char>(color0 & 0xFF);
+    block[1] = static_cast<unsigned char>(color0 >> 8);
+    block[2] = static_cast<unsigned char>(color1 & 0xFF);
+    block[3] = static_cast<unsigned char>(color1 >> 8);
+    for (int i = 0; i < 4; ++i) {
+        block[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+}
+
+void encodeBlockBC4(unsigned char const values[16],
+                    unsigned char block[8]) {
+    unsigned char const maximum = *std::max_element(values, values + 16),
+                        minimum = *std::min_element(values, values + 16);
+
+    // Eight-value mode: red0 > red1 and six interpolated steps between
+    int palette[8];
+    palette[0] = maximum;
+    palette[1] = minimum;
+    for (int step = 1; step < 7; ++step) {
+        palette[step + 1] = ((7 - step) * maximum + step * minimum) / 7;
+    }
+
+    uint64_t indices = 0;
+    if (maximum != minimum) {
+        for (int i = 0; i < 16; ++i) {
+            int bestIndex = 0, bestError = 256;
+            for (int index = 0; index < 8; ++index) {
+                int const error = std::abs(values[i] - palette[index]);
+                if (error < bestError) {
+                    bestError = error;
+                    bestIndex = index;
+                }
+            }
+            indices |= static_cast<uint64_t>(bestIndex) << (3 * i);
+        }
+    }
+
+    block[0] = maximum;
+    block[1] = minimum;
+    for (int i = 0; i < 6; ++i) {
+        block[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+}
+
+void encodeBlockBC7(unsigned char const texels[16][4],
+                    unsigned char block[16]) {
+    float mean[3], axis[3];
+    principalAxis(texels, mean, axis);
+
+    // ''''''''''''''''''''''''''''''''''''''''' Endpoints along the axis
+    float minimum = 1e30f, maximum = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float const projection = (texels[i][0] - mean[0]) * axis[0]
+                                 + (texels[i][1] - mean[1]) * axis[1]
+                                 + (texels[i][2] - mean[2]) * axis[2];
+        minimum = std::min(minimum, projection);
+        maximum = std::max(maximum, projection);
+    }
+
+    float const axisLengthSquared = std::max(
+            axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2],
+            1e-6f);
+    float low[3], high[3];
+    for (int c = 0; c < 3; ++c) {
+        low[c] = mean[c] + minimum / axisLengthSquared * axis[c];
+        high[c] = mean[c] + maximum / axisLengthSquared * axis[c];
+    }
+
+    BC7Endpoint first = quantizeBC7(low), second = quantizeBC7(high);
+    int indices[16];
+    int error = indexBC7(texels, first, second, indices);
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''' Refine endpoints
+    for (int iteration = 0; iteration < 2 && error > 0; ++iteration) {
+        if (!fitBC7(texels, indices, low, high)) {
+            break;
+        }
+
+        BC7Endpoint const fittedFirst = quantizeBC7(low),
+                          fittedSecond = quantizeBC7(high);
+        int fittedIndices[16];
+        int const fittedError = indexBC7(texels, fittedFirst, fittedSecond,
+                                         fittedIndices);
+        if (fittedError >= error) {
+            break;
+        }
+        first = fittedFirst;
+        second = fittedSecond;
+        std::copy(fittedIndices, fittedIndices + 16, indices);
+        error = fittedError;
+    }
+
+    // The first texel's index drops its top bit, so it must be below 8
+    if (indices[0] >= 8) {
+        std::swap(first, second);
+        for (int &index : indices) {
+            index = 15 - index;
+        }
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''' Pack block
+    std::fill(block, block + 16, static_cast<unsigned char>(0));
+    int offset = 0;
+    putBits(block, offset, 7, 1 << 6);
+    for (int c = 0; c < 3; ++c) {
+        putBits(block, offset, 7, first.color[c]);
+        putBits(block, offset, 7, second.color[c]);
+    }
+
+    // Alpha is unused: both endpoints opaque
+    putBits(block, offset, 7, 127);
+    putBits(block, offset, 7, 127);
+    putBits(block, offset, 1, first.pBit);
+    putBits(block, offset, 1, second.pBit);
+
+    putBits(block, offset, 3, indices[0]);
+    for (int i = 1; i < 16; ++i) {
+        putBits(block, offset, 4, indices[i]);
+    }
+}
+
+void encodeBlockBC5(unsigned char const reds[16],
+                    unsigned char const greens[16],
+                    unsigned char block[16]) {
+    encodeBlockBC4(reds, block);
+    encodeBlockBC4(greens, block + 8);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,29 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+// //////////////////////////////////////////////////////////// Includes //
+#include <cstddef>
+
+// ////////////////////////////////////////////////////// Block encoders //
+// Every encoder takes one 4x4 block of texels in row-major order and
+// writes a single compressed block in the layout OpenGL expects.
+
+// 16 RGBA texels -> 8 bytes of BC1 (DXT1), opaque four-colour mode
+void encodeBlockBC1(unsigned char const texels[16][4],
+                    unsigned char block[8]);
+
+// 16 single-channel values -> 8 bytes of BC4 (RGTC1)
+void encodeBlockBC4(unsigned char const values[16],
+                    unsigned char block[8]);
+
+// 16 RGB texels -> 16 bytes of BC7 (BPTC), mode 6 only: one subset
+// with 8-bit endpoints and 16 steps between them. Alpha is left opaque.
+void encodeBlockBC7(unsigned char const texels[16][4],
+                    unsigned char block[16]);
+
+// 16 two-channel values -> 16 bytes of BC5 (RGTC2), red block first
+void encodeBlockBC5(unsigned char const reds[16],
+                    unsigned char const greens[16],
+                    unsigned char block[16]);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // BLOCK_COMPRESSION_H
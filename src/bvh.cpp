@@ -0,0 +1,479 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::uint32_t;
+using std::vector;
+
+using glm::mat4;
+using glm::vec3;
+using glm::vec4;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    int const BIN_COUNT = 16;
+
+    // Leaves at most this small are never split; larger ones are split
+    // even when the heuristic would keep them
+    uint32_t const MIN_LEAF_SIZE = 2;
+    uint32_t const MAX_LEAF_SIZE = 8;
+
+    // Cost of visiting a node, relative to testing one item
+    float const TRAVERSAL_COST = 1.0f;
+
+    // Below this depth nodes are split at the median instead of by the
+    // heuristic; halving 2^32 items takes 32 more levels at most
+    uint32_t const SAH_DEPTH_LIMIT = 24;
+
+    static_assert(SAH_DEPTH_LIMIT + 32 + 1 <= Bvh::STACK_SIZE,
+                  "traversal stacks must hold the deepest tree");
+
+    float const INFINITE = std::numeric_limits<float>::infinity();
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    enum PlaneTest {
+        PT_OUTSIDE,
+        PT_INTERSECTING,
+        PT_INSIDE
+    };
+
+    PlaneTest testPlane(vec4 const &plane, Aabb const &box) {
+        vec3 const center = box.center();
+        vec3 const extent = (box.max - box.min) * 0.5f;
+        float const distance = glm::dot(vec3(plane), center) + plane.w;
+        float const reach = glm::dot(glm::abs(vec3(plane)), extent);
+        if (distance + reach < 0.0f) {
+            return PT_OUTSIDE;
+        }
+        return distance - reach >= 0.0f ? PT_INSIDE : PT_INTERSECTING;
+    }
+
+    // Narrows mask to the planes the box crosses; false if it is outside
+    bool testFrustum(vec4 const planes[6], Aabb const &box,
+                     unsigned int &mask) {
+        for (int p = 0; p < 6; ++p) {
+            if (!(mask & (1u << p))) {
+                continue;
+            }
+            PlaneTest const result = testPlane(planes[p], box);
+            if (result == PT_OUTSIDE) {
+                return false;
+            }
+            if (result == PT_INSIDE) {
+                mask &= ~(1u << p);
+            }
+        }
+        return true;
+    }
+
+    // Distance along the ray to where it enters the box, INFINITE if it
+    // misses or the box lies beyond limit
+    float enter(vec3 const &origin, vec3 const &inverseDirection,
+                Aabb const &box, float const limit) {
+        vec3 const t0 = (box.min - origin) * inverseDirection;
+        vec3 const t1 = (box.max - origin) * inverseDirection;
+        vec3 const near = glm::min(t0, t1);
+        vec3 const far = glm::max(t0, t1);
+        float const entry = std::max(std::max(near.x, near.y),
+                                     std::max(near.z, 0.0f));
+        float const exit = std::min(std::min(far.x, far.y),
+                                    std::min(far.z, limit));
+        return entry <= exit ? entry : INFINITE;
+    }
+}
+
+// //////////////////////////////////////////////////////// Struct: Aabb //
+Aabb Aabb::empty() {
+    float const big = std::numeric_limits<float>::max();
+    return {vec3(big), vec3(-big)};
+}
+
+void Aabb::extend(Aabb const &other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+void Aabb::extend(vec3 const &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+vec3 Aabb::center() const {
+    return (min + max) * 0.5f;
+}
+
+float Aabb::surfaceArea() const {
+    vec3 const size = glm::max(max - min, vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+Aabb Aabb::transformed(mat4 const &transform) const {
+    vec3 const halfExtent = (max - min) * 0.5f;
+    vec3 const middle = vec3(transform * vec4(center(), 1.0f));
+    vec3 extent(0.0f);
+    for (int column = 0; column < 3; ++column) {
+        extent += glm::abs(vec3(transform[column])) * halfExtent[column];
+    }
+    return {middle - extent, middle + extent};
+}
+
+// ////////////////////////////////////////////////////////// Class: Bvh //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+void Bvh::build(vector<Aabb> const &boxes) {
+    this->boxes = boxes;
+    nodes.clear();
+    order.resize(boxes.size());
+    leafOf.assign(boxes.size(), 0);
+    if (boxes.empty()) {
+        return;
+    }
+
+    vector<vec3> centroids(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        order[i] = static_cast<uint32_t>(i);
+        centroids[i] = boxes[i].center();
+    }
+
+    // A binary tree over n leaves has 2n - 1 nodes, and splits can leave
+    // a single item in a leaf
+    nodes.reserve(2 * boxes.size() - 1);
+    buildNode(0, static_cast<uint32_t>(boxes.size()), 0, 0, centroids);
+}
+
+void Bvh::update(uint32_t const item, Aabb const &box) {
+    boxes[item] = box;
+    if (nodes.empty()) {
+        return;
+    }
+
+    // Stops where a refit no longer changes anything
+    uint32_t node = leafOf[item];
+    while (true) {
+        Aabb const before = nodes[node].bounds;
+        refitNode(node);
+        Aabb const &after = nodes[node].bounds;
+        if (node == 0 || (after.min == before.min && after.max == before.max)) {
+            break;
+        }
+        node = nodes[node].parent;
+    }
+}
+
+void Bvh::setBox(uint32_t const item, Aabb const &box) {
+    boxes[item] = box;
+}
+
+void Bvh::refit() {
+    // Children always come after their parent
+    for (size_t node = nodes.size(); node-- > 0;) {
+        refitNode(static_cast<uint32_t>(node));
+    }
+}
+
+void Bvh::frustumQuery(vec4 const planes[6], vector<uint32_t> &items) const {
+    if (nodes.empty()) {
+        return;
+    }
+
+    // Planes a node lies entirely inside are not tested below it
+    std::pair<uint32_t, unsigned int> stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = {0, 0x3fu};
+    while (size > 0) {
+        uint32_t const index = stack[--size].first;
+        unsigned int mask = stack[size].second;
+        Node const &node = nodes[index];
+
+        if (!testFrustum(planes, node.bounds, mask)) {
+            continue;
+        }
+        if (mask == 0) {
+            items.insert(items.end(), order.begin() + node.first,
+                         order.begin() + node.first + node.count);
+            continue;
+        }
+
+        if (node.right == 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                unsigned int itemMask = mask;
+                if (testFrustum(planes, boxes[order[i]], itemMask)) {
+                    items.push_back(order[i]);
+                }
+            }
+            continue;
+        }
+
+        stack[size++] = {node.right, mask};
+        stack[size++] = {index + 1, mask};
+    }
+}
+
+void Bvh::selectOccluders(vec4 const planes[6], vec3 const &eye,
+                          size_t const count,
+                          vector<uint32_t> &items) const {
+    vector<uint32_t> visible;
+    frustumQuery(planes, visible);
+
+    // Size over distance approximates the share of the view covered
+    auto const coverage = [&](uint32_t const item) {
+        Aabb const &box = boxes[item];
+        float const distance = std::max(glm::length(box.center() - eye),
+                                        1e-3f);
+        return glm::length(box.max - box.min) / distance;
+    };
+
+    size_t const selected = std::min(count, visible.size());
+    std::partial_sort(visible.begin(), visible.begin() + selected,
+                      visible.end(),
+                      [&](uint32_t const a, uint32_t const b) {
+                          return coverage(a) > coverage(b);
+                      });
+    items.insert(items.end(), visible.begin(),
+                 visible.begin() + selected);
+}
+
+bool Bvh::raycast(vec3 const &origin, vec3 const &direction, uint32_t &item,
+                  float &distance) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    // Zero components give infinities, which the slab test handles
+    vec3 const inverseDirection = 1.0f / direction;
+
+    float nearest = INFINITE;
+    uint32_t stack[STACK_SIZE];
+    int size = 0;
+    if (enter(origin, inverseDirection, nodes[0].bounds, nearest) <
+        INFINITE) {
+        stack[size++] = 0;
+    }
+
+    while (size > 0) {
+        Node const &node = nodes[stack[--size]];
+
+        if (node.right == 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                float const hit = enter(origin, inverseDirection,
+                                        boxes[order[i]], nearest);
+                if (hit < nearest) {
+                    nearest = hit;
+                    item = order[i];
+                }
+            }
+            continue;
+        }
+
+        // The nearer child is visited first, so it can prune the other
+        uint32_t near = static_cast<uint32_t>(&node - nodes.data()) + 1;
+        uint32_t far = node.right;
+        float nearHit = enter(origin, inverseDirection, nodes[near].bounds,
+                              nearest);
+        float farHit = enter(origin, inverseDirection, nodes[far].bounds,
+                             nearest);
+        if (farHit < nearHit) {
+            std::swap(near, far);
+            std::swap(nearHit, farHit);
+        }
+        if (farHit < INFINITE) {
+            stack[size++] = far;
+        }
+        if (nearHit < INFINITE) {
+            stack[size++] = near;
+        }
+    }
+
+    if (nearest == INFINITE) {
+        return false;
+    }
+    distance = nearest;
+    return true;
+}
+
+size_t Bvh::itemCount() const {
+    return boxes.size();
+}
+
+Bvh::Statistics Bvh::statistics() const {
+    Statistics result = {nodes.size(), 0, 0};
+    if (nodes.empty()) {
+        return result;
+    }
+
+    std::pair<uint32_t, size_t> stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = {0, 1};
+    while (size > 0) {
+        std::pair<uint32_t, size_t> const entry = stack[--size];
+        Node const &node = nodes[entry.first];
+        result.depth = std::max(result.depth, entry.second);
+        if (node.right == 0) {
+            ++result.leaves;
+        } else {
+            stack[size++] = {node.right, entry.second + 1};
+            stack[size++] = {entry.first + 1, entry.second + 1};
+        }
+    }
+    return result;
+}
+
+// ============================================= Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+uint32_t Bvh::buildNode(uint32_t const first, uint32_t const count,
+                        uint32_t const parent, uint32_t const depth,
+                        vector<vec3> const &centroids) {
+    uint32_t const index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({Aabb::empty(), first, count, 0, parent});
+
+    Aabb bounds = Aabb::empty();
+    Aabb centroidBounds = Aabb::empty();
+    for (uint32_t i = first; i < first + count; ++i) {
+        bounds.extend(boxes[order[i]]);
+        centroidBounds.extend(centroids[order[i]]);
+    }
+    nodes[index].bounds = bounds;
+
+    auto const makeLeaf = [&]() {
+        for (uint32_t i = first; i < first + count; ++i) {
+            leafOf[order[i]] = index;
+        }
+        return index;
+    };
+    if (count <= MIN_LEAF_SIZE) {
+        return makeLeaf();
+    }
+
+    // Lopsided boxes can make the heuristic peel off a few items per
+    // level; deep enough down, halving keeps the depth bounded
+    bool const medianSplit = depth >= SAH_DEPTH_LIMIT;
+    if (medianSplit && count <= MAX_LEAF_SIZE) {
+        return makeLeaf();
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Binning
+    // Cost of a split, in items tested, is what the children cost
+    // weighted by how likely a query reaching this node reaches them
+    float bestCost = INFINITE;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for (int axis = 0; axis < 3 && !medianSplit; ++axis) {
+        float const low = centroidBounds.min[axis];
+        float const extent = centroidBounds.max[axis] - low;
+        if (extent <= 0.0f) {
+            continue;
+        }
+
+        Aabb binBounds[BIN_COUNT];
+        uint32_t binCounts[BIN_COUNT] = {};
+        std::fill(std::begin(binBounds), std::end(binBounds), Aabb::empty());
+        float const scale = BIN_COUNT / extent;
+        for (uint32_t i = first; i < first + count; ++i) {
+            int const bin = std::min(
+                    BIN_COUNT - 1,
+                    static_cast<int>((centroids[order[i]][axis] - low) *
+                                     scale));
+            binBounds[bin].extend(boxes[order[i]]);
+            ++binCounts[bin];
+        }
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''''''''' Best split
+        float leftArea[BIN_COUNT];
+        uint32_t leftCount[BIN_COUNT];
+        Aabb sweep = Aabb::empty();
+        uint32_t swept = 0;
+        for (int bin = 0; bin < BIN_COUNT - 1; ++bin) {
+            sweep.extend(binBounds[bin]);
+            swept += binCounts[bin];
+            leftArea[bin] = swept > 0 ? sweep.surfaceArea() : 0.0f;
+            leftCount[bin] = swept;
+        }
+
+        sweep = Aabb::empty();
+        swept = 0;
+        for (int bin = BIN_COUNT - 1; bin > 0; --bin) {
+            sweep.extend(binBounds[bin]);
+            swept += binCounts[bin];
+            if (swept == 0 || leftCount[bin - 1] == 0) {
+                continue;
+            }
+            float const cost = leftArea[bin - 1] * leftCount[bin - 1] +
+                               sweep.surfaceArea() * swept;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = bin;
+            }
+        }
+    }
+
+    float const area = std::max(bounds.surfaceArea(), 1e-12f);
+    bool const worthSplitting =
+            bestAxis >= 0 &&
+            TRAVERSAL_COST + bestCost / area < static_cast<float>(count);
+    if (!medianSplit && !worthSplitting && count <= MAX_LEAF_SIZE) {
+        return makeLeaf();
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Partition
+    uint32_t *const begin = order.data() + first;
+    uint32_t *middle;
+    if (medianSplit) {
+        vec3 const extent = centroidBounds.max - centroidBounds.min;
+        int const axis = extent.x >= extent.y && extent.x >= extent.z
+                                 ? 0
+                                 : (extent.y >= extent.z ? 1 : 2);
+        middle = begin + count / 2;
+        std::nth_element(begin, middle, begin + count,
+                         [&](uint32_t const a, uint32_t const b) {
+            return centroids[a][axis] < centroids[b][axis];
+        });
+    } else if (bestAxis >= 0) {
+        float const low = centroidBounds.min[bestAxis];
+        float const scale = BIN_COUNT /
+                            (centroidBounds.max[bestAxis] - low);
+        middle = std::partition(begin, begin + count,
+                                [&](uint32_t const item) {
+            int const bin = std::min(
+                    BIN_COUNT - 1,
+                    static_cast<int>((centroids[item][bestAxis] - low) *
+                                     scale));
+            return bin < bestSplit;
+        });
+    } else {
+        // Every centroid in one place: any halving is as good as another
+        middle = begin + count / 2;
+    }
+
+    uint32_t const leftCountTotal = static_cast<uint32_t>(middle - begin);
+    buildNode(first, leftCountTotal, index, depth + 1, centroids);
+    uint32_t const right = buildNode(first + leftCountTotal,
+                                     count - leftCountTotal, index,
+                                     depth + 1, centroids);
+    nodes[index].right = right;
+    return index;
+}
+
+void Bvh::refitNode(uint32_t const index) {
+    Node &node = nodes[index];
+    if (node.right == 0) {
+        node.bounds = Aabb::empty();
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            node.bounds.extend(boxes[order[i]]);
+        }
+        return;
+    }
+
+    node.bounds = nodes[index + 1].bounds;
+    node.bounds.extend(nodes[node.right].bounds);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
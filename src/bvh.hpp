@@ -0,0 +1,103 @@
+#ifndef BVH_H
+#define BVH_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// //////////////////////////////////////////////////////// Struct: Aabb //
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // Contains nothing; extending it by a box gives that box
+    static Aabb empty();
+
+    void extend(Aabb const &other);
+    void extend(glm::vec3 const &point);
+
+    glm::vec3 center() const;
+    float surfaceArea() const;
+
+    // The box around this one under transform
+    Aabb transformed(glm::mat4 const &transform) const;
+};
+
+// ////////////////////////////////////////////////////////// Class: Bvh //
+// Bounding volume hierarchy over boxes, built top-down with the surface
+// area heuristic over binned centroids. Items keep the indices they were
+// built with. Moving one refits the nodes above it; after many moves a
+// full refit is cheaper, and both keep the topology, so a rebuild is
+// only worth it once the boxes have drifted far from where they were.
+class Bvh {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------------ Data --
+    struct Statistics {
+        std::size_t nodes;
+        std::size_t leaves;
+        std::size_t depth;
+    };
+
+    // Traversals keep at most one pending sibling per level, so no tree
+    // is built deeper than this
+    static constexpr int STACK_SIZE = 64;
+
+    // ------------------------------------------------------- Behaviour --
+    void build(std::vector<Aabb> const &boxes);
+
+    // Moves one item and refits its ancestors
+    void update(std::uint32_t const item, Aabb const &box);
+    // Moves one item without refitting; call refit once after several
+    void setBox(std::uint32_t const item, Aabb const &box);
+    void refit();
+
+    // Appends the items whose boxes reach inside the planes, as given by
+    // extractFrustumPlanes
+    void frustumQuery(glm::vec4 const planes[6],
+                      std::vector<std::uint32_t> &items) const;
+
+    // Appends up to count items inside the planes that cover the most of
+    // the view from eye, biggest first, e.g. as occluders for a depth
+    // pre-pass or occlusion queries
+    void selectOccluders(glm::vec4 const planes[6], glm::vec3 const &eye,
+                         std::size_t const count,
+                         std::vector<std::uint32_t> &items) const;
+
+    // Nearest item whose box the ray enters, at origin + distance *
+    // direction; false when it misses everything
+    bool raycast(glm::vec3 const &origin, glm::vec3 const &direction,
+                 std::uint32_t &item, float &distance) const;
+
+    std::size_t itemCount() const;
+    Statistics statistics() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    struct Node {
+        Aabb bounds;
+        std::uint32_t first;    // the subtree's items, in order
+        std::uint32_t count;
+        std::uint32_t right;    // right child, the left one follows the
+                                // node; 0 for leaves
+        std::uint32_t parent;
+    };
+
+    // ------------------------------------------------------- Behaviour --
+    std::uint32_t buildNode(std::uint32_t const first,
+                            std::uint32_t const count,
+                            std::uint32_t const parent,
+                            std::uint32_t const depth,
+                            std::vector<glm::vec3> const &centroids);
+    void refitNode(std::uint32_t const node);
+
+    // ------------------------------------------------------------ Data --
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> order;
+    std::vector<Aabb> boxes;
+    std::vector<std::uint32_t> leafOf;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // BVH_H
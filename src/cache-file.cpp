@@ -0,0 +1,77 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "cache-file.hpp"
+#include "mapped-file.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::error_code;
+using std::int64_t;
+using std::size_t;
+using std::string;
+using std::uint64_t;
+
+namespace filesystem = std::filesystem;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    string const CACHE_DIRECTORY = "cache";
+}
+
+// ///////////////////////////////////////////////////////// Cache files //
+bool querySource(string const &filename, SourceKey &key) {
+    error_code error;
+
+    auto const size = filesystem::file_size(filename, error);
+    if (error) {
+        return false;
+    }
+    auto const time = filesystem::last_write_time(filename, error);
+    if (error) {
+        return false;
+    }
+
+    key.size = static_cast<uint64_t>(size);
+    key.time = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+uint64_t hashBytes(void const *data, size_t size, uint64_t hash) {
+    unsigned char const *const bytes =
+            static_cast<unsigned char const *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashFile(string const &filename) {
+    MappedFile const file(filename);
+    return hashBytes(file.data(), file.size());
+}
+
+string cacheFilenameFor(string const &sourceFilename,
+                        string const &extension) {
+    error_code error;
+    filesystem::create_directories(CACHE_DIRECTORY, error);
+
+    string flattened = sourceFilename;
+    std::replace_if(flattened.begin(), flattened.end(),
+                    [](char const c) {
+                        return c == '/' || c == '\\' || c == ':';
+                    }, '_');
+    return CACHE_DIRECTORY + "/" + flattened + extension;
+}
+
+void commitCacheFile(string const &temporaryFilename,
+                     string const &cacheFilename) {
+    error_code error;
+    filesystem::rename(temporaryFilename, cacheFilename, error);
+    if (error) {
+        filesystem::remove(temporaryFilename, error);
+    }
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,36 @@
+#ifndef CACHE_FILE_H
+#define CACHE_FILE_H
+// //////////////////////////////////////////////////////////// Includes //
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// /////////////////////////////////////////////////// Struct: SourceKey //
+// Identity of the source file a cache entry was derived from.
+struct SourceKey {
+    std::uint64_t size;
+    std::int64_t time;
+};
+
+// ///////////////////////////////////////////////////////// Cache files //
+bool querySource(std::string const &filename, SourceKey &key);
+
+// 64-bit FNV-1a; pass the previous result as hash to chain buffers
+std::uint64_t hashBytes(void const *data, std::size_t size,
+                        std::uint64_t hash = 14695981039346656037ull);
+
+// 64-bit FNV-1a over the whole file
+std::uint64_t hashFile(std::string const &filename);
+
+// Path of the cache entry for a source file, e.g. cache/res_x.obj.mesh;
+// the cache directory is created on demand
+std::string cacheFilenameFor(std::string const &sourceFilename,
+                             std::string const &extension);
+
+// Moves a fully written temporary file over the cache entry, so readers
+// never observe a truncated file
+void commitCacheFile(std::string const &temporaryFilename,
+                     std::string const &cacheFilename);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // CACHE_FILE_H
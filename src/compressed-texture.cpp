@@ -0,0 +1,530 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "compressed-texture.hpp"
+#include "block-compression.hpp"
+#include "cache-file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::make_shared;
+using std::ofstream;
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+// /////////////////////////////////////////////////////////// Constants //
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+namespace {
+    char const MAGIC[4] = {'F', 'P', 'T', 'X'};
+
+    // Bump whenever the layout or any encoder changes
+    uint32_t const VERSION = 2;
+
+    size_t const ALIGNMENT = 16;
+
+    GLenum formatOf(TextureEncoding const encoding) {
+        switch (encoding) {
+            case TE_BC1:
+                return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case TE_BC4:
+                return GL_COMPRESSED_RED_RGTC1;
+            case TE_BC7:
+                return GL_COMPRESSED_RGBA_BPTC_UNORM;
+            case TE_BC5:
+            default:
+                return GL_COMPRESSED_RG_RGTC2;
+        }
+    }
+
+    char const *extensionOf(TextureEncoding const encoding) {
+        switch (encoding) {
+            case TE_BC1:
+                return ".bc1.tex";
+            case TE_BC4:
+                return ".bc4.tex";
+            case TE_BC7:
+                return ".bc7.tex";
+            case TE_BC5:
+            default:
+                return ".bc5.tex";
+        }
+    }
+
+    size_t blockSizeOf(GLenum const format) {
+        return format == GL_COMPRESSED_RG_RGTC2
+               || format == GL_COMPRESSED_RGBA_BPTC_UNORM ? 16 : 8;
+    }
+}
+
+// ////////////////////////////////////////////////////// File structure //
+namespace {
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t format;
+        uint32_t levelCount;
+        uint64_t sourceKey;
+        uint64_t sourceHash;
+    };
+
+    struct FileLevel {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t width;
+        uint32_t height;
+    };
+}
+
+// /////////////////////////////////////////////////////////// Mip chain //
+namespace {
+    // Expands any channel count to RGBA8
+    vector<unsigned char> expandToRGBA(Image const &image) {
+        size_t const texelCount =
+                static_cast<size_t>(image.width) * image.height;
+        vector<unsigned char> rgba(texelCount * 4);
+
+        unsigned char const *source = image.pixels.get();
+        for (size_t i = 0; i < texelCount; ++i) {
+            unsigned char const *texel = source + i * image.channels;
+            unsigned char *target = &rgba[i * 4];
+            switch (image.channels) {
+                case 1:
+                    target[0] = target[1] = target[2] = texel[0];
+                    target[3] = 255;
+                    break;
+                case 2:
+                    target[0] = target[1] = target[2] = texel[0];
+                    target[3] = texel[1];
+                    break;
+                default:
+                    target[0] = texel[0];
+                    target[1] = texel[1];
+                    target[2] = texel[2];
+                    target[3] = image.channels == 4 ? texel[3] : 255;
+            }
+        }
+        return rgba;
+    }
+
+    // 2x2 box filter; normal maps are renormalised after averaging
+    vector<unsigned char> downsample(vector<unsigned char> const &source,
+                                     int const width, int const height,
+                                     bool const normals) {
+        int const nextWidth = std::max(width / 2, 1),
+                  nextHeight = std::max(height / 2, 1);
+        vector<unsigned char> target(
+                static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+        for (int y = 0; y < nextHeight; ++y) {
+            for (int x = 0; x < nextWidth; ++x) {
+                int const x0 = std::min(2 * x, width - 1),
+                          x1 = std::min(2 * x + 1, width - 1),
+                          y0 = std::min(2 * y, height - 1),
+                          y1 = std::min(2 * y + 1, height - 1);
+
+                float average[4];
+                for (int c = 0; c < 4; ++c) {
+                    average[c] = (source[(y0 * width + x0) * 4 + c]
+                                  + source[(y0 * width + x1) * 4 + c]
+                                  + source[(y1 * width + x0) * 4 + c]
+                                  + source[(y1 * width + x1) * 4 + c])
+                                 / 4.0f;
+                }
+
+                if (normals) {
+                    float normal[3], length = 0.0f;
+                    for (int c = 0; c < 3; ++c) {
+                        normal[c] = average[c] / 127.5f - 1.0f;
+                        length += normal[c] * normal[c];
+                    }
+                    length = std::sqrt(std::max(length, 1e-8f));
+                    for (int c = 0; c < 3; ++c) {
+                        average[c] = (normal[c] / length + 1.0f) * 127.5f;
+                    }
+                }
+
+                unsigned char *texel = &target[(y * nextWidth + x) * 4];
+                for (int c = 0; c < 4; ++c) {
+                    texel[c] = static_cast<unsigned char>(std::lround(
+                            std::min(std::max(average[c], 0.0f), 255.0f)));
+                }
+            }
+        }
+        return target;
+    }
+
+    // First channel of each source becomes one channel of the result;
+    // sources of a different size are resampled to the first one
+    Image packChannels(vector<string> const &channelSources) {
+        vector<Image> sources;
+        for (string const &source : channelSources) {
+            sources.push_back(decodeImage(source));
+        }
+
+        int const width = sources.front().width,
+                  height = sources.front().height,
+                  channels = static_cast<int>(sources.size());
+
+        Image packed = {width, height, channels,
+                        {static_cast<unsigned char *>(std::malloc(
+                                 static_cast<size_t>(width) * height
+                                 * channels)),
+                         std::free}};
+        if (!packed.pixels) {
+            throw std::bad_alloc();
+        }
+
+        for (int c = 0; c < channels; ++c) {
+            Image const &source = sources[c];
+            for (int y = 0; y < height; ++y) {
+                int const sourceY = y * source.height / height;
+                for (int x = 0; x < width; ++x) {
+                    int const sourceX = x * source.width / width;
+                    packed.pixels.get()[(y * width + x) * channels + c] =
+                            source.pixels.get()[(sourceY * source.width
+                                                 + sourceX)
+                                                * source.channels];
+                }
+            }
+        }
+        return packed;
+    }
+
+    void encodeLevel(vector<unsigned char> const &rgba,
+                     int const width, int const height,
+                     TextureEncoding const encoding,
+                     unsigned char *output) {
+        size_t const blockSize = blockSizeOf(formatOf(encoding));
+        int const blocksX = (width + 3) / 4,
+                  blocksY = (height + 3) / 4;
+
+        for (int blockY = 0; blockY < blocksY; ++blockY) {
+            for (int blockX = 0; blockX < blocksX; ++blockX) {
+                // Gather the block, clamping at the image edges
+                unsigned char texels[16][4], reds[16], greens[16];
+                for (int i = 0; i < 16; ++i) {
+                    int const x = std::min(blockX * 4 + i % 4, width - 1),
+                              y = std::min(blockY * 4 + i / 4, height - 1);
+                    std::memcpy(texels[i], &rgba[(y * width + x) * 4], 4);
+                    reds[i] = texels[i][0];
+                    greens[i] = texels[i][1];
+                }
+
+                unsigned char *block =
+                        output + (blockY * blocksX + blockX) * blockSize;
+                switch (encoding) {
+                    case TE_BC1:
+                        encodeBlockBC1(texels, block);
+                        break;
+                    case TE_BC4:
+                        encodeBlockBC4(reds, block);
+                        break;
+                    case TE_BC5:
+                        encodeBlockBC5(reds, greens, block);
+                        break;
+                    case TE_BC7:
+                        encodeBlockBC7(texels, block);
+                        break;
+                }
+            }
+        }
+    }
+
+    size_t levelSize(int const width, int const height,
+                     GLenum const format) {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4)
+               * blockSizeOf(format);
+    }
+
+    size_t align(size_t const offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+}
+
+// /////////////////////////////////////////////////////////////// Cache //
+namespace {
+    uint64_t mix(uint64_t hash, uint64_t const value) {
+        for (int i = 0; i < 8; ++i) {
+            hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Size and timestamp of every source folded into one value
+    bool combinedKey(vector<string> const &sources, uint64_t &key) {
+        key = 14695981039346656037ull;
+        for (string const &source : sources) {
+            SourceKey sourceKey;
+            if (!querySource(source, sourceKey)) {
+                return false;
+            }
+            key = mix(mix(key, sourceKey.size),
+                      static_cast<uint64_t>(sourceKey.time));
+        }
+        return true;
+    }
+
+    uint64_t combinedHash(vector<string> const &sources) {
+        uint64_t hash = 14695981039346656037ull;
+        for (string const &source : sources) {
+            hash = mix(hash, hashFile(source));
+        }
+        return hash;
+    }
+
+    bool readCache(string const &cacheFilename,
+                   vector<string> const &sources,
+                   TextureEncoding const encoding, CompressedImage &image) {
+        auto mapping = make_shared<MappedFile>(cacheFilename);
+        if (!mapping->valid() || mapping->size() < sizeof(FileHeader)) {
+            return false;
+        }
+
+        FileHeader header;
+        std::memcpy(&header, mapping->data(), sizeof(FileHeader));
+
+        uint64_t key;
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header.version != VERSION ||
+            header.format != formatOf(encoding) ||
+            header.levelCount == 0 ||
+            !combinedKey(sources, key)) {
+            return false;
+        }
+        if (header.sourceKey != key &&
+            header.sourceHash != combinedHash(sources)) {
+            return false;
+        }
+
+        size_t const tableEnd = sizeof(FileHeader)
+                                + header.levelCount * sizeof(FileLevel);
+        if (tableEnd > mapping->size()) {
+            return false;
+        }
+
+        image.format = header.format;
+        image.levels.clear();
+        for (uint32_t i = 0; i < header.levelCount; ++i) {
+            FileLevel level;
+            std::memcpy(&level, mapping->data() + sizeof(FileHeader)
+                                + i * sizeof(FileLevel),
+                        sizeof(FileLevel));
+
+            if (level.offset > mapping->size() ||
+                level.size > mapping->size() - level.offset ||
+                level.size != levelSize(level.width, level.height,
+                                        header.format)) {
+                return false;
+            }
+
+            image.levels.push_back({static_cast<int>(level.width),
+                                    static_cast<int>(level.height),
+                                    mapping->data() + level.offset,
+                                    static_cast<size_t>(level.size)});
+        }
+
+        image.mapping = mapping;
+        return true;
+    }
+
+    void writeCache(string const &cacheFilename,
+                    vector<string> const &sources,
+                    CompressedImage const &image) {
+        uint64_t key;
+        if (!combinedKey(sources, key)) {
+            return;
+        }
+
+        FileHeader header = {};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.format = image.format;
+        header.levelCount = static_cast<uint32_t>(image.levels.size());
+        header.sourceKey = key;
+        header.sourceHash = combinedHash(sources);
+
+        vector<FileLevel> levels;
+        size_t offset = align(sizeof(FileHeader)
+                              + image.levels.size() * sizeof(FileLevel));
+        for (CompressedLevel const &level : image.levels) {
+            levels.push_back({offset, level.size,
+                              static_cast<uint32_t>(level.width),
+                              static_cast<uint32_t>(level.height)});
+            offset = align(offset + level.size);
+        }
+
+        string const temporaryFilename = cacheFilename + ".tmp";
+        {
+            ofstream file(temporaryFilename, std::ios::binary);
+            if (!file) {
+                return;
+            }
+
+            auto const pad = [&file]() {
+                static char const zeros[ALIGNMENT] = {};
+                auto const position = static_cast<size_t>(file.tellp());
+                file.write(zeros, align(position) - position);
+            };
+
+            file.write(reinterpret_cast<char const *>(&header),
+                       sizeof(header));
+            file.write(reinterpret_cast<char const *>(levels.data()),
+                       levels.size() * sizeof(FileLevel));
+            pad();
+            for (CompressedLevel const &level : image.levels) {
+                file.write(reinterpret_cast<char const *>(level.data),
+                           level.size);
+                pad();
+            }
+
+            if (!file) {
+                file.close();
+                std::remove(temporaryFilename.c_str());
+                return;
+            }
+        }
+
+        commitCacheFile(temporaryFilename, cacheFilename);
+    }
+}
+
+// ///////////////////////////////////////////// Struct: CompressedImage //
+size_t CompressedImage::size() const {
+    size_t total = 0;
+    for (CompressedLevel const &level : levels) {
+        total += level.size;
+    }
+    return total;
+}
+
+size_t CompressedImage::uncompressedSize() const {
+    // What the same chain costs as RGB8, which drivers pad to RGBA8
+    size_t total = 0;
+    for (CompressedLevel const &level : levels) {
+        total += static_cast<size_t>(level.width) * level.height * 4;
+    }
+    return total;
+}
+
+// ///////////////////////////////////////////////////////// Compression //
+CompressedImage compressImage(Image const &image,
+                              TextureEncoding const encoding) {
+    CompressedImage result;
+    result.format = formatOf(encoding);
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''' Lay out levels
+    vector<size_t> offsets;
+    size_t total = 0;
+    for (int width = image.width, height = image.height;;
+         width = std::max(width / 2, 1), height = std::max(height / 2, 1)) {
+        offsets.push_back(total);
+        result.levels.push_back({width, height, nullptr,
+                                 levelSize(width, height, result.format)});
+        total += result.levels.back().size;
+
+        if (width == 1 && height == 1) {
+            break;
+        }
+    }
+    result.storage.resize(total);
+
+    // ''''''''''''''''''''''''''''''''''''''''''' Filter and encode levels
+    vector<unsigned char> rgba = expandToRGBA(image);
+    for (size_t i = 0; i < result.levels.size(); ++i) {
+        CompressedLevel &level = result.levels[i];
+        if (i > 0) {
+            CompressedLevel const &previous = result.levels[i - 1];
+            rgba = downsample(rgba, previous.width, previous.height,
+                              encoding == TE_BC5);
+        }
+
+        encodeLevel(rgba, level.width, level.height, encoding,
+                    &result.storage[offsets[i]]);
+        level.data = &result.storage[offsets[i]];
+    }
+
+    return result;
+}
+
+CompressedImage loadCompressedImage(string const &filename,
+                                    TextureEncoding const encoding) {
+    string const cacheFilename =
+            cacheFilenameFor(filename, extensionOf(encoding));
+
+    CompressedImage image;
+    if (readCache(cacheFilename, {filename}, encoding, image)) {
+        return image;
+    }
+
+    image = compressImage(decodeImage(filename), encoding);
+    writeCache(cacheFilename, {filename}, image);
+    return image;
+}
+
+CompressedImage loadPackedImage(vector<string> const &channelSources,
+                                string const &packedName,
+                                TextureEncoding const encoding) {
+    string const cacheFilename =
+            cacheFilenameFor(packedName, extensionOf(encoding));
+
+    CompressedImage image;
+    if (readCache(cacheFilename, channelSources, encoding, image)) {
+        return image;
+    }
+
+    image = compressImage(packChannels(channelSources), encoding);
+    writeCache(cacheFilename, channelSources, image);
+    return image;
+}
+
+GLuint uploadCompressedTexture(CompressedImage const &image) {
+    // Generate OpenGL resource
+    GLuint texture;
+    glGenTextures(1, &texture);
+
+    // Setup the texture
+    glBindTexture(GL_TEXTURE_2D, texture);
+    {
+        // Set texture parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                        static_cast<GLint>(image.levels.size()) - 1);
+
+        // BC4 only stores red; read it back as grey like the RGB maps
+        if (image.format == GL_COMPRESSED_RED_RGTC1) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
+
+        // Pass the precomputed mip chain to OpenGL
+        for (size_t i = 0; i < image.levels.size(); ++i) {
+            CompressedLevel const &level = image.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i),
+                                   image.format,
+                                   level.width, level.height, 0,
+                                   static_cast<GLsizei>(level.size),
+                                   level.data);
+        }
+    }
+
+    // Return texture's ID
+    return texture;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
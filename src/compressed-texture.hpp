@@ -0,0 +1,61 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "mapped-file.hpp"
+#include "opengl-headers.hpp"
+#include "texture.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// /////////////////////////////////////////////// Enum: TextureEncoding //
+enum TextureEncoding {
+    TE_BC1,     // RGB colour, 4 bits per texel
+    TE_BC4,     // single channel, 4 bits per texel
+    TE_BC5,     // two channels (tangent-space normals), 8 bits per texel
+    TE_BC7      // independent RGB channels (packed ORM), 8 bits per texel
+};
+
+// ///////////////////////////////////////////// Struct: CompressedLevel //
+struct CompressedLevel {
+    int width;
+    int height;
+    unsigned char const *data;
+    std::size_t size;
+};
+
+// ///////////////////////////////////////////// Struct: CompressedImage //
+// Block-compressed mip chain. The level pointers address either the
+// owned storage or a mapping of the on-disk cache.
+struct CompressedImage {
+    GLenum format;
+    std::vector<CompressedLevel> levels;
+    std::vector<unsigned char> storage;
+    std::shared_ptr<MappedFile> mapping;
+
+    std::size_t size() const;
+    std::size_t uncompressedSize() const;
+};
+
+// ///////////////////////////////////////////////////////// Compression //
+CompressedImage compressImage(Image const &image,
+                              TextureEncoding const encoding);
+
+// Reads the cached mip chain for a source file, or decodes, compresses
+// and caches it. Safe to call from worker threads.
+CompressedImage loadCompressedImage(std::string const &filename,
+                                    TextureEncoding const encoding);
+
+// Packs the first channel of every source into one image (e.g. ao,
+// roughness and metalness into an ORM texture), cached under packedName.
+CompressedImage loadPackedImage(std::vector<std::string> const &channelSources,
+                                std::string const &packedName,
+                                TextureEncoding const encoding);
+
+// Must be called on the thread owning the OpenGL context.
+GLuint uploadCompressedTexture(CompressedImage const &image);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // COMPRESSED_TEXTURE_H
@@ -0,0 +1,154 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "deferred-renderer.hpp"
+#include "shading-features.hpp"
+
+#include <exception>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::exception;
+using std::shared_ptr;
+
+using glm::mat4;
+using glm::vec3;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    char const *const LIGHTING_VERTEX = "res/shaders/deferred/vertex.glsl";
+    char const *const LIGHTING_FRAGMENT = "res/shaders/deferred/fragment.glsl";
+
+    // Texture units of the G-buffer during the lighting pass
+    enum GBufferUnit {
+        GU_ALBEDO,
+        GU_NORMAL,
+        GU_MATERIAL,
+        GU_DEPTH
+    };
+
+    Uniform<int> const TEX_G_ALBEDO("texGAlbedo");
+    Uniform<int> const TEX_G_NORMAL("texGNormal");
+    Uniform<int> const TEX_G_MATERIAL("texGMaterial");
+    Uniform<int> const TEX_G_DEPTH("texGDepth");
+    Uniform<mat4> const INVERSE_VIEW_PROJECTION("inverseViewProjection");
+    Uniform<vec3> const VIEW_POS("viewPos");
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    // (Re)allocates a render target; texelFetch needs no filtering, but
+    // incomplete mipmaps would still make the texture unusable
+    void allocate(GLuint const texture, GLenum const internalFormat,
+                  GLenum const format, GLenum const type,
+                  int const width, int const height) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
+                     format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+}
+
+// ///////////////////////////////////////////// Class: DeferredRenderer //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+DeferredRenderer::DeferredRenderer()
+        : framebuffer(RT_FRAMEBUFFER, "G-buffer"),
+          albedo(RT_TEXTURE, "G-buffer albedo"),
+          normal(RT_TEXTURE, "G-buffer normal"),
+          material(RT_TEXTURE, "G-buffer material"),
+          depth(RT_TEXTURE, "G-buffer depth"),
+          emptyVertexArray(RT_VERTEX_ARRAY, "deferred lighting"),
+          lighting({{GL_VERTEX_SHADER, LIGHTING_VERTEX},
+                    {GL_FRAGMENT_SHADER, LIGHTING_FRAGMENT}},
+                   shadingFeatureDefines(), SF_PBR | SF_LIGHT_TYPES),
+          width(0),
+          height(0) {
+}
+
+void DeferredRenderer::beginGeometryPass(int const width, int const height) {
+    if (width != this->width || height != this->height) {
+        resize(width, height);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id());
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::lightingPass(mat4 const &view, mat4 const &projection,
+                                    vec3 const &viewPosition,
+                                    unsigned int const features) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Cheap enough to set every pass, and variants may be new
+    shared_ptr<Shader> const &shader = lighting.variant(features);
+    shader->use();
+    shader->set(TEX_G_ALBEDO, GU_ALBEDO);
+    shader->set(TEX_G_NORMAL, GU_NORMAL);
+    shader->set(TEX_G_MATERIAL, GU_MATERIAL);
+    shader->set(TEX_G_DEPTH, GU_DEPTH);
+    shader->set(INVERSE_VIEW_PROJECTION, glm::inverse(projection * view));
+    shader->set(VIEW_POS, viewPosition);
+
+    GLuint const textures[] = {albedo.id(), normal.id(), material.id(),
+                               depth.id()};
+    for (GLuint unit = 0; unit < 4; ++unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, textures[unit]);
+    }
+
+    // The pass writes gl_FragDepth for every pixel, so the depth test has
+    // to let it through
+    glDepthFunc(GL_ALWAYS);
+    glBindVertexArray(emptyVertexArray.id());
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS);
+
+    for (GLuint unit = 0; unit < 4; ++unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// ============================================= Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+void DeferredRenderer::resize(int const width, int const height) {
+    this->width = width;
+    this->height = height;
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Textures
+    allocate(albedo.id(), GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE,
+             width, height);
+    allocate(normal.id(), GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+    allocate(material.id(), GL_RG8, GL_RG, GL_UNSIGNED_BYTE, width, height);
+    allocate(depth.id(), GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT,
+             GL_FLOAT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''' Framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id());
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, albedo.id(), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                           GL_TEXTURE_2D, normal.id(), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2,
+                           GL_TEXTURE_2D, material.id(), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                           GL_TEXTURE_2D, depth.id(), 0);
+
+    GLenum const attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                  GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(3, attachments);
+
+    GLenum const status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        throw exception("G-buffer framebuffer incomplete");
+    }
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,52 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-resources.hpp"
+#include "opengl-headers.hpp"
+#include "shader.hpp"
+
+// ///////////////////////////////////////////// Class: DeferredRenderer //
+// A thin G-buffer (albedo and occlusion, octahedral normal, roughness and
+// metalness, depth) and the full-screen pass that lights it. Lighting uses
+// the same cluster lists as the forward path, so each pixel is shaded once
+// and only by the lights that reach it.
+class DeferredRenderer {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    DeferredRenderer();
+
+    DeferredRenderer(DeferredRenderer const &) = delete;
+    DeferredRenderer &operator=(DeferredRenderer const &) = delete;
+
+    // Binds and clears the G-buffer, reallocated when the size changed
+    void beginGeometryPass(int const width, int const height);
+
+    // Lights the G-buffer into the default framebuffer, which also gets
+    // the scene's depth so forward geometry can be drawn on top; features
+    // is a ShadingFeature mask that picks the lighting variant
+    void lightingPass(glm::mat4 const &view, glm::mat4 const &projection,
+                      glm::vec3 const &viewPosition,
+                      unsigned int const features);
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------- Behaviour --
+    void resize(int const width, int const height);
+
+    // ------------------------------------------------------------ Data --
+    GpuResource framebuffer;
+    GpuResource albedo;
+    GpuResource normal;
+    GpuResource material;
+    GpuResource depth;
+
+    // The lighting pass generates its triangle from gl_VertexID, but core
+    // profiles still need a vertex array bound
+    GpuResource emptyVertexArray;
+
+    ShaderPermutations lighting;
+    int width;
+    int height;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // DEFERRED_RENDERER_H
@@ -0,0 +1,202 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "frustum-culler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::uint8_t;
+
+using glm::mat4;
+using glm::vec3;
+using glm::vec4;
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    // Component arrays of one batch, indexed together
+    struct Volumes {
+        float const *centerX, *centerY, *centerZ;
+        float const *extentX, *extentY, *extentZ;
+        float const *radius;
+    };
+
+    void cullScalar(vec4 const *planes, Volumes const &volumes,
+                    size_t const begin, size_t const end,
+                    uint8_t *visibility) {
+        for (size_t i = begin; i < end; ++i) {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; ++p) {
+                vec4 const &plane = planes[p];
+                float const distance = plane.x * volumes.centerX[i] +
+                                       plane.y * volumes.centerY[i] +
+                                       plane.z * volumes.centerZ[i] +
+                                       plane.w;
+                float const boxReach =
+                        std::abs(plane.x) * volumes.extentX[i] +
+                        std::abs(plane.y) * volumes.extentY[i] +
+                        std::abs(plane.z) * volumes.extentZ[i];
+                inside = distance >= -std::min(boxReach, volumes.radius[i]);
+            }
+            visibility[i] = inside ? 1 : 0;
+        }
+    }
+
+#ifdef FRUSTUM_CULLER_SSE
+    void cullSSE(vec4 const *planes, Volumes const &volumes,
+                 size_t const count, uint8_t *visibility) {
+        __m128 const signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+        // Plane components splatted across the lanes, once per call
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        __m128 absX[6], absY[6], absZ[6];
+        for (int p = 0; p < 6; ++p) {
+            planeX[p] = _mm_set1_ps(planes[p].x);
+            planeY[p] = _mm_set1_ps(planes[p].y);
+            planeZ[p] = _mm_set1_ps(planes[p].z);
+            planeW[p] = _mm_set1_ps(planes[p].w);
+            absX[p] = _mm_and_ps(planeX[p], signMask);
+            absY[p] = _mm_and_ps(planeY[p], signMask);
+            absZ[p] = _mm_and_ps(planeZ[p], signMask);
+        }
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 const cx = _mm_loadu_ps(volumes.centerX + i);
+            __m128 const cy = _mm_loadu_ps(volumes.centerY + i);
+            __m128 const cz = _mm_loadu_ps(volumes.centerZ + i);
+            __m128 const ex = _mm_loadu_ps(volumes.extentX + i);
+            __m128 const ey = _mm_loadu_ps(volumes.extentY + i);
+            __m128 const ez = _mm_loadu_ps(volumes.extentZ + i);
+            __m128 const r = _mm_loadu_ps(volumes.radius + i);
+
+            // No early out: six planes cost less than a branch per lane
+            __m128 outside = _mm_setzero_ps();
+            for (int p = 0; p < 6; ++p) {
+                __m128 const distance = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(planeX[p], cx),
+                                   _mm_mul_ps(planeY[p], cy)),
+                        _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+                __m128 const boxReach = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(absX[p], ex),
+                                   _mm_mul_ps(absY[p], ey)),
+                        _mm_mul_ps(absZ[p], ez));
+                __m128 const reach = _mm_min_ps(boxReach, r);
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(
+                        _mm_add_ps(distance, reach), _mm_setzero_ps()));
+            }
+
+            int const mask = _mm_movemask_ps(outside);
+            for (int lane = 0; lane < 4; ++lane) {
+                visibility[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+            }
+        }
+
+        cullScalar(planes, volumes, i, count, visibility);
+    }
+#endif
+}
+
+// ////////////////////////////////////////////////////// Frustum planes //
+void extractFrustumPlanes(mat4 const &viewProjection, vec4 planes[6]) {
+    vec4 rows[4];
+    for (int row = 0; row < 4; ++row) {
+        rows[row] = vec4(viewProjection[0][row], viewProjection[1][row],
+                         viewProjection[2][row], viewProjection[3][row]);
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        planes[2 * axis] = rows[3] + rows[axis];
+        planes[2 * axis + 1] = rows[3] - rows[axis];
+    }
+    for (int i = 0; i < 6; ++i) {
+        planes[i] /= glm::length(vec3(planes[i]));
+    }
+}
+
+// //////////////////////////////////////////////// Class: FrustumCuller //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+void FrustumCuller::clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    radius.clear();
+    visibility.clear();
+    visibles = 0;
+}
+
+size_t FrustumCuller::add(vec3 const &boundsMin, vec3 const &boundsMax,
+                          float const radius, mat4 const &world) {
+    // The world-space box around the transformed one reaches as far as
+    // the absolute matrix takes the half extents
+    vec3 const center = vec3(world * vec4((boundsMin + boundsMax) * 0.5f,
+                                          1.0f));
+    vec3 const halfExtent = (boundsMax - boundsMin) * 0.5f;
+    vec3 extent(0.0f);
+    float scale = 0.0f;
+    for (int column = 0; column < 3; ++column) {
+        vec3 const axis(world[column]);
+        extent += glm::abs(axis) * halfExtent[column];
+        scale = std::max(scale, glm::dot(axis, axis));
+    }
+
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    extentX.push_back(extent.x);
+    extentY.push_back(extent.y);
+    extentZ.push_back(extent.z);
+    this->radius.push_back(radius * std::sqrt(scale));
+    return centerX.size() - 1;
+}
+
+void FrustumCuller::cull(mat4 const &viewProjection) {
+    vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+    visibility.resize(centerX.size());
+
+    Volumes const volumes = {centerX.data(), centerY.data(), centerZ.data(),
+                             extentX.data(), extentY.data(), extentZ.data(),
+                             radius.data()};
+
+    auto const startTime = std::chrono::steady_clock::now();
+#ifdef FRUSTUM_CULLER_SSE
+    cullSSE(planes, volumes, visibility.size(), visibility.data());
+#else
+    cullScalar(planes, volumes, 0, visibility.size(), visibility.data());
+#endif
+    std::chrono::duration<float, std::micro> const elapsed =
+            std::chrono::steady_clock::now() - startTime;
+    microseconds = elapsed.count();
+
+    visibles = static_cast<size_t>(
+            std::count(visibility.begin(), visibility.end(), 1));
+}
+
+bool FrustumCuller::visible(size_t const volume) const {
+    return visibility[volume] != 0;
+}
+
+size_t FrustumCuller::size() const {
+    return centerX.size();
+}
+
+size_t FrustumCuller::visibleCount() const {
+    return visibles;
+}
+
+float FrustumCuller::kernelMicroseconds() const {
+    return microseconds;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
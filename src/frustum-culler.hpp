@@ -0,0 +1,52 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ////////////////////////////////////////////////////// Frustum planes //
+// World-space planes of the frustum of viewProjection, normalized and
+// facing inwards: left, right, bottom, top, near, far
+void extractFrustumPlanes(glm::mat4 const &viewProjection,
+                          glm::vec4 planes[6]);
+
+// //////////////////////////////////////////////// Class: FrustumCuller //
+// CPU frustum test of many bounding volumes at once. Volumes are kept as
+// separate component arrays, so the SSE kernel tests four per step. Each
+// is a world-space box with a sphere around the same centre, and the
+// test uses whichever of the two reaches less far towards the plane.
+class FrustumCuller {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    void clear();
+
+    // Model-space box and the radius of the sphere around its centre,
+    // under world; returns the volume's index
+    std::size_t add(glm::vec3 const &boundsMin, glm::vec3 const &boundsMax,
+                    float const radius, glm::mat4 const &world);
+
+    void cull(glm::mat4 const &viewProjection);
+
+    // From the last cull
+    bool visible(std::size_t const volume) const;
+
+    std::size_t size() const;
+    std::size_t visibleCount() const;
+    float kernelMicroseconds() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+
+    std::vector<std::uint8_t> visibility;
+    std::size_t visibles = 0;
+    float microseconds = 0.0f;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // FRUSTUM_CULLER_H
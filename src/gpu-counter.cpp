@@ -0,0 +1,84 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-counter.hpp"
+
+#include <cstring>
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    bool pipelineStatisticsSupported() {
+        if (GLAD_GL_VERSION_4_6) {
+            return true;
+        }
+
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            char const *const name = reinterpret_cast<char const *>(
+                    glGetStringi(GL_EXTENSIONS, i));
+            if (std::strcmp(name, "GL_ARB_pipeline_statistics_query") == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+// /////////////////////////////////////////////////// Class: GpuCounter //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+GpuCounter::GpuCounter(GLenum const target)
+        : target(target),
+          supported(pipelineStatisticsSupported()),
+          queries{},
+          issued{},
+          current(0),
+          averageCount(0.0) {
+    if (supported) {
+        glGenQueries(QUERY_COUNT, queries);
+    }
+}
+
+GpuCounter::~GpuCounter() {
+    if (supported) {
+        glDeleteQueries(QUERY_COUNT, queries);
+    }
+}
+
+void GpuCounter::begin() {
+    if (!supported) {
+        return;
+    }
+
+    if (issued[current]) {
+        GLuint64 count = 0;
+        glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &count);
+
+        double const sample = static_cast<double>(count);
+        averageCount = averageCount == 0.0
+                       ? sample
+                       : 0.9 * averageCount + 0.1 * sample;
+    }
+
+    glBeginQuery(target, queries[current]);
+}
+
+void GpuCounter::end() {
+    if (!supported) {
+        return;
+    }
+
+    glEndQuery(target);
+
+    issued[current] = true;
+    current = (current + 1) % QUERY_COUNT;
+}
+
+bool GpuCounter::available() const {
+    return supported;
+}
+
+double GpuCounter::average() const {
+    return averageCount;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,43 @@
+#ifndef GPU_COUNTER_H
+#define GPU_COUNTER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+// /////////////////////////////////////////////////// Class: GpuCounter //
+// Pipeline statistics query, e.g. GL_FRAGMENT_SHADER_INVOCATIONS, over a
+// span of GPU work. Results are read a few frames late through a ring of
+// queries, like GpuTimer. Without GL 4.6 or
+// ARB_pipeline_statistics_query the counter stays unavailable and
+// begin() and end() do nothing.
+class GpuCounter {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    explicit GpuCounter(GLenum const target);
+
+    GpuCounter(GpuCounter const &) = delete;
+    GpuCounter &operator=(GpuCounter const &) = delete;
+
+    ~GpuCounter();
+
+    void begin();
+    void end();
+
+    bool available() const;
+    // Exponential moving average of the counted spans
+    double average() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    static constexpr int QUERY_COUNT = 4;
+
+    GLenum const target;
+    bool const supported;
+
+    GLuint queries[QUERY_COUNT];
+    bool issued[QUERY_COUNT];
+    int current;
+    double averageCount;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // GPU_COUNTER_H
@@ -0,0 +1,229 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-resources.hpp"
+
+#include <utility>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::endl;
+using std::lock_guard;
+using std::mutex;
+using std::ostream;
+using std::size_t;
+using std::string;
+using std::uint32_t;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    char const *const TYPE_NAMES[RT_COUNT] = {
+            "buffer", "vertex array", "texture", "program", "framebuffer"};
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    GLuint generate(ResourceType const type) {
+        GLuint id = 0;
+        switch (type) {
+            case RT_BUFFER:
+                glGenBuffers(1, &id);
+                break;
+            case RT_VERTEX_ARRAY:
+                glGenVertexArrays(1, &id);
+                break;
+            case RT_TEXTURE:
+                glGenTextures(1, &id);
+                break;
+            case RT_PROGRAM:
+                id = glCreateProgram();
+                break;
+            case RT_FRAMEBUFFER:
+                glGenFramebuffers(1, &id);
+                break;
+            default:
+                break;
+        }
+        return id;
+    }
+
+    void release(ResourceType const type, GLuint const id) {
+        switch (type) {
+            case RT_BUFFER:
+                glDeleteBuffers(1, &id);
+                break;
+            case RT_VERTEX_ARRAY:
+                glDeleteVertexArrays(1, &id);
+                break;
+            case RT_TEXTURE:
+                glDeleteTextures(1, &id);
+                break;
+            case RT_PROGRAM:
+                glDeleteProgram(id);
+                break;
+            case RT_FRAMEBUFFER:
+                glDeleteFramebuffers(1, &id);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// ///////////////////////////////////////////////// Class: GpuResources //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+GpuResources &GpuResources::shared() {
+    static GpuResources resources;
+    return resources;
+}
+
+GpuHandle GpuResources::create(ResourceType const type,
+                               string const &label) {
+    return adopt(type, generate(type), label);
+}
+
+GpuHandle GpuResources::adopt(ResourceType const type, GLuint const id,
+                              string const &label) {
+    lock_guard<mutex> lock(slotsMutex);
+
+    uint32_t index;
+    if (!freeSlots.empty()) {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(slots.size());
+        slots.push_back({type, 0, 0, false, string()});
+    }
+
+    Slot &slot = slots[index];
+    slot.type = type;
+    slot.id = id;
+    slot.alive = true;
+    slot.label = label;
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+
+    return {index, slot.generation};
+}
+
+void GpuResources::destroy(GpuHandle const handle) {
+    ResourceType type;
+    GLuint id;
+    {
+        lock_guard<mutex> lock(slotsMutex);
+        if (handle.index >= slots.size()) {
+            return;
+        }
+
+        Slot &slot = slots[handle.index];
+        if (!slot.alive || slot.generation != handle.generation) {
+            return;
+        }
+
+        type = slot.type;
+        id = slot.id;
+        slot.alive = false;
+        slot.id = 0;
+        slot.label.clear();
+        freeSlots.push_back(handle.index);
+    }
+
+    release(type, id);
+}
+
+GLuint GpuResources::get(GpuHandle const handle) const {
+    lock_guard<mutex> lock(slotsMutex);
+    if (handle.index >= slots.size()) {
+        return 0;
+    }
+
+    Slot const &slot = slots[handle.index];
+    return slot.alive && slot.generation == handle.generation ? slot.id : 0;
+}
+
+size_t GpuResources::liveCount(ResourceType const type) const {
+    lock_guard<mutex> lock(slotsMutex);
+
+    size_t count = 0;
+    for (Slot const &slot : slots) {
+        if (slot.alive && slot.type == type) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+size_t GpuResources::reportLeaks(ostream &output) const {
+    lock_guard<mutex> lock(slotsMutex);
+
+    size_t leaks = 0;
+    for (Slot const &slot : slots) {
+        if (slot.alive) {
+            output << "GPU resource leak: " << TYPE_NAMES[slot.type] << " "
+                   << slot.id << " (" << slot.label << ")" << endl;
+            ++leaks;
+        }
+    }
+
+    if (leaks == 0) {
+        output << "GPU resources: all " << slots.size()
+               << " slots released" << endl;
+    }
+    return leaks;
+}
+
+// ////////////////////////////////////////////////// Class: GpuResource //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+GpuResource::GpuResource()
+        : managed{0, 0},
+          object(0) {
+}
+
+GpuResource::GpuResource(ResourceType const type, string const &label)
+        : GpuResource(GpuResources::shared().create(type, label)) {
+}
+
+GpuResource::GpuResource(GpuHandle const handle)
+        : managed(handle),
+          object(GpuResources::shared().get(handle)) {
+}
+
+GpuResource::GpuResource(GpuResource &&other) noexcept
+        : managed(other.managed),
+          object(other.object) {
+    other.managed = {0, 0};
+    other.object = 0;
+}
+
+GpuResource &GpuResource::operator=(GpuResource &&other) noexcept {
+    if (this != &other) {
+        reset();
+        managed = other.managed;
+        object = other.object;
+        other.managed = {0, 0};
+        other.object = 0;
+    }
+    return *this;
+}
+
+GpuResource::~GpuResource() {
+    reset();
+}
+
+GLuint GpuResource::id() const {
+    return object;
+}
+
+GpuHandle GpuResource::handle() const {
+    return managed;
+}
+
+void GpuResource::reset() {
+    if (managed.valid()) {
+        GpuResources::shared().destroy(managed);
+        managed = {0, 0};
+        object = 0;
+    }
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,107 @@
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// ////////////////////////////////////////////////// Enum: ResourceType //
+enum ResourceType {
+    RT_BUFFER,
+    RT_VERTEX_ARRAY,
+    RT_TEXTURE,
+    RT_PROGRAM,
+    RT_FRAMEBUFFER,
+    RT_COUNT
+};
+
+// /////////////////////////////////////////////////// Struct: GpuHandle //
+// Slot in the GpuResources table plus the generation the slot had when
+// the handle was issued. Once the object is destroyed the slot's
+// generation moves on, so stale handles resolve to 0 instead of to
+// whatever object reuses the slot. Generation 0 is never issued.
+struct GpuHandle {
+    std::uint32_t index;
+    std::uint32_t generation;
+
+    bool valid() const { return generation != 0; }
+};
+
+// ///////////////////////////////////////////////// Class: GpuResources //
+// Owner of every OpenGL object the application creates. Objects are
+// labelled so whatever is still alive at shutdown can be reported.
+class GpuResources {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    GpuResources(GpuResources const &) = delete;
+    GpuResources &operator=(GpuResources const &) = delete;
+
+    static GpuResources &shared();
+
+    GpuHandle create(ResourceType const type, std::string const &label);
+    // Takes ownership of an object created elsewhere, e.g. by a loader
+    GpuHandle adopt(ResourceType const type, GLuint const id,
+                    std::string const &label);
+    void destroy(GpuHandle const handle);
+
+    GLuint get(GpuHandle const handle) const;
+
+    std::size_t liveCount(ResourceType const type) const;
+    // Returns the number of objects still alive
+    std::size_t reportLeaks(std::ostream &output) const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    struct Slot {
+        ResourceType type;
+        GLuint id;
+        std::uint32_t generation;
+        bool alive;
+        std::string label;
+    };
+
+    // ------------------------------------------------------- Behaviour --
+    GpuResources() = default;
+
+    // ------------------------------------------------------------ Data --
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> freeSlots;
+    mutable std::mutex slotsMutex;
+};
+
+// ////////////////////////////////////////////////// Class: GpuResource //
+// Move-only owner of one handle; destroys the object when it goes away.
+// Being the only owner, it can keep the resolved id for binding.
+class GpuResource {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    GpuResource();
+    GpuResource(ResourceType const type, std::string const &label);
+    explicit GpuResource(GpuHandle const handle);
+
+    GpuResource(GpuResource const &) = delete;
+    GpuResource &operator=(GpuResource const &) = delete;
+
+    GpuResource(GpuResource &&other) noexcept;
+    GpuResource &operator=(GpuResource &&other) noexcept;
+
+    ~GpuResource();
+
+    GLuint id() const;
+    GpuHandle handle() const;
+
+    void reset();
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    GpuHandle managed;
+    GLuint object;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // GPU_RESOURCES_H
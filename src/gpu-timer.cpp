@@ -0,0 +1,46 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-timer.hpp"
+
+// ///////////////////////////////////////////////////// Class: GpuTimer //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+GpuTimer::GpuTimer()
+        : issued{},
+          current(0),
+          averageMilliseconds(0.0f) {
+    glGenQueries(QUERY_COUNT, queries);
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(QUERY_COUNT, queries);
+}
+
+void GpuTimer::begin() {
+    // The slot about to be reused was issued QUERY_COUNT frames ago, so
+    // its result is normally available without stalling
+    if (issued[current]) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT,
+                              &nanoseconds);
+
+        float const sample = nanoseconds / 1.0e6f;
+        averageMilliseconds = averageMilliseconds == 0.0f
+                              ? sample
+                              : 0.9f * averageMilliseconds + 0.1f * sample;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void GpuTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+
+    issued[current] = true;
+    current = (current + 1) % QUERY_COUNT;
+}
+
+float GpuTimer::milliseconds() const {
+    return averageMilliseconds;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,37 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+// ///////////////////////////////////////////////////// Class: GpuTimer //
+// GL_TIME_ELAPSED measurement of a span of GPU work. Queries rotate
+// through a small ring, so results are read a few frames late and the
+// CPU never waits for the GPU to catch up.
+class GpuTimer {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    GpuTimer();
+
+    GpuTimer(GpuTimer const &) = delete;
+    GpuTimer &operator=(GpuTimer const &) = delete;
+
+    ~GpuTimer();
+
+    void begin();
+    void end();
+
+    // Exponential moving average of the measured spans
+    float milliseconds() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    static constexpr int QUERY_COUNT = 4;
+
+    GLuint queries[QUERY_COUNT];
+    bool issued[QUERY_COUNT];
+    int current;
+    float averageMilliseconds;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // GPU_TIMER_H
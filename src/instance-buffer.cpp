@@ -0,0 +1,139 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "instance-buffer.hpp"
+
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::uint32_t;
+using std::vector;
+
+using glm::mat4;
+
+// //////////////////////////////////////////////// Struct: InstanceData //
+InstanceData::InstanceData(mat4 const &model)
+        : model(model),
+          normal(glm::inverseTranspose(model)) {
+}
+
+// /////////////////////////////////////////////// Class: InstanceBuffer //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+InstanceBuffer::InstanceBuffer()
+        : buffer(RT_BUFFER, "instances"),
+          orderBuffer(RT_BUFFER, "instance order"),
+          uploadedOrderBuffer(RT_BUFFER, "uploaded instance order"),
+          capacity(256),
+          uploadedOrderCapacity(0),
+          uploads(0) {
+    allocate();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer.id());
+    bindOrder();
+}
+
+bool InstanceBuffer::update(vector<SharedInstanceList> const &lists) {
+    if (lists == uploadedLists) {
+        return false;
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Layout
+    // A list drawn by several nodes is stored once
+    bases.assign(lists.size(), 0);
+    staging.clear();
+    for (size_t i = 0; i < lists.size(); ++i) {
+        size_t j = 0;
+        while (j < i && lists[j] != lists[i]) {
+            ++j;
+        }
+        if (j < i) {
+            bases[i] = bases[j];
+            continue;
+        }
+
+        bases[i] = static_cast<GLint>(staging.size());
+        if (lists[i]) {
+            staging.insert(staging.end(), lists[i]->begin(), lists[i]->end());
+        }
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Upload
+    if (staging.size() > capacity) {
+        while (capacity < staging.size()) {
+            capacity *= 2;
+        }
+        // Reallocation keeps the names, so the bindings stay valid
+        allocate();
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.id());
+    if (!staging.empty()) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                        staging.size() * sizeof(InstanceData),
+                        staging.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    uploadedLists = lists;
+    ++uploads;
+    return true;
+}
+
+GLint InstanceBuffer::base(size_t const list) const {
+    return bases[list];
+}
+
+void InstanceBuffer::bindOrder() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ORDER_BINDING,
+                     orderBuffer.id());
+}
+
+void InstanceBuffer::uploadOrder(vector<uint32_t> const &order) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, uploadedOrderBuffer.id());
+    if (order.size() > uploadedOrderCapacity || uploadedOrderCapacity == 0) {
+        uploadedOrderCapacity = std::max(order.size(),
+                                         2 * uploadedOrderCapacity);
+        uploadedOrderCapacity = std::max<size_t>(uploadedOrderCapacity, 1);
+        glBufferData(GL_SHADER_STORAGE_BUFFER,
+                     uploadedOrderCapacity * sizeof(uint32_t), nullptr,
+                     GL_STREAM_DRAW);
+    }
+    if (!order.empty()) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                        order.size() * sizeof(uint32_t), order.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ORDER_BINDING,
+                     uploadedOrderBuffer.id());
+}
+
+size_t InstanceBuffer::instanceCount() const {
+    return staging.size();
+}
+
+size_t InstanceBuffer::uploadCount() const {
+    return uploads;
+}
+
+// ============================================= Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+void InstanceBuffer::allocate() {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.id());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(InstanceData),
+                 nullptr, GL_DYNAMIC_DRAW);
+
+    // Submission order is the identity and only grows with the capacity
+    vector<uint32_t> order(capacity);
+    std::iota(order.begin(), order.end(), 0u);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, orderBuffer.id());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, order.size() * sizeof(uint32_t),
+                 order.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
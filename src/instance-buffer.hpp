@@ -0,0 +1,80 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-resources.hpp"
+#include "opengl-headers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// //////////////////////////////////////////////// Struct: InstanceData //
+// std430 mirror of struct Instance in res/shaders/common/instancing.glsl
+struct InstanceData {
+    glm::mat4 model;        // instance space to the node's model space
+    glm::mat4 normal;       // inverse transpose of model, upper 3x3 used
+
+    InstanceData() = default;
+    explicit InstanceData(glm::mat4 const &model);
+};
+
+static_assert(sizeof(InstanceData) == 8 * 16,
+              "InstanceData must match std430");
+
+// Lists are never changed once shared; a new list replaces an old one
+using InstanceList = std::vector<InstanceData>;
+using SharedInstanceList = std::shared_ptr<InstanceList const>;
+
+// /////////////////////////////////////////////// Class: InstanceBuffer //
+// The per-instance transforms of every draw, in one storage buffer that
+// stays bound for the shaders. Draws look their instances up through an
+// instance order from a base index on; the order kept here is submission
+// order, which a culling pass may replace. Lists are told apart by
+// identity, so a frame that submits the same lists as the last one
+// uploads nothing.
+class InstanceBuffer {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------------ Data --
+    static constexpr GLuint BINDING = 4;
+    static constexpr GLuint ORDER_BINDING = 5;
+
+    // ------------------------------------------------------- Behaviour --
+    InstanceBuffer();
+
+    InstanceBuffer(InstanceBuffer const &) = delete;
+    InstanceBuffer &operator=(InstanceBuffer const &) = delete;
+
+    // Returns whether anything had to be written
+    bool update(std::vector<SharedInstanceList> const &lists);
+
+    // First instance of lists[list] from the last update
+    GLint base(std::size_t const list) const;
+
+    // Makes draws read their instances in submission order again
+    void bindOrder() const;
+    // Makes them read these instead, until the next bindOrder
+    void uploadOrder(std::vector<std::uint32_t> const &order);
+
+    std::size_t instanceCount() const;
+    std::size_t uploadCount() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------- Behaviour --
+    void allocate();
+
+    // ------------------------------------------------------------ Data --
+    GpuResource buffer;
+    GpuResource orderBuffer;
+    GpuResource uploadedOrderBuffer;
+    std::size_t capacity;
+    std::size_t uploadedOrderCapacity;
+
+    std::vector<SharedInstanceList> uploadedLists;
+    std::vector<GLint> bases;
+    std::vector<InstanceData> staging;
+    std::size_t uploads;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // INSTANCE_BUFFER_H
@@ -0,0 +1,404 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "instance-culler.hpp"
+#include "frustum-culler.hpp"
+#include "instance-buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::make_unique;
+using std::size_t;
+using std::uint32_t;
+using std::vector;
+
+using glm::mat4;
+using glm::vec4;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    char const *const CULL_SHADER = "res/shaders/culling/instances.glsl";
+    char const *const COMMAND_SHADER = "res/shaders/culling/commands.glsl";
+
+    // Must match local_size_x of both shaders
+    unsigned int const GROUP_SIZE = 64;
+
+    Uniform<int> const ENTRY("entry");
+    Uniform<int> const COMMAND_COUNT("commandCount");
+
+    // std430 mirror of CullEntry in the culling shader
+    struct CullEntry {
+        mat4 world;
+        vec4 sphere;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+        uint32_t outputBase;
+        uint32_t levelCount;
+        vec4 lodErrors;
+        uint32_t stateBase;
+        uint32_t padding[3];
+    };
+
+    static_assert(sizeof(CullEntry) == 8 * 16, "CullEntry must match std430");
+    static_assert(MAX_LOD_LEVELS <= 4, "lodErrors holds four levels");
+    static_assert(sizeof(DrawCommand) == 5 * sizeof(GLuint),
+                  "DrawCommand must match DrawElementsIndirectCommand");
+
+    // Frustum planes, the eye and the LodSelection parameters
+    size_t const HEADER_SIZE = 8 * sizeof(vec4);
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    // Keeps the buffer's name, and so any binding of it
+    void reserve(GpuResource const &buffer, size_t const bytes,
+                 void const *data, GLenum const usage) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.id());
+        glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, data, usage);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // Direct draws, and requests without errors, have a single level
+    int levelCount(CullRequest const &request) {
+        if (request.ranges.empty() || request.lodErrors.empty()) {
+            return 1;
+        }
+        return std::min(static_cast<int>(request.lodErrors.size()),
+                        MAX_LOD_LEVELS);
+    }
+}
+
+// /////////////////////////////////////////////// Class: InstanceCuller //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+InstanceCuller::InstanceCuller()
+        : inputBuffer(RT_BUFFER, "culling input"),
+          countsBuffer(RT_BUFFER, "visible instance counts"),
+          commandsBuffer(RT_BUFFER, "culled draw commands"),
+          commandEntriesBuffer(RT_BUFFER, "culled draw command entries"),
+          visibleBuffer(RT_BUFFER, "visible instances"),
+          visibleCapacity(0),
+          lodStatesBuffer(RT_BUFFER, "instance levels of detail"),
+          lodStatesCapacity(0),
+          readbackBuffer(RT_BUFFER, "visible instance counts readback"),
+          readbackStride(0),
+          readbackFences{nullptr, nullptr},
+          readbackSlot(0),
+          drawnTriangles(0),
+          fullDetailTriangles(0) {
+    // Every buffer gets a store up front, so no binding is ever empty
+    uint32_t const zero = 0;
+    reserve(inputBuffer, HEADER_SIZE, nullptr, GL_STREAM_DRAW);
+    reserve(countsBuffer, sizeof(zero), &zero, GL_DYNAMIC_DRAW);
+    reserve(commandsBuffer, sizeof(DrawCommand), nullptr, GL_DYNAMIC_DRAW);
+    reserve(commandEntriesBuffer, sizeof(zero), &zero, GL_STATIC_DRAW);
+    reserve(lodStatesBuffer, sizeof(zero), &zero, GL_DYNAMIC_DRAW);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INPUT_BINDING,
+                     inputBuffer.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTS_BINDING,
+                     countsBuffer.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING,
+                     commandsBuffer.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_ENTRIES_BINDING,
+                     commandEntriesBuffer.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOD_STATES_BINDING,
+                     lodStatesBuffer.id());
+
+    try {
+        cullShader = make_unique<Shader>(CULL_SHADER);
+        commandShader = make_unique<Shader>(COMMAND_SHADER);
+    } catch (exception const &error) {
+        cerr << "Instances are not culled: " << error.what() << endl;
+        cullShader = nullptr;
+        commandShader = nullptr;
+    }
+}
+
+InstanceCuller::~InstanceCuller() {
+    for (GLsync const fence : readbackFences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+}
+
+bool InstanceCuller::available() const {
+    return cullShader && commandShader;
+}
+
+vector<CulledDraw> const &InstanceCuller::cull(
+        mat4 const &viewProjection, LodSelection const &lods,
+        vector<CullRequest> const &requests) {
+    readCounts();
+    layOutCommands(requests);
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Input
+    // Every request gets its own output range per level, so requests that
+    // share instances cull them independently
+    input.assign(HEADER_SIZE + requests.size() * sizeof(CullEntry), 0);
+    vec4 *const header = reinterpret_cast<vec4 *>(input.data());
+    extractFrustumPlanes(viewProjection, header);
+    header[6] = vec4(lods.eye, 0.0f);
+    header[7] = vec4(lods.pixelScale, lods.threshold, lods.hysteresis, 0.0f);
+
+    draws.assign(requests.size() * MAX_LOD_LEVELS, {0, 0, -1});
+    uint32_t outputSize = 0;
+    uint32_t stateSize = 0;
+    GLintptr commandOffset = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        CullRequest const &request = requests[i];
+        int const levels = levelCount(request);
+
+        CullEntry entry = {};
+        entry.world = request.world;
+        entry.sphere = request.ranges.empty()
+                       ? vec4(0.0f, 0.0f, 0.0f, -1.0f)
+                       : request.sphere;
+        entry.firstInstance = static_cast<uint32_t>(request.instanceBase);
+        entry.instanceCount = static_cast<uint32_t>(request.instanceCount);
+        entry.outputBase = outputSize;
+        entry.levelCount = static_cast<uint32_t>(levels);
+        for (int level = 0; level < levels; ++level) {
+            entry.lodErrors[level] = request.lodErrors[level];
+        }
+        entry.stateBase = stateSize;
+        std::memcpy(&input[HEADER_SIZE + i * sizeof(CullEntry)], &entry,
+                    sizeof(CullEntry));
+
+        // Each level gets room for every instance
+        size_t const meshes = request.ranges.size() / levels;
+        for (int level = 0; level < levels; ++level) {
+            CulledDraw &draw = draws[i * MAX_LOD_LEVELS + level];
+            draw.instanceBase = static_cast<GLint>(
+                    outputSize + level * entry.instanceCount);
+            if (request.ranges.empty()) {
+                draw.instanceCount = request.instanceCount;
+            } else {
+                draw.commands = commandOffset;
+                commandOffset += meshes * sizeof(DrawCommand);
+            }
+        }
+        outputSize += entry.instanceCount * levels;
+        stateSize += entry.instanceCount;
+    }
+
+    reserve(inputBuffer, input.size(), input.data(), GL_STREAM_DRAW);
+    reserve(countsBuffer, std::max<size_t>(requests.size(), 1) *
+                          MAX_LOD_LEVELS * sizeof(uint32_t),
+            nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countsBuffer.id());
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+                      GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (outputSize > visibleCapacity) {
+        visibleCapacity = std::max<size_t>(outputSize, 2 * visibleCapacity);
+        reserve(visibleBuffer, visibleCapacity * sizeof(uint32_t), nullptr,
+                GL_DYNAMIC_DRAW);
+    }
+    if (visibleCapacity > 0) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                         InstanceBuffer::ORDER_BINDING, visibleBuffer.id());
+    }
+
+    // A new store starts every instance at full detail; states are only
+    // ever read back clamped to the entry's levels
+    if (stateSize > lodStatesCapacity) {
+        lodStatesCapacity = std::max<size_t>(stateSize,
+                                             2 * lodStatesCapacity);
+        reserve(lodStatesBuffer, lodStatesCapacity * sizeof(uint32_t),
+                nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lodStatesBuffer.id());
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI,
+                          GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Visibility
+    cullShader->use();
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (requests[i].instanceCount <= 0) {
+            continue;
+        }
+        cullShader->set(ENTRY, static_cast<int>(i));
+        glDispatchCompute((requests[i].instanceCount + GROUP_SIZE - 1) /
+                          GROUP_SIZE, 1, 1);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Commands
+    if (!commands.empty()) {
+        commandShader->use();
+        commandShader->set(COMMAND_COUNT, static_cast<int>(commands.size()));
+        glDispatchCompute(static_cast<GLuint>(
+                (commands.size() + GROUP_SIZE - 1) / GROUP_SIZE), 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    }
+    copyCounts(requests);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandsBuffer.id());
+    return draws;
+}
+
+size_t InstanceCuller::commandCount() const {
+    return commands.size();
+}
+
+size_t InstanceCuller::triangleCount() const {
+    return drawnTriangles;
+}
+
+size_t InstanceCuller::fullDetailTriangleCount() const {
+    return fullDetailTriangles;
+}
+
+// ============================================= Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+// Commands only change with the meshes drawn, not with the camera. Each
+// level's commands read the visible count of that level.
+void InstanceCuller::layOutCommands(vector<CullRequest> const &requests) {
+    auto const sameRanges = [](vector<DrawRange> const &a,
+                               vector<DrawRange> const &b) {
+        return a.size() == b.size() &&
+               std::equal(a.begin(), a.end(), b.begin(),
+                          [](DrawRange const &x, DrawRange const &y) {
+                              return x.firstIndex == y.firstIndex &&
+                                     x.indexCount == y.indexCount;
+                          });
+    };
+    bool changed = requests.size() != commandLayout.size();
+    for (size_t i = 0; !changed && i < requests.size(); ++i) {
+        changed = !sameRanges(requests[i].ranges, commandLayout[i]) ||
+                  levelCount(requests[i]) != commandLevels[i];
+    }
+    if (!changed) {
+        return;
+    }
+
+    commandLayout.clear();
+    commandLevels.clear();
+    commands.clear();
+    commandEntries.clear();
+    for (size_t i = 0; i < requests.size(); ++i) {
+        CullRequest const &request = requests[i];
+        int const levels = levelCount(request);
+        commandLayout.push_back(request.ranges);
+        commandLevels.push_back(levels);
+
+        size_t const meshes = request.ranges.size() / levels;
+        for (size_t r = 0; r < meshes * levels; ++r) {
+            DrawRange const &range = request.ranges[r];
+            commands.push_back({static_cast<GLuint>(range.indexCount), 0,
+                                range.firstIndex, 0, 0});
+            commandEntries.push_back(static_cast<uint32_t>(
+                    i * MAX_LOD_LEVELS + r / meshes));
+        }
+    }
+
+    if (!commands.empty()) {
+        reserve(commandsBuffer, commands.size() * sizeof(DrawCommand),
+                commands.data(), GL_DYNAMIC_DRAW);
+        reserve(commandEntriesBuffer,
+                commandEntries.size() * sizeof(uint32_t),
+                commandEntries.data(), GL_STATIC_DRAW);
+    }
+}
+
+void InstanceCuller::copyCounts(vector<CullRequest> const &requests) {
+    size_t const bytes = std::max<size_t>(requests.size(), 1) *
+                         MAX_LOD_LEVELS * sizeof(uint32_t);
+    if (bytes > readbackStride) {
+        // A new store loses both slots
+        for (GLsync &fence : readbackFences) {
+            if (fence) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        readbackStride = std::max(bytes, 2 * readbackStride);
+        reserve(readbackBuffer, 2 * readbackStride, nullptr, GL_STREAM_READ);
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Triangles
+    // Direct draws have no ranges, and so count for nothing
+    vector<size_t> &level = levelTriangles[readbackSlot];
+    vector<size_t> &full = fullTriangles[readbackSlot];
+    level.assign(requests.size() * MAX_LOD_LEVELS, 0);
+    full.assign(level.size(), 0);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        CullRequest const &request = requests[i];
+        int const levels = levelCount(request);
+        size_t const meshes = request.ranges.size() / levels;
+        for (size_t r = 0; r < meshes * levels; ++r) {
+            level[i * MAX_LOD_LEVELS + r / meshes] +=
+                    request.ranges[r].indexCount / 3;
+        }
+        for (int l = 0; l < levels; ++l) {
+            full[i * MAX_LOD_LEVELS + l] = level[i * MAX_LOD_LEVELS];
+        }
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Copy
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, countsBuffer.id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer.id());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                        readbackSlot * readbackStride, bytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    readbackFences[readbackSlot] =
+            glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readbackSlot ^= 1;
+}
+
+void InstanceCuller::readCounts() {
+    // The newest finished copy wins; unfinished ones are not waited for
+    for (unsigned int age = 0; age < 2; ++age) {
+        unsigned int const slot = readbackSlot ^ 1 ^ age;
+        GLsync &fence = readbackFences[slot];
+        if (!fence) {
+            continue;
+        }
+
+        GLenum const status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED ||
+            status == GL_CONDITION_SATISFIED) {
+            vector<size_t> const &level = levelTriangles[slot];
+            vector<size_t> const &full = fullTriangles[slot];
+            vector<uint32_t> counts(level.size());
+            glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffer.id());
+            glGetBufferSubData(GL_COPY_READ_BUFFER,
+                               slot * readbackStride,
+                               counts.size() * sizeof(uint32_t),
+                               counts.data());
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+            drawnTriangles = 0;
+            fullDetailTriangles = 0;
+            for (size_t k = 0; k < counts.size(); ++k) {
+                drawnTriangles += counts[k] * level[k];
+                fullDetailTriangles += counts[k] * full[k];
+            }
+
+            glDeleteSync(fence);
+            fence = nullptr;
+            break;
+        }
+    }
+
+    // The slot about to be rewritten no longer needs its fence
+    GLsync &reused = readbackFences[readbackSlot];
+    if (reused) {
+        glDeleteSync(reused);
+        reused = nullptr;
+    }
+}
+
+// ///////////////////////////////////////////////////////////////////// //
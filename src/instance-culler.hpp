@@ -0,0 +1,135 @@
+#ifndef INSTANCE_CULLER_H
+#define INSTANCE_CULLER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-resources.hpp"
+#include "lod-selection.hpp"
+#include "opengl-headers.hpp"
+#include "renderable.hpp"
+#include "shader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ///////////////////////////////////////////////// Struct: DrawCommand //
+// DrawElementsIndirectCommand, as read by glDrawElementsIndirect
+struct DrawCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// ///////////////////////////////////////////////// Struct: CullRequest //
+// One draw of the scene: instances of a renderable under a world matrix
+struct CullRequest {
+    glm::mat4 world;
+    glm::vec4 sphere;       // model space; negative radius: never culled
+    GLint instanceBase;     // first instance in the InstanceBuffer
+    GLsizei instanceCount;
+
+    // Of the renderable's draws, for every level of detail in turn; none
+    // makes it draw directly
+    std::vector<DrawRange> ranges;
+    // One per level of detail, finest first
+    std::vector<float> lodErrors;
+};
+
+// ////////////////////////////////////////////////// Struct: CulledDraw //
+// One level of detail of a request
+struct CulledDraw {
+    GLint instanceBase;     // first of the draw's visible instances
+    GLsizei instanceCount;  // for direct draws
+    GLintptr commands;      // into the indirect buffer; negative: draw
+                            // directly, instanceCount instances
+};
+
+// /////////////////////////////////////////////// Class: InstanceCuller //
+// Frustum culling of instances on the GPU. A compute pass tests every
+// instance's bounding sphere, picks its level of detail, and compacts
+// the visible ones into the instance order the shaders read, level by
+// level; a second pass writes their number into one
+// DrawElementsIndirectCommand per mesh and level. The CPU only reads the
+// counts back, late and without waiting, for statistics.
+class InstanceCuller {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------------ Data --
+    static constexpr GLuint INPUT_BINDING = 6;
+    static constexpr GLuint COUNTS_BINDING = 7;
+    static constexpr GLuint COMMANDS_BINDING = 8;
+    static constexpr GLuint COMMAND_ENTRIES_BINDING = 9;
+    static constexpr GLuint LOD_STATES_BINDING = 10;
+
+    // ------------------------------------------------------- Behaviour --
+    InstanceCuller();
+
+    InstanceCuller(InstanceCuller const &) = delete;
+    InstanceCuller &operator=(InstanceCuller const &) = delete;
+
+    ~InstanceCuller();
+
+    // False when the compute shaders could not be built
+    bool available() const;
+
+    // Afterwards draws read the visible instances, and the commands stay
+    // bound as the GL_DRAW_INDIRECT_BUFFER; draws[i * MAX_LOD_LEVELS + l]
+    // is level l of requests[i]
+    std::vector<CulledDraw> const &cull(
+            glm::mat4 const &viewProjection, LodSelection const &lods,
+            std::vector<CullRequest> const &requests);
+
+    std::size_t commandCount() const;
+
+    // Of a recent cull, a frame or two behind: triangles drawn at the
+    // levels picked, and what the same instances take at full detail
+    std::size_t triangleCount() const;
+    std::size_t fullDetailTriangleCount() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------- Behaviour --
+    void layOutCommands(std::vector<CullRequest> const &requests);
+    void copyCounts(std::vector<CullRequest> const &requests);
+    void readCounts();
+
+    // ------------------------------------------------------------ Data --
+    GpuResource inputBuffer;
+    GpuResource countsBuffer;
+    GpuResource commandsBuffer;
+    GpuResource commandEntriesBuffer;
+    GpuResource visibleBuffer;
+    std::size_t visibleCapacity;
+
+    // Level each instance was last drawn at, for hysteresis
+    GpuResource lodStatesBuffer;
+    std::size_t lodStatesCapacity;
+
+    // Null when the compute shaders could not be built
+    std::unique_ptr<Shader> cullShader;
+    std::unique_ptr<Shader> commandShader;
+
+    // Ranges and levels per request the commands were laid out for
+    std::vector<std::vector<DrawRange>> commandLayout;
+    std::vector<int> commandLevels;
+    std::vector<DrawCommand> commands;
+    std::vector<std::uint32_t> commandEntries;
+
+    std::vector<unsigned char> input;
+    std::vector<CulledDraw> draws;
+
+    // Visible counts copied out for the CPU, one slot per frame in
+    // flight, each fenced after its copy, with the triangles one instance
+    // of each count stands for at its level and at full detail
+    GpuResource readbackBuffer;
+    std::size_t readbackStride;
+    GLsync readbackFences[2];
+    unsigned int readbackSlot;
+    std::vector<std::size_t> levelTriangles[2];
+    std::vector<std::size_t> fullTriangles[2];
+    std::size_t drawnTriangles;
+    std::size_t fullDetailTriangles;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // INSTANCE_CULLER_H
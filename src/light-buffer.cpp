@@ -0,0 +1,85 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "light-buffer.hpp"
+
+#include <cstring>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::vector;
+
+// ////////////////////////////////////////////////// Class: LightBuffer //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+LightBuffer::LightBuffer()
+        : blockBuffer(RT_BUFFER, "light block"),
+          lightsBuffer(RT_BUFFER, "lights"),
+          lightsCapacity(16),
+          uploadedBlock{},
+          valid(false),
+          uploads(0) {
+    glBindBuffer(GL_UNIFORM_BUFFER, blockBuffer.id());
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr,
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightsBuffer.id());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, lightsCapacity * sizeof(LightData),
+                 nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, BLOCK_BINDING, blockBuffer.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING,
+                     lightsBuffer.id());
+}
+
+bool LightBuffer::update(LightBlock const &block,
+                         vector<LightData> const &lights) {
+    // Callers value-initialize the structures, padding included, so
+    // comparing bytes is exact
+    bool const blockChanged =
+            !valid ||
+            std::memcmp(&block, &uploadedBlock, sizeof(LightBlock)) != 0;
+    bool const lightsChanged =
+            !valid || lights.size() != uploadedLights.size() ||
+            (!lights.empty() &&
+             std::memcmp(lights.data(), uploadedLights.data(),
+                         lights.size() * sizeof(LightData)) != 0);
+
+    if (blockChanged) {
+        glBindBuffer(GL_UNIFORM_BUFFER, blockBuffer.id());
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uploadedBlock = block;
+    }
+
+    if (lightsChanged && !lights.empty()) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightsBuffer.id());
+        if (lights.size() > lightsCapacity) {
+            while (lightsCapacity < lights.size()) {
+                lightsCapacity *= 2;
+            }
+            glBufferData(GL_SHADER_STORAGE_BUFFER,
+                         lightsCapacity * sizeof(LightData), nullptr,
+                         GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                        lights.size() * sizeof(LightData), lights.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    if (lightsChanged) {
+        uploadedLights = lights;
+    }
+
+    valid = true;
+    if (blockChanged || lightsChanged) {
+        ++uploads;
+        return true;
+    }
+    return false;
+}
+
+size_t LightBuffer::uploadCount() const {
+    return uploads;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
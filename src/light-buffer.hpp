@@ -0,0 +1,85 @@
+#ifndef LIGHT_BUFFER_H
+#define LIGHT_BUFFER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-resources.hpp"
+#include "opengl-headers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ///////////////////////////////////////////////////// Enum: LightType //
+// Values are shared with the shaders
+enum LightType {
+    LT_POINT,
+    LT_DIRECTIONAL,
+    LT_SPOT
+};
+
+// /////////////////////////////////////////////////// Struct: LightData //
+// std430 mirror of struct LightParameters in the shaders. Everything
+// the shaders could derive once per frame is derived here instead.
+struct LightData {
+    glm::vec4 direction;    // xyz: unit direction, w: enable
+    glm::vec4 position;     // xyz: position, w: range, negative if none
+    glm::vec4 attenuation;  // constant, linear, quadratic, unused
+    glm::vec4 ambient;      // rgb: color * intensity
+    glm::vec4 diffuse;      // rgb: color, a: intensity
+    glm::vec4 specular;     // rgb: color * intensity, a: shininess
+    float cosAngle;         // cosine of the spot angle
+    float inverseFalloff;   // 1 / (1 - cosAngle)
+    std::int32_t type;      // LightType
+    std::int32_t padding;
+};
+
+// ////////////////////////////////////////////////// Struct: LightBlock //
+// std140 mirror of the Lights uniform block: everything per frame that is
+// not a light
+struct LightBlock {
+    glm::mat4 view;
+    glm::vec4 projection;   // 1 / P[0][0], 1 / P[1][1], near, far
+    glm::vec4 clusterScale; // xy: tiles per pixel, zw: log depth to slice
+    glm::uvec4 clusterGrid; // tiles across, tiles down, slices, capacity
+    std::int32_t lightCount;
+    std::int32_t padding[3];
+};
+
+static_assert(sizeof(LightData) == 7 * 16, "LightData must match std430");
+static_assert(sizeof(LightBlock) == 8 * 16, "LightBlock must match std140");
+
+// ////////////////////////////////////////////////// Class: LightBuffer //
+// The Lights uniform block and the storage buffer with the lights
+// themselves. Both stay bound to their binding points, which the shaders
+// name in their layout qualifiers, and are only written when changed.
+class LightBuffer {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------------ Data --
+    static constexpr GLuint BLOCK_BINDING = 0;
+    static constexpr GLuint LIGHTS_BINDING = 1;
+
+    // ------------------------------------------------------- Behaviour --
+    LightBuffer();
+
+    LightBuffer(LightBuffer const &) = delete;
+    LightBuffer &operator=(LightBuffer const &) = delete;
+
+    // Returns whether anything had to be written
+    bool update(LightBlock const &block,
+                std::vector<LightData> const &lights);
+
+    std::size_t uploadCount() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    GpuResource blockBuffer;
+    GpuResource lightsBuffer;
+    std::size_t lightsCapacity;
+
+    LightBlock uploadedBlock;
+    std::vector<LightData> uploadedLights;
+    bool valid;
+    std::size_t uploads;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // LIGHT_BUFFER_H
@@ -0,0 +1,293 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "light-clusters.hpp"
+#include "thread-pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <limits>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::atomic;
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::make_unique;
+using std::size_t;
+using std::uint32_t;
+using std::vector;
+
+using glm::mat4;
+using glm::uvec4;
+using glm::vec2;
+using glm::vec3;
+using glm::vec4;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    char const *const BUILDER_SHADER = "res/shaders/clusters/compute.glsl";
+
+    // Must match local_size_x of the builder shader
+    unsigned int const GROUP_SIZE = 64;
+
+    // Everything closer than this shares the first slice, which keeps
+    // the slices from crowding around the near plane
+    float const FIRST_SLICE_DEPTH = 0.5f;
+
+    size_t const CLUSTER_GRAIN = 64;
+
+    // Largest offset alignment GL allows for shader storage bindings
+    GLintptr const OVERFLOW_SLOT_STRIDE = 256;
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    struct Bounds {
+        vec3 min;
+        vec3 max;
+    };
+
+    // View-space box around one froxel; the same computation as in the
+    // builder shader
+    Bounds clusterBounds(LightBlock const &block, unsigned int const cluster) {
+        unsigned int const x = cluster % LightClusters::TILES_X;
+        unsigned int const y = cluster / LightClusters::TILES_X
+                               % LightClusters::TILES_Y;
+        unsigned int const z = cluster / (LightClusters::TILES_X *
+                                          LightClusters::TILES_Y);
+
+        float const start = block.projection.z;
+        float const ratio = block.projection.w / start;
+        float const slices = static_cast<float>(LightClusters::SLICES);
+        float const depths[2] = {
+                z == 0 ? 0.0f : start * std::pow(ratio, z / slices),
+                start * std::pow(ratio, (z + 1) / slices)};
+
+        vec2 const tiles(LightClusters::TILES_X, LightClusters::TILES_Y);
+        vec2 const ndcMin = vec2(x, y) / tiles * 2.0f - 1.0f;
+        vec2 const ndcMax = vec2(x + 1, y + 1) / tiles * 2.0f - 1.0f;
+
+        Bounds bounds = {vec3(std::numeric_limits<float>::max()),
+                         vec3(-std::numeric_limits<float>::max())};
+        for (float const depth : depths) {
+            for (int corner = 0; corner < 4; ++corner) {
+                vec2 const ndc((corner & 1) ? ndcMax.x : ndcMin.x,
+                               (corner & 2) ? ndcMax.y : ndcMin.y);
+                vec3 const point(ndc.x * depth * block.projection.x,
+                                 ndc.y * depth * block.projection.y,
+                                 -depth);
+                bounds.min = glm::min(bounds.min, point);
+                bounds.max = glm::max(bounds.max, point);
+            }
+        }
+        return bounds;
+    }
+
+    bool intersects(Bounds const &bounds, vec4 const &sphere) {
+        vec3 const center(sphere);
+        vec3 const closest = glm::clamp(center, bounds.min, bounds.max);
+        vec3 const offset = center - closest;
+        return glm::dot(offset, offset) <= sphere.w * sphere.w;
+    }
+}
+
+// //////////////////////////////////////////////// Class: LightClusters //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+LightClusters::LightClusters()
+        : countsBuffer(RT_BUFFER, "cluster light counts"),
+          indicesBuffer(RT_BUFFER, "cluster light indices"),
+          overflowBuffer(RT_BUFFER, "cluster overflow counters"),
+          overflowFences{nullptr, nullptr},
+          overflowSlot(0),
+          counts(CLUSTER_COUNT, 0),
+          indices(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER, 0),
+          buildMilliseconds(0.0f),
+          builtLights(0),
+          overflowing(0) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countsBuffer.id());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, counts.size() * sizeof(uint32_t),
+                 counts.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indicesBuffer.id());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indices.size() * sizeof(uint32_t),
+                 nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, overflowBuffer.id());
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * OVERFLOW_SLOT_STRIDE,
+                 nullptr, GL_DYNAMIC_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTS_BINDING,
+                     countsBuffer.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING,
+                     indicesBuffer.id());
+
+    try {
+        builder = make_unique<Shader>(BUILDER_SHADER);
+    } catch (exception const &error) {
+        cerr << "Light clusters are built on the CPU: " << error.what()
+             << endl;
+    }
+}
+
+LightClusters::~LightClusters() {
+    for (GLsync const fence : overflowFences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+}
+
+void LightClusters::describe(LightBlock &block, mat4 const &projection,
+                             float const near, float const far,
+                             int const width, int const height) const {
+    float const start = std::max(near, FIRST_SLICE_DEPTH);
+    float const logRatio = std::log(far / start);
+
+    block.projection = vec4(1.0f / projection[0][0],
+                            1.0f / projection[1][1], start, far);
+    block.clusterScale = vec4(
+            TILES_X / static_cast<float>(std::max(width, 1)),
+            TILES_Y / static_cast<float>(std::max(height, 1)),
+            SLICES / logRatio,
+            -(SLICES * std::log(start)) / logRatio);
+    block.clusterGrid = uvec4(TILES_X, TILES_Y, SLICES,
+                              MAX_LIGHTS_PER_CLUSTER);
+}
+
+void LightClusters::build(LightBlock const &block,
+                          vector<LightData> const &lights,
+                          ClusterBuild const mode) {
+    builtLights = lights.size();
+    if (mode == CB_CPU || !builder) {
+        buildOnCpu(block, lights);
+        return;
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''' Overflow counter
+    readOverflow();
+
+    GLintptr const offset = overflowSlot * OVERFLOW_SLOT_STRIDE;
+    uint32_t const zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, overflowBuffer.id());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, sizeof(zero), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, OVERFLOW_BINDING,
+                      overflowBuffer.id(), offset, sizeof(uint32_t));
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Dispatch
+    builder->use();
+    glDispatchCompute((CLUSTER_COUNT + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    overflowFences[overflowSlot] =
+            glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    overflowSlot ^= 1;
+}
+
+bool LightClusters::gpuAvailable() const {
+    return builder != nullptr;
+}
+
+float LightClusters::cpuMilliseconds() const {
+    return buildMilliseconds;
+}
+
+size_t LightClusters::lightCount() const {
+    return builtLights;
+}
+
+uint32_t LightClusters::overflowingClusters() const {
+    return overflowing;
+}
+
+// ============================================= Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+void LightClusters::buildOnCpu(LightBlock const &block,
+                               vector<LightData> const &lights) {
+    auto const startTime = std::chrono::steady_clock::now();
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''' View-space spheres
+    // A negative radius marks lights that reach every cluster
+    vector<vec4> spheres(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i) {
+        vec4 const center = block.view * vec4(vec3(lights[i].position), 1.0f);
+        spheres[i] = vec4(vec3(center), lights[i].position.w);
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''' Cluster lists
+    atomic<uint32_t> overflows(0);
+    ThreadPool::shared().parallelFor(
+            CLUSTER_COUNT, CLUSTER_GRAIN,
+            [&](size_t const begin, size_t const end) {
+        uint32_t chunkOverflows = 0;
+        for (size_t cluster = begin; cluster < end; ++cluster) {
+            Bounds const bounds = clusterBounds(
+                    block, static_cast<unsigned int>(cluster));
+            uint32_t *const list = &indices[cluster * MAX_LIGHTS_PER_CLUSTER];
+
+            uint32_t count = 0;
+            for (size_t i = 0; i < spheres.size(); ++i) {
+                if (spheres[i].w < 0.0f || intersects(bounds, spheres[i])) {
+                    if (count == MAX_LIGHTS_PER_CLUSTER) {
+                        ++chunkOverflows;
+                        break;
+                    }
+                    list[count++] = static_cast<uint32_t>(i);
+                }
+            }
+            counts[cluster] = count;
+        }
+        overflows += chunkOverflows;
+    });
+    overflowing = overflows;
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Upload
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countsBuffer.id());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                    counts.size() * sizeof(uint32_t), counts.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indicesBuffer.id());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                    indices.size() * sizeof(uint32_t), indices.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::chrono::duration<float, std::milli> const elapsed =
+            std::chrono::steady_clock::now() - startTime;
+    buildMilliseconds = elapsed.count();
+}
+
+void LightClusters::readOverflow() {
+    // The newest finished build wins; unfinished ones are not waited for
+    for (unsigned int age = 0; age < 2; ++age) {
+        unsigned int const slot = overflowSlot ^ 1 ^ age;
+        GLsync &fence = overflowFences[slot];
+        if (!fence) {
+            continue;
+        }
+
+        GLenum const status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED ||
+            status == GL_CONDITION_SATISFIED) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, overflowBuffer.id());
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                               slot * OVERFLOW_SLOT_STRIDE,
+                               sizeof(overflowing), &overflowing);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+            glDeleteSync(fence);
+            fence = nullptr;
+            break;
+        }
+    }
+
+    // The slot about to be rewritten no longer needs its fence
+    GLsync &reused = overflowFences[overflowSlot];
+    if (reused) {
+        glDeleteSync(reused);
+        reused = nullptr;
+    }
+}
+
+// ///////////////////////////////////////////////////////////////////// //
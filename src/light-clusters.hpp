@@ -0,0 +1,91 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-resources.hpp"
+#include "light-buffer.hpp"
+#include "opengl-headers.hpp"
+#include "shader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ////////////////////////////////////////////////// Enum: ClusterBuild //
+enum ClusterBuild {
+    CB_GPU,     // compute shader, falls back to CB_CPU when unavailable
+    CB_CPU      // thread pool, results uploaded every frame
+};
+
+// //////////////////////////////////////////////// Class: LightClusters //
+// Per-froxel light lists for clustered forward shading. The view frustum
+// is cut into screen tiles and exponentially spaced depth slices; every
+// cluster stores the indices of the lights whose range reaches it, so a
+// fragment only loops over its own cluster's lights. Lists are capped at
+// MAX_LIGHTS_PER_CLUSTER; clusters reached by more lights drop the rest
+// and are counted.
+class LightClusters {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------------ Data --
+    static constexpr GLuint COUNTS_BINDING = 2;
+    static constexpr GLuint INDICES_BINDING = 3;
+    static constexpr GLuint OVERFLOW_BINDING = 11;
+
+    static constexpr unsigned int TILES_X = 16;
+    static constexpr unsigned int TILES_Y = 9;
+    static constexpr unsigned int SLICES = 24;
+    static constexpr unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    static constexpr unsigned int MAX_LIGHTS_PER_CLUSTER = 128;
+
+    // ------------------------------------------------------- Behaviour --
+    LightClusters();
+
+    LightClusters(LightClusters const &) = delete;
+    LightClusters &operator=(LightClusters const &) = delete;
+
+    ~LightClusters();
+
+    // Fills the projection and cluster fields of the frame's light block
+    void describe(LightBlock &block, glm::mat4 const &projection,
+                  float const near, float const far,
+                  int const width, int const height) const;
+
+    // The light block and lights must already be in the LightBuffer
+    void build(LightBlock const &block, std::vector<LightData> const &lights,
+               ClusterBuild const mode);
+
+    bool gpuAvailable() const;
+    float cpuMilliseconds() const;
+
+    // Of the last build
+    std::size_t lightCount() const;
+    // Clusters that lost lights to the cap; the GPU's count is read back
+    // without stalling, so it lags its build by a frame or two
+    std::uint32_t overflowingClusters() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------- Behaviour --
+    void buildOnCpu(LightBlock const &block,
+                    std::vector<LightData> const &lights);
+    void readOverflow();
+
+    // ------------------------------------------------------------ Data --
+    GpuResource countsBuffer;
+    GpuResource indicesBuffer;
+    // One counter per frame in flight, each fenced after its build
+    GpuResource overflowBuffer;
+    GLsync overflowFences[2];
+    unsigned int overflowSlot;
+
+    // Null when the compute shader could not be built
+    std::unique_ptr<Shader> builder;
+
+    std::vector<std::uint32_t> counts;
+    std::vector<std::uint32_t> indices;
+    float buildMilliseconds;
+    std::size_t builtLights;
+    std::uint32_t overflowing;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // LIGHT_CLUSTERS_H
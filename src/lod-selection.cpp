@@ -0,0 +1,55 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "lod-selection.hpp"
+
+#include <algorithm>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using glm::mat4;
+using glm::vec3;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    // Instances around the eye are as near as this, not nearer
+    float const MIN_DISTANCE = 0.01f;
+}
+
+// //////////////////////////////////////////////// Struct: LodSelection //
+LodSelection describeLodSelection(vec3 const &eye, mat4 const &projection,
+                                  int const viewportHeight,
+                                  float const threshold,
+                                  float const hysteresis) {
+    // projection[1][1] is the cotangent of half the vertical field of view
+    return {eye, projection[1][1] * 0.5f * viewportHeight, threshold,
+            hysteresis};
+}
+
+// /////////////////////////////////////////////////////////// Selection //
+int selectLod(LodSelection const &selection, float const *errors,
+              int const levelCount, int const current, float const scale,
+              float const distance) {
+    if (selection.pixelScale <= 0.0f || levelCount <= 1) {
+        return 0;
+    }
+
+    float const pixels = selection.pixelScale * scale /
+                         std::max(distance, MIN_DISTANCE);
+    int level = std::min(std::max(current, 0), levelCount - 1);
+
+    // Too coarse refines at once, as far as it takes
+    if (errors[level] * pixels > selection.threshold) {
+        while (level > 0 && errors[level] * pixels > selection.threshold) {
+            --level;
+        }
+        return level;
+    }
+
+    float const coarsening = selection.threshold *
+                             (1.0f - selection.hysteresis);
+    while (level + 1 < levelCount &&
+           errors[level + 1] * pixels <= coarsening) {
+        ++level;
+    }
+    return level;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,37 @@
+#ifndef LOD_SELECTION_H
+#define LOD_SELECTION_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+// //////////////////////////////////////////////// Struct: LodSelection //
+// How levels of detail are picked this frame: every instance gets the
+// coarsest level whose error, projected onto the screen, stays within
+// the threshold. res/shaders/culling/instances.glsl does the same.
+struct LodSelection {
+    glm::vec3 eye;
+    // Pixels one unit of error covers one unit in front of the eye; zero
+    // keeps every instance at full detail
+    float pixelScale;
+    // Largest projected error of a level, in pixels
+    float threshold;
+    // Coarser levels must stay this share below the threshold, so that
+    // instances near it do not switch back and forth
+    float hysteresis;
+};
+
+LodSelection describeLodSelection(glm::vec3 const &eye,
+                                  glm::mat4 const &projection,
+                                  int const viewportHeight,
+                                  float const threshold,
+                                  float const hysteresis);
+
+// /////////////////////////////////////////////////////////// Selection //
+// Level for an instance last drawn at level current, whose bounding
+// sphere is distance away from the eye and whose transform scales errors
+// by scale; errors holds one per level, finest first
+int selectLod(LodSelection const &selection, float const *errors,
+              int const levelCount, int const current, float const scale,
+              float const distance);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // LOD_SELECTION_H
@@ -1,16 +1,37 @@
 // //////////////////////////////////////////////////////////// Includes //
+#include "bvh.hpp"
+#include "deferred-renderer.hpp"
+#include "frustum-culler.hpp"
+#include "gpu-counter.hpp"
+#include "gpu-resources.hpp"
+#include "gpu-timer.hpp"
+#include "instance-buffer.hpp"
+#include "instance-culler.hpp"
+#include "light-buffer.hpp"
+#include "light-clusters.hpp"
+#include "lod-selection.hpp"
 #include "model.hpp"
+#include "model-streamer.hpp"
 #include "opengl-headers.hpp"
+#include "scene-graph.hpp"
 #include "shader.hpp"
+#include "shading-features.hpp"
+#include "texture.hpp"
+#include "texture-registry.hpp"
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <random>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 using sysclock = std::chrono::system_clock;
@@ -25,19 +46,26 @@ using glm::radians;
 using glm::rotate;
 using glm::scale;
 using glm::value_ptr;
+using glm::vec2;
 using glm::vec3;
+using glm::vec4;
 
 using std::array;
 using std::begin;
 using std::cerr;
+using std::cout;
 using std::end;
 using std::endl;
 using std::exception;
 using std::make_shared;
 using std::make_unique;
+using std::pair;
 using std::shared_ptr;
+using std::size_t;
 using std::string;
 using std::stringstream;
+using std::uint32_t;
+using std::uint8_t;
 using std::unique_ptr;
 using std::vector;
 
@@ -63,12 +91,12 @@ vec3 ImVec4ToVec3(ImVec4 a) {
 ImVec4 Vec3ToImVec4(vec3 a) {
     return {a.x, a.y, a.z, 1.0};
 }
-// ///////////////////////////////////////////////////// Enum: LightType //
-enum LightType {
-    LT_POINT,
-    LT_DIRECTIONAL,
-    LT_SPOT
-};
+// //////////////////////////////////////////////////////////// Uniforms //
+Uniform<mat4> const TRANSFORM("transform");
+Uniform<mat4> const WORLD("world");
+Uniform<vec3> const VIEW_POS("viewPos");
+Uniform<int> const INSTANCE_BASE("instanceBase");
+
 // ///////////////////////////////////////////// Struct: LightParameters //
 struct LightParameters {
     string name;
@@ -88,29 +116,62 @@ struct LightParameters {
     ImVec4 specularColor;
     float specularShininess;
 
-    void setShaderParameters(shared_ptr<Shader> shader) {
-        shader->uniform1i("pbrEnabled", (int)pbrEnabled);
-
-        shader->uniform1f(name + ".enable", enable);
-
-        shader->uniform3f(name + ".direction", ImVec4ToVec3(direction));
-        shader->uniform3f(name + ".position", ImVec4ToVec3(position));
-        shader->uniform1f(name + ".angle", angle);
+    // Distance at which the light drops below 1/256 of its brightness,
+    // negative for lights that reach everywhere
+    float range() const {
+        if (type == LT_DIRECTIONAL) {
+            return -1.0f;
+        }
 
-        shader->uniform1f(name + ".attenuationConstant", attenuationConstant);
-        shader->uniform1f(name + ".attenuationLinear", attenuationLinear);
-        shader->uniform1f(name + ".attenuationQuadratic", attenuationQuadratic);
+        auto const maximum = [](ImVec4 const &color) {
+            return std::max(color.x, std::max(color.y, color.z));
+        };
+        float const brightness = enable * std::max(
+            std::max(diffuseIntensity, 1.0f) * maximum(diffuseColor),
+            std::max(ambientIntensity * maximum(ambientColor),
+                     specularIntensity * maximum(specularColor)));
+
+        // Solve constant + linear * d + quadratic * d^2 = 256 * brightness
+        float const target = 256.0f * brightness - attenuationConstant;
+        if (target <= 0.0f) {
+            return 0.0f;
+        }
+        if (attenuationQuadratic > 0.0f) {
+            return (-attenuationLinear +
+                    std::sqrt(attenuationLinear * attenuationLinear +
+                              4.0f * attenuationQuadratic * target)) /
+                   (2.0f * attenuationQuadratic);
+        }
+        if (attenuationLinear > 0.0f) {
+            return target / attenuationLinear;
+        }
+        return -1.0f;
+    }
 
-        shader->uniform1f(name + ".ambientIntensity", ambientIntensity);
-        shader->uniform3f(name + ".ambientColor",
-                          ImVec4ToVec3(ambientColor));
-        shader->uniform1f(name + ".diffuseIntensity", diffuseIntensity);
-        shader->uniform3f(name + ".diffuseColor",
-                          ImVec4ToVec3(diffuseColor));
-        shader->uniform1f(name + ".specularIntensity", specularIntensity);
-        shader->uniform3f(name + ".specularColor",
-                          ImVec4ToVec3(specularColor));
-        shader->uniform1f(name + ".specularShininess", specularShininess);
+    LightData pack() const {
+        vec3 const lightDirection = ImVec4ToVec3(direction);
+        float const directionLength = glm::length(lightDirection);
+        float const cosAngle = std::cos(angle);
+
+        LightData data;
+        data.direction = vec4(directionLength > 0.0f
+                                  ? lightDirection / directionLength
+                                  : lightDirection,
+                              enable);
+        data.position = vec4(ImVec4ToVec3(position), range());
+        data.attenuation = vec4(attenuationConstant, attenuationLinear,
+                                attenuationQuadratic, 0.0f);
+        data.ambient = vec4(ambientIntensity * ImVec4ToVec3(ambientColor),
+                            0.0f);
+        data.diffuse = vec4(ImVec4ToVec3(diffuseColor), diffuseIntensity);
+        data.specular = vec4(specularIntensity * ImVec4ToVec3(specularColor),
+                             specularShininess);
+        data.cosAngle = cosAngle;
+        data.inverseFalloff = cosAngle < 1.0f ? 1.0f / (1.0f - cosAngle)
+                                              : 0.0f;
+        data.type = type;
+        data.padding = 0;
+        return data;
     }
 };
 
@@ -184,42 +245,554 @@ LightParameters lightSpot2 = {
     {1.0, 1.0, 1.0, 1.0},
     256.0};
 
+// ///////////////////////////////////////////////////// Enum: ScenePass //
+enum ScenePass {
+    SP_DEPTH,       // models with a depth shader, depth only
+    SP_FORWARD,     // everything, lit as it is drawn
+    SP_GEOMETRY,    // models with a G-buffer shader, into the G-buffer
+    SP_OVERLAY      // models without one, forward on top of the lit frame
+};
+
 // /////////////////////////////////////////////////// Struct: GraphNode //
+// The scene's draw entries, each a model's instances under a node of a
+// SceneGraph. Entries are added once and keep their model; transform
+// mirrors the world matrices of their nodes and only changes where the
+// graph moved them. Lists are swapped through setInstances, which marks
+// what has to be uploaded and rebuilt.
 struct GraphNode {
     vector<mat4> transform;
     vector<shared_ptr<Renderable>> model;
-    vector<int> instances;
-    vector<vec3> offset;
+    vector<SharedInstanceList> instances;
+    vector<SceneGraph::NodeId> node;
     GLuint overrideTexture;
 
     GraphNode() : overrideTexture(0) {}
 
-    void render(mat4 const &vp = mat4(1.0f)) {
+    // Returns the new entry's index
+    size_t add(SceneGraph const &graph, SceneGraph::NodeId const at,
+               shared_ptr<Renderable> const &entryModel,
+               SharedInstanceList const &list) {
+        size_t const entry = model.size();
+        transform.push_back(graph.world(at));
+        model.push_back(entryModel);
+        instances.push_back(list);
+        node.push_back(at);
+
+        if (entriesByNode.size() <= at) {
+            entriesByNode.resize(at + 1);
+        }
+        entriesByNode[at].push_back(entry);
+
+        listsChanged = true;
+        hierarchyStale = true;
+        trianglesStale = true;
+        return entry;
+    }
+
+    void setInstances(size_t const entry, SharedInstanceList const &list) {
+        if (instances[entry] != list) {
+            instances[entry] = list;
+            listsChanged = true;
+            hierarchyStale = true;
+        }
+    }
+
+    // Call when models have become resident; until then they have no
+    // bounds or levels to count
+    void residencyChanged() {
+        hierarchyStale = true;
+        trianglesStale = true;
+    }
+
+    // Whether a list changed since the last uploadInstances
+    bool needsUpload() const {
+        return listsChanged;
+    }
+
+    // Picks up what the last update of graph moved
+    void updateTransforms(SceneGraph const &graph) {
+        for (SceneGraph::NodeId const changed : graph.changed()) {
+            if (changed >= entriesByNode.size()) {
+                continue;
+            }
+            for (size_t const entry : entriesByNode[changed]) {
+                transform[entry] = graph.world(changed);
+                movedEntries.push_back(entry);
+            }
+        }
+    }
+
+    // Must be called whenever needsUpload says so, before render; draws
+    // every instance at full detail until culled
+    void uploadInstances(InstanceBuffer &buffer) {
+        buffer.update(instances);
+        instanceBases.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); ++i) {
+            instanceBases[i] = buffer.base(i);
+        }
+        listsChanged = false;
+        drawAll(buffer);
+    }
+
+    // Undoes the last culling or level selection, if there was one
+    void drawEverything(InstanceBuffer &buffer) {
+        if (culled) {
+            drawAll(buffer);
+        } else if (trianglesStale) {
+            countTriangles();
+        }
+    }
+
+    // Only picks every instance's level of detail, culling nothing
+    int selectLods(InstanceBuffer &buffer, LodSelection const &lods) {
+        return uploadVisible(buffer, vector<size_t>(model.size(), NO_ITEMS),
+                             lods);
+    }
+
+    // The same on the CPU: only the visible instances are uploaded, and
+    // entries without any are skipped altogether. Returns how many were.
+    int cullInstancesOnCpu(FrustumCuller &culler, InstanceBuffer &buffer,
+                           mat4 const &vp, LodSelection const &lods) {
+        culler.clear();
+        vector<size_t> firstVolume(model.size(), NO_ITEMS);
+        for (size_t i = 0; i < model.size(); ++i) {
+            vec3 boundsMin, boundsMax;
+            if (model[i] && model[i]->isResident() &&
+                model[i]->boundingBox(boundsMin, boundsMax)) {
+                firstVolume[i] = culler.size();
+                float const radius = model[i]->boundingSphere().w;
+                for (InstanceData const &instance : *instances[i]) {
+                    culler.add(boundsMin, boundsMax, radius,
+                               transform[i] * instance.model);
+                }
+            }
+        }
+        culler.cull(vp);
+
+        visibility.resize(culler.size());
+        for (size_t volume = 0; volume < culler.size(); ++volume) {
+            visibility[volume] = culler.visible(volume) ? 1 : 0;
+        }
+        return uploadVisible(buffer, firstVolume, lods);
+    }
+
+    // Keeps the hierarchy over every instance's world box current. It is
+    // rebuilt when entries, their lists or their residency change, and
+    // otherwise only refitted where updateTransforms moved an entry, as
+    // it does the point light's dummy every frame.
+    void updateHierarchy() {
+        if (hierarchyStale) {
+            buildHierarchy();
+            hierarchyStale = false;
+            movedEntries.clear();
+            return;
+        }
+
+        vector<size_t> moved;
+        size_t movedItems = 0;
+        for (size_t const i : movedEntries) {
+            if (firstItem[i] != NO_ITEMS) {
+                moved.push_back(i);
+                movedItems += instances[i]->size();
+            }
+        }
+        movedEntries.clear();
+
+        // Past a few items, one pass over the whole tree beats walking up
+        // from each of them
+        bool const refitAll = movedItems * 8 > hierarchy.itemCount();
+        for (size_t const i : moved) {
+            Aabb local;
+            model[i]->boundingBox(local.min, local.max);
+            for (size_t j = 0; j < instances[i]->size(); ++j) {
+                uint32_t const item = static_cast<uint32_t>(firstItem[i] + j);
+                Aabb const box = local.transformed(
+                    transform[i] * (*instances[i])[j].model);
+                if (refitAll) {
+                    hierarchy.setBox(item, box);
+                } else {
+                    hierarchy.update(item, box);
+                }
+            }
+        }
+        if (refitAll) {
+            hierarchy.refit();
+        }
+    }
+
+    // Like cullInstancesOnCpu, but walks the hierarchy instead of testing
+    // every instance; updateHierarchy must have been called
+    int cullInstancesWithHierarchy(InstanceBuffer &buffer, mat4 const &vp,
+                                   LodSelection const &lods) {
+        auto const startTime = std::chrono::steady_clock::now();
+
+        vec4 planes[6];
+        extractFrustumPlanes(vp, planes);
+        visibleItems.clear();
+        hierarchy.frustumQuery(planes, visibleItems);
+
+        visibility.assign(hierarchy.itemCount(), 0);
+        for (uint32_t const item : visibleItems) {
+            visibility[item] = 1;
+        }
+
+        std::chrono::duration<float, std::micro> const elapsed =
+            std::chrono::steady_clock::now() - startTime;
+        queryMicroseconds = elapsed.count();
+        return uploadVisible(buffer, firstItem, lods);
+    }
+
+    // Nearest instance whose world box the ray enters, as its entry and
+    // its index in the entry's list
+    bool pick(vec3 const &origin, vec3 const &direction, size_t &entry,
+              size_t &instance) const {
+        uint32_t item;
+        float distance;
+        if (!hierarchy.raycast(origin, direction, item, distance)) {
+            return false;
+        }
+        entry = itemOwners[item].first;
+        instance = itemOwners[item].second;
+        return true;
+    }
+
+    // The count instances inside vp that cover the most of the view from
+    // eye, biggest first, as entries and indices in their lists;
+    // updateHierarchy must have been called
+    void selectOccluders(mat4 const &vp, vec3 const &eye, size_t const count,
+                         vector<pair<size_t, size_t>> &picks) const {
+        vec4 planes[6];
+        extractFrustumPlanes(vp, planes);
+        vector<uint32_t> items;
+        hierarchy.selectOccluders(planes, eye, count, items);
+
+        picks.clear();
+        for (uint32_t const item : items) {
+            picks.push_back(itemOwners[item]);
+        }
+    }
+
+    Bvh const &boundingHierarchy() const {
+        return hierarchy;
+    }
+
+    size_t hierarchyBuilds() const {
+        return builds;
+    }
+
+    size_t hierarchyVisibleCount() const {
+        return visibleItems.size();
+    }
+
+    float hierarchyMicroseconds() const {
+        return queryMicroseconds;
+    }
+
+    // Until the next upload, models only draw their instances inside the
+    // frustum of vp, each at the level of detail lods picks
+    void cullInstances(InstanceCuller &culler, mat4 const &vp,
+                       LodSelection const &lods) {
+        vector<CullRequest> requests(model.size());
+        for (size_t i = 0; i < model.size(); ++i) {
+            CullRequest &request = requests[i];
+            request.world = transform[i];
+            request.instanceBase = instanceBases[i];
+
+            // Streaming models are not drawn, and their meshes may still
+            // be filling in
+            if (model[i] && model[i]->isResident()) {
+                request.sphere = model[i]->boundingSphere();
+                request.instanceCount =
+                    static_cast<GLsizei>(instances[i]->size());
+                request.ranges = model[i]->drawRanges();
+                for (int lod = 0; lod < model[i]->lodCount(); ++lod) {
+                    request.lodErrors.push_back(model[i]->lodError(lod));
+                }
+            } else {
+                request.sphere = vec4(0.0f, 0.0f, 0.0f, -1.0f);
+                request.instanceCount = 0;
+            }
+        }
+        draws = culler.cull(vp, lods, requests);
+        culled = true;
+    }
+
+    // Of the last upload or CPU culling; the GPU keeps its own counts
+    size_t triangleCount() const {
+        return drawnTriangles;
+    }
+
+    size_t fullDetailTriangleCount() const {
+        return fullDetailTriangles;
+    }
+
+    // After a depth pre-pass, the models it covered are only shaded
+    // where their depth is already the nearest one
+    void render(mat4 const &vp = mat4(1.0f),
+                ScenePass const pass = SP_FORWARD,
+                bool const depthPrepassed = false) {
         for (int i = 0; i < model.size(); i++) {
+            if (!model[i] || !model[i]->isResident()) {
+                continue;
+            }
+
+            bool const deferred = model[i]->gbufferShader != nullptr;
+            if ((pass == SP_GEOMETRY && !deferred) ||
+                (pass == SP_OVERLAY && deferred) ||
+                (pass == SP_DEPTH && !model[i]->depthShader)) {
+                continue;
+            }
+
             mat4 renderTransform = vp * transform[i];
+            for (int lod = 0; lod < MAX_LOD_LEVELS; ++lod) {
+                CulledDraw const &draw = draws[i * MAX_LOD_LEVELS + lod];
+                bool const indirect = draw.commands >= 0;
+                if (!indirect && draw.instanceCount == 0) {
+                    continue;
+                }
+
+                if (pass == SP_DEPTH) {
+                    Shader &shader = *model[i]->depthShader;
+                    shader.use();
+                    shader.set(TRANSFORM, renderTransform);
+                    shader.set(INSTANCE_BASE, draw.instanceBase);
+
+                    if (indirect) {
+                        model[i]->renderDepthIndirect(model[i]->depthShader,
+                                                      draw.commands);
+                    } else {
+                        model[i]->renderDepth(model[i]->depthShader,
+                                              draw.instanceCount, lod);
+                    }
+                    continue;
+                }
+
+                bool const equalDepth =
+                    depthPrepassed && model[i]->depthShader;
+                glDepthFunc(equalDepth ? GL_EQUAL : GL_LESS);
+                glDepthMask(equalDepth ? GL_FALSE : GL_TRUE);
+
+                shared_ptr<Shader> const &program =
+                    pass == SP_GEOMETRY ? model[i]->gbufferShader
+                                        : model[i]->shader;
+                Shader &shader = *program;
+                shader.use();
+                shader.set(TRANSFORM, renderTransform);
+                shader.set(WORLD, transform[i]);
+                shader.set(VIEW_POS, cameraPos);
+                shader.set(INSTANCE_BASE, draw.instanceBase);
+
+                if (indirect) {
+                    model[i]->renderIndirect(program, draw.commands,
+                                             overrideTexture);
+                } else {
+                    model[i]->render(program, draw.instanceCount,
+                                     overrideTexture, lod);
+                }
+            }
+        }
+
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+private:
+    // Entries without bounds have no items and are never culled
+    static constexpr size_t NO_ITEMS = std::numeric_limits<size_t>::max();
+
+    bool resident(size_t const i) const {
+        return model[i] && model[i]->isResident();
+    }
+
+    void buildHierarchy() {
+        firstItem.assign(model.size(), NO_ITEMS);
+        itemOwners.clear();
+
+        vector<Aabb> boxes;
+        for (size_t i = 0; i < model.size(); ++i) {
+            Aabb local;
+            if (!resident(i) ||
+                !model[i]->boundingBox(local.min, local.max)) {
+                continue;
+            }
+            firstItem[i] = boxes.size();
+            for (size_t j = 0; j < instances[i]->size(); ++j) {
+                boxes.push_back(local.transformed(
+                    transform[i] * (*instances[i])[j].model));
+                itemOwners.emplace_back(i, j);
+            }
+        }
+        hierarchy.build(boxes);
+        ++builds;
+    }
+
+    // Uploads the order of the instances left in visibility, whose items
+    // start at itemStarts for each entry, grouped by the level of detail
+    // lods picks, and points the draws at it. Returns how many entries
+    // were left without any.
+    int uploadVisible(InstanceBuffer &buffer,
+                      vector<size_t> const &itemStarts,
+                      LodSelection const &lods) {
+        size_t instanceTotal = 0;
+        for (SharedInstanceList const &list : instances) {
+            instanceTotal += list->size();
+        }
+        lodStates.resize(instanceTotal, 0);
+
+        int skipped = 0;
+        size_t stateBase = 0;
+        order.clear();
+        for (size_t i = 0; i < model.size(); ++i) {
+            InstanceList const &list = *instances[i];
+            uint32_t const first = static_cast<uint32_t>(instanceBases[i]);
+
+            int levels = 1;
+            float errors[MAX_LOD_LEVELS] = {};
+            vec4 sphere(0.0f, 0.0f, 0.0f, -1.0f);
+            if (resident(i)) {
+                levels = model[i]->lodCount();
+                for (int lod = 0; lod < levels; ++lod) {
+                    errors[lod] = model[i]->lodError(lod);
+                }
+                sphere = model[i]->boundingSphere();
+            }
+
+            for (vector<uint32_t> &bucket : lodBuckets) {
+                bucket.clear();
+            }
+            for (uint32_t j = 0; j < list.size(); ++j) {
+                if (itemStarts[i] != NO_ITEMS &&
+                    !visibility[itemStarts[i] + j]) {
+                    continue;
+                }
+
+                // Out of view, instances keep the level they were last
+                // drawn at
+                int lod = 0;
+                if (levels > 1 && sphere.w >= 0.0f) {
+                    mat4 const world = transform[i] * list[j].model;
+                    vec3 const center = vec3(world * vec4(vec3(sphere), 1.0f));
+                    float const scale = std::sqrt(std::max(
+                        glm::dot(vec3(world[0]), vec3(world[0])),
+                        std::max(glm::dot(vec3(world[1]), vec3(world[1])),
+                                 glm::dot(vec3(world[2]), vec3(world[2])))));
+                    float const distance =
+                        glm::length(center - lods.eye) - sphere.w * scale;
+
+                    uint8_t &state = lodStates[stateBase + j];
+                    lod = selectLod(lods, errors, levels, state, scale,
+                                    distance);
+                    state = static_cast<uint8_t>(lod);
+                }
+                lodBuckets[lod].push_back(first + j);
+            }
+            stateBase += list.size();
+
+            GLsizei visibleCount = 0;
+            for (int lod = 0; lod < MAX_LOD_LEVELS; ++lod) {
+                vector<uint32_t> const &bucket = lodBuckets[lod];
+                draws[i * MAX_LOD_LEVELS + lod] = {
+                    static_cast<GLint>(order.size()),
+                    static_cast<GLsizei>(bucket.size()), -1};
+                order.insert(order.end(), bucket.begin(), bucket.end());
+                visibleCount += static_cast<GLsizei>(bucket.size());
+            }
+            skipped += visibleCount == 0 && !list.empty() ? 1 : 0;
+        }
+        buffer.uploadOrder(order);
+        culled = true;
+        countTriangles();
+        return skipped;
+    }
+
+    // Every instance of every entry at full detail, in submission order
+    void drawAll(InstanceBuffer &buffer) {
+        buffer.bindOrder();
+        draws.assign(instances.size() * MAX_LOD_LEVELS, {0, 0, -1});
+        for (size_t i = 0; i < instances.size(); ++i) {
+            draws[i * MAX_LOD_LEVELS] = {
+                instanceBases[i], static_cast<GLsizei>(instances[i]->size()),
+                -1};
+        }
+        culled = false;
+        countTriangles();
+    }
 
-            if (model[i]) {
-                model[i]->shader->use();
-                model[i]->shader->uniformMatrix4fv("transform",
-                                                   value_ptr(
-                                                       renderTransform));
-                model[i]->shader->uniformMatrix4fv("world",
-                                                   value_ptr(
-                                                       transform[i]));
-                model[i]->shader->uniform3f("viewPos", cameraPos.x,
-                                            cameraPos.y,
-                                            cameraPos.z);
-                model[i]->shader->uniform3f("offset", offset[i]);
-
-                lightDirectional.setShaderParameters(model[i]->shader);
-                lightPoint.setShaderParameters(model[i]->shader);
-                lightSpot1.setShaderParameters(model[i]->shader);
-                lightSpot2.setShaderParameters(model[i]->shader);
-
-                model[i]->render(model[i]->shader, instances[i], overrideTexture);
+    void countTriangles() {
+        // ''''''''''''''''''''''''''''''''''''''''''''' Triangles per entry
+        // Non-resident models count for nothing until they arrive
+        if (trianglesStale) {
+            entryTriangles.assign(model.size(), {});
+            for (size_t i = 0; i < model.size(); ++i) {
+                if (!resident(i)) {
+                    continue;
+                }
+                vector<DrawRange> const ranges = model[i]->drawRanges();
+                int const levels = model[i]->lodCount();
+                if (ranges.empty()) {
+                    continue;
+                }
+
+                size_t const meshes = ranges.size() / levels;
+                for (int lod = 0; lod < MAX_LOD_LEVELS; ++lod) {
+                    int const level = std::min(lod, levels - 1);
+                    for (size_t m = 0; m < meshes; ++m) {
+                        entryTriangles[i][lod] +=
+                            ranges[level * meshes + m].indexCount / 3;
+                    }
+                }
+            }
+            trianglesStale = false;
+        }
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Sums
+        drawnTriangles = 0;
+        fullDetailTriangles = 0;
+        for (size_t i = 0; i < model.size(); ++i) {
+            for (int lod = 0; lod < MAX_LOD_LEVELS; ++lod) {
+                size_t const count =
+                    draws[i * MAX_LOD_LEVELS + lod].instanceCount;
+                drawnTriangles += count * entryTriangles[i][lod];
+                fullDetailTriangles += count * entryTriangles[i][0];
             }
         }
     }
+
+    // By node of the graph the entries were added from
+    vector<vector<size_t>> entriesByNode;
+    vector<size_t> movedEntries;
+
+    // MAX_LOD_LEVELS per entry, finest first
+    vector<CulledDraw> draws;
+    // Where each entry's instances start in the InstanceBuffer; culling
+    // points the draws elsewhere
+    vector<GLint> instanceBases;
+    vector<uint32_t> order;
+    vector<uint8_t> visibility;
+
+    // Level each instance of each entry was last drawn at
+    vector<uint8_t> lodStates;
+    array<vector<uint32_t>, MAX_LOD_LEVELS> lodBuckets;
+    // Since the last drawAll
+    bool culled = false;
+
+    // Of every entry's model at each level, clamped to the ones it has
+    vector<array<size_t, MAX_LOD_LEVELS>> entryTriangles;
+    size_t drawnTriangles = 0;
+    size_t fullDetailTriangles = 0;
+
+    // What add, setInstances and residencyChanged left out of date
+    bool listsChanged = false;
+    bool hierarchyStale = false;
+    bool trianglesStale = false;
+
+    Bvh hierarchy;
+
+    vector<size_t> firstItem;
+    vector<pair<size_t, size_t>> itemOwners;
+    vector<uint32_t> visibleItems;
+    size_t builds = 0;
+    float queryMicroseconds = 0.0f;
 };
 
 // /////////////////////////////////////////////////////////// Constants //
@@ -227,17 +800,39 @@ int const WINDOW_WIDTH = 1589;
 int const WINDOW_HEIGHT = 982;
 char const *WINDOW_TITLE = "Tomasz Witczak 216920 - Zadanie 4";
 
+float const NEAR_PLANE = 0.01f;
+float const FAR_PLANE = 100.0f;
+
+int const EXTRA_LIGHTS_MAX = 1024;
+
+// Held by the GPU timing run, so that runs on different builds draw and
+// shade the same scene
+int const TIMING_EXTRA_LIGHTS = 256;
+int const TIMING_TEAPOTS = 2500;
+int const TIMING_WARMUP_FRAMES = 60;
+int const TIMING_SAMPLE_FRAMES = 300;
+
+int const TEAPOT_INSTANCES_MAX = 40000;
+float const INSTANCE_SPACING = 6.4f;
+
+size_t const OCCLUDERS_SHOWN = 4;
+
 // /////////////////////////////////////////////////////////// Variables //
 // ----------------------------------------------------------- Window -- //
 GLFWwindow *window = nullptr;
 
 // ---------------------------------------------------------- Shaders -- //
-shared_ptr<Shader> modelShader,
+shared_ptr<Shader> depthShader,
     sphereShader;
 
+// Lit programs, by ShadingFeature key
+unique_ptr<ShaderPermutations> modelShaders,
+    modelGeometryStageShaders,
+    gbufferShaders;
+
 // --------------------------------------------------------- Textures -- //
-GLuint plywoodTexture = 0,
-       metalTexture = 0;
+TextureHandle plywoodTexture,
+              metalTexture;
 
 // ----------------------------------------------------------- Camera -- //
 vec3 cameraFront(1.0f, 0.0f, 0.0f),
@@ -260,67 +855,204 @@ GLfloat mouseSensitivityFactor = 0.01f;
 // ------------------------------------------------------ Scene graph -- //
 GraphNode scene;
 
+// Built once; frames only move what moves. The point light circles the
+// origin on a turning pivot, its dummy riding along as a child.
+SceneGraph sceneGraph;
+SceneGraph::NodeId pointLightPivot, pointLightNode, spotLight1Node,
+    spotLight2Node;
+size_t teapotEntry = 0;
+vector<size_t> dummyEntries;
+
+unique_ptr<InstanceBuffer> instanceBuffer;
+unique_ptr<InstanceCuller> instanceCuller;
+FrustumCuller frustumCuller;
+
+enum InstanceCulling {
+    IC_NONE,
+    IC_CPU,         // FrustumCuller, visible instances uploaded
+    IC_GPU,         // InstanceCuller, indirect draws
+    IC_BVH          // the scene's hierarchy, visible instances uploaded
+};
+
+InstanceCulling instanceCulling = IC_GPU;
+int entriesSkipped = 0;
+SharedInstanceList singleInstance, weirdInstances, teapotInstances,
+    noInstances;
+int teapotInstanceCount = 25;
+
+// Left click casts a ray through the cursor, or the crosshair while the
+// mouse is grabbed
+bool pickRequested = false;
+vec2 pickPosition(0.0f);
+bool picked = false;
+size_t pickedEntry = 0, pickedInstance = 0;
+
+// What the hierarchy would pick as occluders, listed for inspection
+bool showOccluders = false;
+vector<pair<size_t, size_t>> occluderPicks;
+
+// ------------------------------------------------- Levels of detail -- //
+bool levelsOfDetail = true;
+float lodThreshold = 1.0f;      // pixels
+float lodHysteresis = 0.25f;
+
 // --------------------------------------------------- Rendering mode -- //
+enum RenderPath {
+    RP_FORWARD,
+    RP_DEFERRED
+};
+
 bool wireframeMode = false;
 bool showLightDummies = true;
+RenderPath renderPath = RP_FORWARD;
+bool depthPrepass = false;
+bool geometryStage = false;
+bool normalMapping = true;
+bool faceCulling = false;
+
+unique_ptr<DeferredRenderer> deferredRenderer;
 
 // ----------------------------------------------------------- Models -- //
 shared_ptr<Renderable> ground, amplifier, weird, lightbulb;
 
-// //////////////////////////////////////////////////////////// Textures //
-GLuint loadTextureFromFile(string const &filename) {
-    // Generate OpenGL resource
-    GLuint texture;
-    glGenTextures(1, &texture);
+unique_ptr<ModelStreamer> streamer;
+
+// ----------------------------------------------------------- Lights -- //
+unique_ptr<LightBuffer> lightBuffer;
+unique_ptr<LightClusters> lightClusters;
+ClusterBuild clusterBuild = CB_GPU;
+
+vector<LightParameters> extraLights;
+int extraLightCount = 0;
+
+// -------------------------------------------------------- Profiling -- //
+// One timer per path so both last measurements stay on screen
+unique_ptr<GpuTimer> forwardTimer;
+unique_ptr<GpuTimer> geometryStageTimer;
+unique_ptr<GpuTimer> deferredTimer;
+unique_ptr<GpuTimer> cullingTimer;
+
+// Scripted GPU timing run; idle while it has no steps left
+struct TimingStep {
+    char const *label;
+    RenderPath path;
+    InstanceCulling culling;
+    vec3 position;
+    vec3 front;
+};
 
-    // Setup the texture
-    glBindTexture(GL_TEXTURE_2D, texture);
-    {
-        // Set texture parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // Load texture from file
-        stbi_set_flip_vertically_on_load(true);
-
-        int imageWidth, imageHeight, imageNumberOfChannels;
-        unsigned char *textureData = stbi_load(
-            filename.c_str(),
-            &imageWidth, &imageHeight,
-            &imageNumberOfChannels, 0);
-
-        if (textureData == nullptr) {
-            throw exception("Failed to load texture!");
-        }
-
-        // Pass image to OpenGL
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
-                     imageWidth, imageHeight, 0,
-                     [&]() -> GLenum {
-                         switch (imageNumberOfChannels) {
-                             case 1:
-                                 return GL_RED;
-                             case 3:
-                                 return GL_RGB;
-                             case 4:
-                                 return GL_RGBA;
-                             default:
-                                 return GL_RGB;
-                         }
-                     }(),
-                     GL_UNSIGNED_BYTE, textureData);
-
-        // Generate mipmap for loaded texture
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // After loading into OpenGL - release the raw resource
-        stbi_image_free(textureData);
-    }
-
-    // Return texture's ID
-    return texture;
+struct TimingRun {
+    vector<TimingStep> steps;
+    size_t step;
+    int frame;
+    double total;
+
+    // Restored when the run ends
+    RenderPath path;
+    InstanceCulling culling;
+    bool geometryStage;
+    bool depthPrepass;
+    int extraLightCount;
+    int teapotInstanceCount;
+    vec3 position;
+    vec3 front;
+} timingRun = {};
+
+// Fragments shaded by the forward pass, with and without the pre-pass
+unique_ptr<GpuCounter> shadedWithoutPrepass;
+unique_ptr<GpuCounter> shadedWithPrepass;
+
+// ////////////////////////////////////////////////////// GPU timing run //
+// Steps through fixed settings with the camera and the extra lights held
+// still and prints every step's GPU time, averaged over
+// TIMING_SAMPLE_FRAMES; the same run on two builds gives comparable
+// numbers
+void startTimingRun() {
+    if (!timingRun.steps.empty()) {
+        return;
+    }
+
+    // From the grid's corner, once across it and once out of the scene,
+    // so that culling has everything or nothing to remove
+    vec3 const position(-24.0f, 8.0f, -24.0f);
+    pair<char const *, vec3> const poses[] = {
+        {"facing the grid", normalize(vec3(1.0f, -0.25f, 1.0f))},
+        {"facing away", normalize(vec3(-1.0f, -0.25f, -1.0f))}};
+
+    timingRun.steps.clear();
+    for (pair<char const *, vec3> const &pose : poses) {
+        for (InstanceCulling const culling : {IC_NONE, IC_GPU}) {
+            for (RenderPath const path : {RP_FORWARD, RP_DEFERRED}) {
+                timingRun.steps.push_back(
+                    {pose.first, path, culling, position, pose.second});
+            }
+        }
+    }
+    timingRun.step = 0;
+    timingRun.frame = 0;
+    timingRun.total = 0.0;
+
+    timingRun.path = renderPath;
+    timingRun.culling = instanceCulling;
+    timingRun.geometryStage = geometryStage;
+    timingRun.depthPrepass = depthPrepass;
+    timingRun.extraLightCount = extraLightCount;
+    timingRun.teapotInstanceCount = teapotInstanceCount;
+    timingRun.position = cameraPosTarget;
+    timingRun.front = cameraFrontTarget;
+
+    cout << "GPU timing run, " << TIMING_TEAPOTS << " teapots, "
+         << TIMING_EXTRA_LIGHTS << " extra lights, levels of detail "
+         << (levelsOfDetail ? "on" : "off") << ", "
+         << TIMING_SAMPLE_FRAMES << " frames per step" << endl;
+}
+
+// Called at the start of every frame; overrides the user's settings while
+// a run is in progress
+void advanceTimingRun() {
+    if (timingRun.steps.empty()) {
+        return;
+    }
+
+    TimingStep const &step = timingRun.steps[timingRun.step];
+    renderPath = step.path;
+    instanceCulling = step.culling;
+    geometryStage = false;
+    depthPrepass = false;
+    extraLightCount = TIMING_EXTRA_LIGHTS;
+    teapotInstanceCount = TIMING_TEAPOTS;
+    cameraPos = cameraPosTarget = step.position;
+    cameraFront = cameraFrontTarget = step.front;
+
+    // Timers report a few frames late; the warm-up covers that
+    if (timingRun.frame >= TIMING_WARMUP_FRAMES) {
+        GpuTimer const &timer = step.path == RP_FORWARD ? *forwardTimer
+                                                        : *deferredTimer;
+        timingRun.total += timer.milliseconds();
+    }
+    if (++timingRun.frame < TIMING_WARMUP_FRAMES + TIMING_SAMPLE_FRAMES) {
+        return;
+    }
+
+    cout << "  " << (step.path == RP_FORWARD ? "forward" : "deferred")
+         << (step.culling == IC_NONE ? ", no culling, " : ", GPU culling, ")
+         << step.label << ": " << timingRun.total / TIMING_SAMPLE_FRAMES
+         << " ms" << endl;
+    timingRun.frame = 0;
+    timingRun.total = 0.0;
+    if (++timingRun.step < timingRun.steps.size()) {
+        return;
+    }
+
+    renderPath = timingRun.path;
+    instanceCulling = timingRun.culling;
+    geometryStage = timingRun.geometryStage;
+    depthPrepass = timingRun.depthPrepass;
+    extraLightCount = timingRun.extraLightCount;
+    teapotInstanceCount = timingRun.teapotInstanceCount;
+    cameraPosTarget = timingRun.position;
+    cameraFrontTarget = timingRun.front;
+    timingRun.steps.clear();
 }
 
 // /////////////////////////////////////////////////////// Class: Sphere //
@@ -481,6 +1213,171 @@ void prepareUserInterfaceWindow() {
             wireframeMode = !wireframeMode;
         }
         ImGui::NewLine();
+
+        ImGui::RadioButton("Forward", (int *)&renderPath, RP_FORWARD);
+        ImGui::SameLine();
+        ImGui::RadioButton("Deferred", (int *)&renderPath, RP_DEFERRED);
+        ImGui::Text("Scene GPU time: forward %.2f ms, deferred %.2f ms",
+                    forwardTimer->milliseconds(),
+                    deferredTimer->milliseconds());
+        if (timingRun.steps.empty()) {
+            if (ImGui::Button("Record GPU timings")) {
+                startTimingRun();
+            }
+        } else {
+            ImGui::Text("Recording GPU timings, step %d of %d",
+                        (int)timingRun.step + 1,
+                        (int)timingRun.steps.size());
+        }
+        ImGui::Checkbox("Depth pre-pass (forward)", &depthPrepass);
+        ImGui::SameLine();
+        ImGui::Checkbox("Back-face culling", &faceCulling);
+        ImGui::Checkbox("Pass-through geometry shader (forward)",
+                        &geometryStage);
+        ImGui::Text("Forward GPU time with the geometry shader: %.2f ms",
+                    geometryStageTimer->milliseconds());
+        if (shadedWithPrepass->available()) {
+            double const without = shadedWithoutPrepass->average();
+            double const with = shadedWithPrepass->average();
+            ImGui::Text("Shaded fragments: %.0fk without pre-pass, "
+                        "%.0fk with",
+                        without / 1000.0, with / 1000.0);
+            if (without > 0.0 && with > 0.0) {
+                ImGui::SameLine();
+                ImGui::Text("(%.0f%% fewer)",
+                            100.0 * (1.0 - with / without));
+            }
+        }
+        if (streamer->pendingCount() > 0) {
+            ImGui::Text("Streaming %d models...",
+                        (int)streamer->pendingCount());
+        }
+
+        TextureRegistry::Statistics const textureStats =
+            TextureRegistry::shared().statistics();
+        ImGui::Text("Textures: %d resident, %.1f MiB (%.1f MiB uncompressed)",
+                    (int)textureStats.residentTextures,
+                    textureStats.residentBytes / (1024.0f * 1024.0f),
+                    textureStats.uncompressedBytes / (1024.0f * 1024.0f));
+        ImGui::Text("Texture cache: %d hits, %d misses",
+                    (int)textureStats.hits, (int)textureStats.misses);
+        ImGui::Text("Texture uploads: %.1f ms",
+                    textureStats.uploadMilliseconds);
+        ImGui::SameLine();
+        if (ImGui::Button("Time uncompressed")) {
+            TextureRegistry::shared().measureUncompressedUploads();
+        }
+        if (textureStats.uncompressedUploadMilliseconds > 0.0f) {
+            ImGui::SameLine();
+            ImGui::Text("%.1f ms as RGB8",
+                        textureStats.uncompressedUploadMilliseconds);
+        }
+
+        Shader::Statistics const shaderStats = Shader::statistics();
+        ImGui::Text("Uniforms this frame: %d by handle, %d by name, "
+                    "%d location queries",
+                    (int)shaderStats.handleUpdates,
+                    (int)shaderStats.nameLookups,
+                    (int)shaderStats.locationQueries);
+        Shader::BuildStatistics const buildStats = Shader::buildStatistics();
+        ImGui::Text("Shader startup: %.1f ms, %d compiled, %d cached "
+                    "(cold: %.1f ms)",
+                    buildStats.milliseconds, (int)buildStats.compiled,
+                    (int)buildStats.loaded, buildStats.coldMilliseconds);
+        ImGui::Checkbox("Normal mapping", &normalMapping);
+        ImGui::SameLine();
+        ImGui::Text("(%d forward, %d G-buffer shader variants)",
+                    (int)modelShaders->variantCount(),
+                    (int)gbufferShaders->variantCount());
+        ImGui::Text("Light buffer uploads: %d",
+                    (int)lightBuffer->uploadCount());
+        ImGui::NewLine();
+
+        ImGui::SliderInt("Teapot instances", &teapotInstanceCount, 1,
+                         TEAPOT_INSTANCES_MAX);
+        ImGui::Text("Instances: %d, buffer uploads: %d",
+                    (int)instanceBuffer->instanceCount(),
+                    (int)instanceBuffer->uploadCount());
+        ImGui::RadioButton("No culling", (int *)&instanceCulling, IC_NONE);
+        ImGui::SameLine();
+        ImGui::RadioButton("CPU culling", (int *)&instanceCulling, IC_CPU);
+        if (instanceCuller->available()) {
+            ImGui::SameLine();
+            ImGui::RadioButton("GPU culling", (int *)&instanceCulling,
+                               IC_GPU);
+        }
+        ImGui::SameLine();
+        ImGui::RadioButton("BVH culling", (int *)&instanceCulling, IC_BVH);
+        if (instanceCulling == IC_CPU) {
+            ImGui::Text("Visible: %d of %d instances, %d entries skipped "
+                        "(%.1f us)",
+                        (int)frustumCuller.visibleCount(),
+                        (int)frustumCuller.size(), entriesSkipped,
+                        frustumCuller.kernelMicroseconds());
+        } else if (instanceCulling == IC_GPU) {
+            ImGui::Text("GPU culling: %.2f ms, %d indirect draws",
+                        cullingTimer->milliseconds(),
+                        (int)instanceCuller->commandCount());
+        } else if (instanceCulling == IC_BVH) {
+            ImGui::Text("Visible: %d of %d instances, %d entries skipped "
+                        "(%.1f us)",
+                        (int)scene.hierarchyVisibleCount(),
+                        (int)scene.boundingHierarchy().itemCount(),
+                        entriesSkipped, scene.hierarchyMicroseconds());
+        }
+        ImGui::Checkbox("Levels of detail", &levelsOfDetail);
+        ImGui::SameLine();
+        ImGui::SliderFloat("Max error (px)", &lodThreshold, 0.25f, 8.0f);
+        bool const gpuCounts = instanceCulling == IC_GPU;
+        size_t const drawn = gpuCounts ? instanceCuller->triangleCount()
+                                       : scene.triangleCount();
+        size_t const full = gpuCounts
+                                ? instanceCuller->fullDetailTriangleCount()
+                                : scene.fullDetailTriangleCount();
+        ImGui::Text("Triangles: %.2f M of %.2f M at full detail "
+                    "(%.0f%% saved)",
+                    drawn / 1e6f, full / 1e6f,
+                    full > 0 ? 100.0f * (1.0f - drawn / (float)full) : 0.0f);
+
+        Bvh::Statistics const bvhStats =
+            scene.boundingHierarchy().statistics();
+        ImGui::Text("BVH: %d nodes, %d leaves, depth %d, %d builds",
+                    (int)bvhStats.nodes, (int)bvhStats.leaves,
+                    (int)bvhStats.depth, (int)scene.hierarchyBuilds());
+        ImGui::Text("Scene graph: %d nodes, %d updated this frame",
+                    (int)sceneGraph.size(),
+                    (int)sceneGraph.changed().size());
+        if (picked) {
+            ImGui::Text("Picked: entry %d, instance %d", (int)pickedEntry,
+                        (int)pickedInstance);
+        } else {
+            ImGui::Text("Picked: nothing (left click)");
+        }
+        ImGui::Checkbox("Show occluder picks", &showOccluders);
+        if (showOccluders) {
+            for (pair<size_t, size_t> const &occluder : occluderPicks) {
+                ImGui::Text("  entry %d, instance %d", (int)occluder.first,
+                            (int)occluder.second);
+            }
+        }
+
+        ImGui::SliderInt("Extra point lights", &extraLightCount, 0,
+                         EXTRA_LIGHTS_MAX);
+        ImGui::Text("Lights: %d, %d clusters over the %d-light cap",
+                    (int)lightClusters->lightCount(),
+                    (int)lightClusters->overflowingClusters(),
+                    (int)LightClusters::MAX_LIGHTS_PER_CLUSTER);
+        if (lightClusters->gpuAvailable()) {
+            ImGui::RadioButton("Clusters on GPU", (int *)&clusterBuild,
+                               CB_GPU);
+            ImGui::SameLine();
+        }
+        ImGui::RadioButton("Clusters on CPU", (int *)&clusterBuild, CB_CPU);
+        if (clusterBuild == CB_CPU || !lightClusters->gpuAvailable()) {
+            ImGui::Text("Cluster build: %.2f ms",
+                        lightClusters->cpuMilliseconds());
+        }
+        ImGui::NewLine();
         ImGui::Separator();
         //        ImGui::NewLine();
 
@@ -559,53 +1456,163 @@ void initializeOpenGLLoader() {
     }
 }
 
-void setupSceneGraph(float const deltaTime, float const displayWidth,
-                     float const displayHeight) {
-    static mat4 const identity = mat4(1.0f);
+// Rows of count instances on the XZ plane, as square as possible; a
+// count of 25 gives the original 5x5 layout
+SharedInstanceList instanceGrid(int const count, vec3 const &offset) {
+    int const side = static_cast<int>(std::ceil(std::sqrt(
+            static_cast<float>(count))));
+
+    auto grid = make_shared<InstanceList>();
+    grid->reserve(count);
+    for (int i = 0; i < count; ++i) {
+        vec3 const position(-16.0f + INSTANCE_SPACING * (i % side), 0.0f,
+                            -16.0f + INSTANCE_SPACING * (i / side));
+        grid->emplace_back(glm::translate(mat4(1.0f), position + offset));
+    }
+    return grid;
+}
+
+void setupSceneGraph() {
+    mat4 const identity(1.0f);
+    singleInstance = make_shared<InstanceList>(1, InstanceData(identity));
+    weirdInstances = instanceGrid(25, vec3(2.5, 0, 2.5));
+    teapotInstances = instanceGrid(teapotInstanceCount, vec3(0));
+    noInstances = make_shared<InstanceList>();
+
+    scene.add(sceneGraph, SceneGraph::ROOT, ground, singleInstance);
+    scene.add(sceneGraph, SceneGraph::ROOT, weird, weirdInstances);
+    teapotEntry = scene.add(sceneGraph, SceneGraph::ROOT, amplifier,
+                            teapotInstances);
+
+    pointLightPivot = sceneGraph.add(SceneGraph::ROOT);
+    pointLightNode = sceneGraph.add(
+        pointLightPivot, glm::translate(identity, vec3(25.0f, 5.0f, 0.0f)));
+    spotLight1Node = sceneGraph.add(
+        SceneGraph::ROOT,
+        glm::translate(identity, ImVec4ToVec3(lightSpot1.position)));
+    spotLight2Node = sceneGraph.add(
+        SceneGraph::ROOT,
+        glm::translate(identity, ImVec4ToVec3(lightSpot2.position)));
+    for (SceneGraph::NodeId const node :
+         {pointLightNode, spotLight1Node, spotLight2Node}) {
+        dummyEntries.push_back(
+            scene.add(sceneGraph, node, lightbulb, singleInstance));
+    }
+}
+
+// Moves the nodes that moved this frame and swaps the lists that changed
+void updateSceneGraph(float const deltaTime) {
     static float angle = 0.0f;
     angle += glm::radians(30.0f) * deltaTime;
+    sceneGraph.setLocal(pointLightPivot,
+                        glm::rotate(mat4(1.0f), angle,
+                                    vec3(0.0f, 1.0f, 0.0f)));
+
+    // The spot lights only move when edited
+    auto const place = [](SceneGraph::NodeId const node,
+                          ImVec4 const &position) {
+        vec3 const target = ImVec4ToVec3(position);
+        if (vec3(sceneGraph.local(node)[3]) != target) {
+            sceneGraph.setLocal(node, glm::translate(mat4(1.0f), target));
+        }
+    };
+    place(spotLight1Node, lightSpot1.position);
+    place(spotLight2Node, lightSpot2.position);
+
+    sceneGraph.update();
+    scene.updateTransforms(sceneGraph);
+    lightPoint.position =
+        Vec3ToImVec4(vec3(sceneGraph.world(pointLightNode)[3]));
+
+    // Lists are only replaced when they change, so unchanged frames upload
+    // no instances
+    if (teapotInstances->size() != static_cast<size_t>(teapotInstanceCount)) {
+        teapotInstances = instanceGrid(teapotInstanceCount, vec3(0));
+        scene.setInstances(teapotEntry, teapotInstances);
+    }
+    for (size_t const entry : dummyEntries) {
+        scene.setInstances(entry, showLightDummies ? singleInstance
+                                                   : noInstances);
+    }
+
+    if (scene.needsUpload()) {
+        scene.uploadInstances(*instanceBuffer);
+    }
+}
 
-    lightPoint.position = Vec3ToImVec4(
-        glm::rotate(identity, angle, vec3(0.0f, 1.0f, 0.0f)) *
-        glm::vec4(25, 5, 0, 1));
-
-    // Scene elements
-    scene.transform.clear();
-    scene.model.clear();
-    scene.instances.clear();
-    scene.offset.clear();
-
-    scene.transform.push_back(identity);
-    scene.model.push_back(ground);
-    scene.instances.push_back(1);
-    scene.offset.push_back(vec3(0));
-
-    scene.transform.push_back(identity);
-    scene.model.push_back(weird);
-    scene.instances.push_back(25);
-    scene.offset.push_back(vec3(2.5, 0, 2.5));
-
-    scene.transform.push_back(identity);
-    scene.model.push_back(amplifier);
-    scene.instances.push_back(25);
-    scene.offset.push_back(vec3(0));
-
-    if (showLightDummies) {
-        scene.transform.push_back(glm::translate(mat4(1), ImVec4ToVec3(lightPoint.position)));
-        scene.model.push_back(lightbulb);
-        scene.instances.push_back(1);
-        scene.offset.push_back(vec3(0));
-
-        scene.transform.push_back(glm::translate(mat4(1), ImVec4ToVec3(lightSpot1.position)));
-        scene.model.push_back(lightbulb);
-        scene.instances.push_back(1);
-        scene.offset.push_back(vec3(0));
-
-        scene.transform.push_back(glm::translate(mat4(1), ImVec4ToVec3(lightSpot2.position)));
-        scene.model.push_back(lightbulb);
-        scene.instances.push_back(1);
-        scene.offset.push_back(vec3(0));
+// Picks the shader variants for this frame's settings and lights
+unsigned int selectShaders(unsigned int const lightFeatures) {
+    unsigned int const features = (pbrEnabled ? SF_PBR : 0) |
+                                  lightFeatures |
+                                  (normalMapping ? SF_NORMAL_MAPPING : 0);
+
+    ShaderPermutations &forward =
+        geometryStage ? *modelGeometryStageShaders : *modelShaders;
+    for (shared_ptr<Renderable> const &model : {ground, amplifier, weird}) {
+        model->shader = forward.variant(features);
+        model->gbufferShader = gbufferShaders->variant(features);
     }
+    return features;
+}
+
+// Small coloured point lights scattered over the teapot grid
+void generateExtraLights(int const count) {
+    std::mt19937 random(216920);
+    std::uniform_real_distribution<float> across(-18.0f, 18.0f);
+    std::uniform_real_distribution<float> height(0.5f, 3.0f);
+    std::uniform_real_distribution<float> hue(0.0f, 1.0f);
+
+    extraLights.clear();
+    for (int i = 0; i < count; ++i) {
+        ImVec4 color(0.0f, 0.0f, 0.0f, 1.0f);
+        ImGui::ColorConvertHSVtoRGB(hue(random), 0.7f, 1.0f,
+                                    color.x, color.y, color.z);
+
+        float const x = across(random), y = height(random), z = across(random);
+        extraLights.push_back({"", LT_POINT, 1.0f,
+                               {0.0f, 0.0f, 0.0f, 1.0f},
+                               {x, y, z, 1.0f},
+                               0.0f,
+                               1.0f, 0.0f, 8.0f,
+                               0.0f, color,
+                               1.0f, color,
+                               1.0f, {1.0f, 1.0f, 1.0f, 1.0f},
+                               64.0f});
+    }
+}
+
+// Returns the light types the shaders have to handle
+unsigned int updateLights(mat4 const &view, mat4 const &projection,
+                  int const displayWidth, int const displayHeight) {
+    if (static_cast<int>(extraLights.size()) != extraLightCount) {
+        generateExtraLights(extraLightCount);
+    }
+
+    // Lights that reach nothing are left out of the clusters entirely
+    vector<LightData> lights;
+    lights.reserve(4 + extraLights.size());
+    auto const add = [&lights](LightParameters const &light) {
+        if (light.enable > 0.0f && light.range() != 0.0f) {
+            lights.push_back(light.pack());
+        }
+    };
+    add(lightDirectional);
+    add(lightPoint);
+    add(lightSpot1);
+    add(lightSpot2);
+    for (LightParameters const &light : extraLights) {
+        add(light);
+    }
+
+    LightBlock block{};
+    block.view = view;
+    lightClusters->describe(block, projection, NEAR_PLANE, FAR_PLANE,
+                            displayWidth, displayHeight);
+    block.lightCount = static_cast<int>(lights.size());
+
+    lightBuffer->update(block, lights);
+    lightClusters->build(block, lights, clusterBuild);
+    return lightTypeFeatures(lights);
 }
 
 void mouseCallback(GLFWwindow *window, double x, double y) {
@@ -679,9 +1686,43 @@ void handleKeyboardInput(float const deltaTime) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         quitProgram = true;
     }
+
+    // Clicks meant for the user interface pick nothing
+    static bool mousePressed = false;
+    bool const mouseDown =
+        glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    if (mouseDown && !mousePressed &&
+        (grabMouse || !ImGui::GetIO().WantCaptureMouse)) {
+        pickRequested = true;
+        pickPosition = vec2(0.0f);
+        if (!grabMouse) {
+            double x, y;
+            int width, height;
+            glfwGetCursorPos(window, &x, &y);
+            glfwGetWindowSize(window, &width, &height);
+            pickPosition = vec2(2.0f * x / std::max(width, 1) - 1.0f,
+                                1.0f - 2.0f * y / std::max(height, 1));
+        }
+    }
+    mousePressed = mouseDown;
+}
+
+// Casts the ray through pickPosition, in normalized device coordinates,
+// into the scene's hierarchy
+void pickInstance(mat4 const &viewProjection) {
+    mat4 const inverse = glm::inverse(viewProjection);
+    vec4 const nearPoint =
+        inverse * vec4(pickPosition.x, pickPosition.y, -1.0f, 1.0f);
+    vec4 const farPoint =
+        inverse * vec4(pickPosition.x, pickPosition.y, 1.0f, 1.0f);
+    vec3 const origin = vec3(nearPoint) / nearPoint.w;
+    vec3 const direction = vec3(farPoint) / farPoint.w - origin;
+    picked = scene.pick(origin, direction, pickedEntry, pickedInstance);
 }
 
 void setupOpenGL() {
+    auto const startTime = sysclock::now();
+
     setupGLFW();
     createWindow();
     initializeOpenGLLoader();
@@ -691,30 +1732,83 @@ void setupOpenGL() {
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouseCallback);
 
-    plywoodTexture = loadTextureFromFile(
+    forwardTimer = make_unique<GpuTimer>();
+    geometryStageTimer = make_unique<GpuTimer>();
+    deferredTimer = make_unique<GpuTimer>();
+    cullingTimer = make_unique<GpuTimer>();
+    shadedWithoutPrepass =
+        make_unique<GpuCounter>(GL_FRAGMENT_SHADER_INVOCATIONS);
+    shadedWithPrepass =
+        make_unique<GpuCounter>(GL_FRAGMENT_SHADER_INVOCATIONS);
+    lightBuffer = make_unique<LightBuffer>();
+    instanceBuffer = make_unique<InstanceBuffer>();
+    instanceCuller = make_unique<InstanceCuller>();
+    lightClusters = make_unique<LightClusters>();
+    deferredRenderer = make_unique<DeferredRenderer>();
+
+    // Models stream in while the rest is set up and the first frames run
+    streamer = make_unique<ModelStreamer>(window);
+    ground = streamer->load("res/models/ground.obj");
+    amplifier = streamer->load("res/models/teapot.obj");
+    weird = streamer->load("res/models/weird.obj");
+    lightbulb = streamer->load("res/models/light.obj");
+
+    plywoodTexture = TextureRegistry::shared().acquireTexture(
         "res/textures/light.jpg");
-    metalTexture = loadTextureFromFile("res/textures/metal.jpg");
-
-    ground = make_shared<Model>("res/models/ground.obj");
-    amplifier = make_shared<Model>("res/models/teapot.obj");
-    weird = make_shared<Model>("res/models/weird.obj");
-    lightbulb = make_shared<Model>("res/models/light.obj");
-
-    modelShader = make_shared<Shader>("res/shaders/model/vertex.glsl",
-                                      "res/shaders/model/geometry.glsl",
-                                      "res/shaders/model/fragment.glsl");
-
-    sphereShader = make_shared<Shader>(
-        "res/shaders/lightbulb/vertex.glsl",
-        "res/shaders/lightbulb/geometry.glsl",
-        "res/shaders/lightbulb/fragment.glsl");
+    metalTexture = TextureRegistry::shared().acquireTexture(
+        "res/textures/metal.jpg");
+
+    // Built together, so drivers can compile them in parallel
+    vector<shared_ptr<Shader>> const shaders = Shader::buildAll({
+        {{GL_VERTEX_SHADER, "res/shaders/depth/vertex.glsl"},
+         {GL_FRAGMENT_SHADER, "res/shaders/depth/fragment.glsl"}},
+        {{GL_VERTEX_SHADER, "res/shaders/lightbulb/vertex.glsl"},
+         {GL_FRAGMENT_SHADER, "res/shaders/lightbulb/fragment.glsl"}}});
+    depthShader = shaders[0];
+    sphereShader = shaders[1];
+
+    modelShaders = make_unique<ShaderPermutations>(
+        vector<ShaderStage>{
+            {GL_VERTEX_SHADER, "res/shaders/model/vertex.glsl"},
+            {GL_FRAGMENT_SHADER, "res/shaders/model/fragment.glsl"}},
+        shadingFeatureDefines(), SF_ALL);
+    // Only for comparing throughput with an idle geometry stage
+    modelGeometryStageShaders = make_unique<ShaderPermutations>(
+        vector<ShaderStage>{
+            {GL_VERTEX_SHADER, "res/shaders/model/vertex.glsl"},
+            {GL_GEOMETRY_SHADER, "res/shaders/model/geometry.glsl"},
+            {GL_FRAGMENT_SHADER, "res/shaders/model/fragment.glsl"}},
+        shadingFeatureDefines(), SF_ALL);
+    gbufferShaders = make_unique<ShaderPermutations>(
+        vector<ShaderStage>{
+            {GL_VERTEX_SHADER, "res/shaders/model/vertex.glsl"},
+            {GL_FRAGMENT_SHADER, "res/shaders/gbuffer/fragment.glsl"}},
+        shadingFeatureDefines(), SF_NORMAL_MAPPING);
+
+    // Only the variants the initial settings select; the others, and the
+    // whole geometry-stage set, are built when a setting first asks for
+    // them and come from the program cache on later runs
+    selectShaders(SF_LIGHT_TYPES);
 
-    ground->shader = modelShader;
-    amplifier->shader = modelShader;
-    weird->shader = modelShader;
     lightbulb->shader = sphereShader;
 
+    // The dummies are cheap to shade and stay out of the pre-pass
+    ground->depthShader = depthShader;
+    amplifier->depthShader = depthShader;
+    weird->depthShader = depthShader;
+
+    setupSceneGraph();
     setupDearImGui();
+
+    // Models are still streaming; this is the time to the first frame
+    sec const startupTime = sysclock::now() - startTime;
+    Shader::BuildStatistics const build = Shader::buildStatistics();
+    cout << "Startup took " << startupTime.count() * 1000.0f << " ms, "
+         << build.milliseconds << " ms of it for " << build.compiled
+         << " programs compiled and " << build.loaded
+         << " loaded from the program cache (cold build took "
+         << build.coldMilliseconds << " ms, parallel compile "
+         << (build.parallel ? "on" : "off") << ")" << endl;
 }
 
 // //////////////////////////////////////////////////////////// Clean up //
@@ -723,13 +1817,43 @@ void cleanUp() {
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    forwardTimer = nullptr;
+    geometryStageTimer = nullptr;
+    deferredTimer = nullptr;
+    cullingTimer = nullptr;
+    shadedWithoutPrepass = nullptr;
+    shadedWithPrepass = nullptr;
+    deferredRenderer = nullptr;
+    lightClusters = nullptr;
+    lightBuffer = nullptr;
+    instanceCuller = nullptr;
+    instanceBuffer = nullptr;
+    singleInstance = nullptr;
+    weirdInstances = nullptr;
+    teapotInstances = nullptr;
+    noInstances = nullptr;
+
     sphereShader = nullptr;
-    modelShader = nullptr;
+    depthShader = nullptr;
+    gbufferShaders = nullptr;
+    modelGeometryStageShaders = nullptr;
+    modelShaders = nullptr;
+
+    streamer = nullptr;
+    scene = GraphNode();
+    sceneGraph = SceneGraph();
+    dummyEntries.clear();
 
+    ground = nullptr;
     lightbulb = nullptr;
     amplifier = nullptr;
     weird = nullptr;
 
+    plywoodTexture = nullptr;
+    metalTexture = nullptr;
+
+    GpuResources::shared().reportLeaks(cout);
+
     glfwDestroyWindow(window);
     glfwTerminate();
 }
@@ -743,9 +1867,12 @@ void performMainLoop() {
         sec const deltaTime = startTime - previousStartTime;
         previousStartTime = startTime;
 
+        Shader::resetStatistics();
+
         // --------------------------------------------------- Events -- //
         glfwPollEvents();
         handleKeyboardInput(deltaTime.count());
+        advanceTimingRun();
 
         // ----------------------------------- Get current frame size -- //
         int displayWidth, displayHeight;
@@ -762,6 +1889,16 @@ void performMainLoop() {
         glEnable(GL_DEPTH_TEST);
         glPolygonMode(GL_FRONT_AND_BACK,
                       wireframeMode ? GL_LINE : GL_FILL);
+        if (faceCulling) {
+            glEnable(GL_CULL_FACE);
+        } else {
+            glDisable(GL_CULL_FACE);
+        }
+
+        // ---------------------------------------- Finish streaming -- //
+        if (streamer->update() > 0) {
+            scene.residencyChanged();
+        }
 
         // --------------------------------------------- Render scene -- //
         cameraPos = lerp(cameraPos, cameraPosTarget, 0.1f);
@@ -770,14 +1907,79 @@ void performMainLoop() {
         mat4 const projection = perspective(radians(60.0f),
                                             ((float)displayWidth) /
                                                 ((float)displayHeight),
-                                            0.01f, 100.0f);
+                                            NEAR_PLANE, FAR_PLANE);
         mat4 const view = lookAt(cameraPos,
                                  cameraPos + cameraFront,
                                  cameraUp);
 
-        setupSceneGraph(deltaTime.count(), displayWidth,
-                        displayHeight);
-        scene.render(projection * view);
+        updateSceneGraph(deltaTime.count());
+        unsigned int const features = selectShaders(
+            updateLights(view, projection, displayWidth, displayHeight));
+        scene.updateHierarchy();
+        if (pickRequested) {
+            pickInstance(projection * view);
+            pickRequested = false;
+        }
+        if (showOccluders) {
+            scene.selectOccluders(projection * view, cameraPos,
+                                  OCCLUDERS_SHOWN, occluderPicks);
+        }
+
+        LodSelection lods = describeLodSelection(
+            cameraPos, projection, displayHeight, lodThreshold,
+            lodHysteresis);
+        if (!levelsOfDetail) {
+            lods.pixelScale = 0.0f;
+        }
+
+        if (instanceCulling == IC_GPU && !instanceCuller->available()) {
+            instanceCulling = IC_CPU;
+        }
+        if (instanceCulling == IC_NONE && levelsOfDetail) {
+            entriesSkipped = scene.selectLods(*instanceBuffer, lods);
+        } else if (instanceCulling == IC_CPU) {
+            entriesSkipped = scene.cullInstancesOnCpu(
+                frustumCuller, *instanceBuffer, projection * view, lods);
+        } else if (instanceCulling == IC_BVH) {
+            entriesSkipped = scene.cullInstancesWithHierarchy(
+                *instanceBuffer, projection * view, lods);
+        } else if (instanceCulling == IC_GPU) {
+            cullingTimer->begin();
+            scene.cullInstances(*instanceCuller, projection * view, lods);
+            cullingTimer->end();
+        } else {
+            scene.drawEverything(*instanceBuffer);
+        }
+        if (renderPath == RP_FORWARD) {
+            GpuTimer &timer = geometryStage ? *geometryStageTimer
+                                            : *forwardTimer;
+            timer.begin();
+            if (depthPrepass) {
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                scene.render(projection * view, SP_DEPTH);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            }
+
+            GpuCounter &shaded = depthPrepass ? *shadedWithPrepass
+                                              : *shadedWithoutPrepass;
+            shaded.begin();
+            scene.render(projection * view, SP_FORWARD, depthPrepass);
+            shaded.end();
+            timer.end();
+        } else {
+            deferredTimer->begin();
+            deferredRenderer->beginGeometryPass(displayWidth, displayHeight);
+            scene.render(projection * view, SP_GEOMETRY);
+
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            deferredRenderer->lightingPass(view, projection, cameraPos,
+                                           features);
+            glPolygonMode(GL_FRONT_AND_BACK,
+                          wireframeMode ? GL_LINE : GL_FILL);
+
+            scene.render(projection * view, SP_OVERLAY);
+            deferredTimer->end();
+        }
 
         // ------------------------------------------------------- UI -- //
         prepareUserInterfaceWindow();
@@ -0,0 +1,109 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "mapped-file.hpp"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::string;
+
+// /////////////////////////////////////////////////// Class: MappedFile //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+#if defined(_WIN32)
+MappedFile::MappedFile(string const &filename)
+        : bytes(nullptr),
+          length(0),
+          file(INVALID_HANDLE_VALUE),
+          mapping(nullptr) {
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                       nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                       nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        return;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0,
+                                 nullptr);
+    if (mapping == nullptr) {
+        return;
+    }
+
+    bytes = static_cast<unsigned char const *>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (bytes != nullptr) {
+        length = static_cast<size_t>(fileSize.QuadPart);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != nullptr) {
+        UnmapViewOfFile(bytes);
+    }
+    if (mapping != nullptr) {
+        CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+}
+#else
+MappedFile::MappedFile(string const &filename)
+        : bytes(nullptr),
+          length(0),
+          file(-1) {
+    file = open(filename.c_str(), O_RDONLY);
+    if (file < 0) {
+        return;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        return;
+    }
+
+    void *address = mmap(nullptr, static_cast<size_t>(status.st_size),
+                         PROT_READ, MAP_PRIVATE, file, 0);
+    if (address != MAP_FAILED) {
+        bytes = static_cast<unsigned char const *>(address);
+        length = static_cast<size_t>(status.st_size);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != nullptr) {
+        munmap(const_cast<unsigned char *>(bytes), length);
+    }
+    if (file >= 0) {
+        close(file);
+    }
+}
+#endif
+
+bool MappedFile::valid() const {
+    return bytes != nullptr;
+}
+
+unsigned char const *MappedFile::data() const {
+    return bytes;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+// //////////////////////////////////////////////////////////// Includes //
+#include <cstddef>
+#include <string>
+
+// /////////////////////////////////////////////////// Class: MappedFile //
+// Read-only memory mapping of a whole file. An empty or missing file
+// leaves the mapping invalid instead of throwing, so caches can simply
+// fall back to regenerating their contents.
+class MappedFile {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    explicit MappedFile(std::string const &filename);
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile const &) = delete;
+
+    ~MappedFile();
+
+    bool valid() const;
+
+    unsigned char const *data() const;
+    std::size_t size() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    unsigned char const *bytes;
+    std::size_t length;
+#if defined(_WIN32)
+    void *file;
+    void *mapping;
+#else
+    int file;
+#endif
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // MAPPED_FILE_H
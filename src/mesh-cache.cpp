@@ -0,0 +1,476 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "mesh-cache.hpp"
+#include "cache-file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::ifstream;
+using std::ofstream;
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+using std::int64_t;
+using std::unique_ptr;
+using std::vector;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    char const MAGIC[4] = {'F', 'P', 'M', 'C'};
+
+    // Bump whenever the layout or the mesh processing pipeline changes,
+    // so that stale caches are regenerated instead of misread.
+    uint32_t const VERSION = 11;
+
+    size_t const ALIGNMENT = 16;
+}
+
+// ////////////////////////////////////////////////////// File structure //
+namespace {
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t meshCount;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+        float importMilliseconds;
+        uint32_t nodeCount;
+        uint32_t libraryCount;
+        uint32_t reserved;
+    };
+
+    struct FileRecord {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t materialOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t materialLength;
+        float boundsMin[3];
+        float boundsMax[3];
+        uint32_t flags;
+        float boundsRadius;
+        uint32_t lodCount;
+        uint64_t lodOffset;
+        uint32_t node;
+        uint32_t vertexCountBefore;     // the rest is the import's report
+        float acmrBefore;
+        float acmrAfter;
+        float atvrBefore;
+        float atvrAfter;
+    };
+
+    // Follows the mesh records
+    struct FileNode {
+        float transform[16];
+        uint32_t parent;
+        uint32_t nameLength;
+        uint64_t nameOffset;
+    };
+
+    // Follows the nodes; one per material library the source names, as
+    // materials and two-sidedness come from there
+    struct FileLibrary {
+        uint64_t size;              // MISSING_LIBRARY if it did not exist
+        int64_t time;
+        uint64_t hash;
+        uint64_t nameOffset;
+        uint32_t nameLength;
+        uint32_t reserved;
+    };
+
+    enum RecordFlag {
+        RF_TWO_SIDED = 1
+    };
+
+    uint64_t const MISSING_LIBRARY = std::numeric_limits<uint64_t>::max();
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    size_t align(size_t const offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    bool fits(size_t const fileSize, uint64_t const offset,
+              uint64_t const count, size_t const elementSize) {
+        return offset <= fileSize &&
+               count <= (fileSize - offset) / elementSize;
+    }
+
+    // A matching timestamp is trusted as is; a touched file with the same
+    // size is still accepted if its contents hash the same.
+    bool unchanged(string const &filename, uint64_t const size,
+                   int64_t const time, uint64_t const hash) {
+        SourceKey key;
+        return querySource(filename, key) && key.size == size &&
+               (key.time == time || hashFile(filename) == hash);
+    }
+
+    // The files named by the mtllib lines of an .obj, next to it; other
+    // formats are taken to be self-contained
+    vector<string> materialLibraries(string const &sourceFilename) {
+        vector<string> libraries;
+        std::filesystem::path const source(sourceFilename);
+        if (source.extension() != ".obj") {
+            return libraries;
+        }
+
+        ifstream file(sourceFilename);
+        string line;
+        while (std::getline(file, line)) {
+            if (line.compare(0, 7, "mtllib ") != 0) {
+                continue;
+            }
+            size_t const first = line.find_first_not_of(" \t\r", 7);
+            size_t const last = line.find_last_not_of(" \t\r");
+            if (first != string::npos) {
+                libraries.push_back(
+                        (source.parent_path() /
+                         line.substr(first, last - first + 1)).string());
+            }
+        }
+        return libraries;
+    }
+}
+
+// //////////////////////////////////////////////////// Class: MeshCache //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+MeshCache::MeshCache(string const &sourceFilename)
+        : sourceFilename(sourceFilename),
+          cacheFilename(cacheFilenameFor(sourceFilename, ".mesh")),
+          coldImportMilliseconds(0.0f) {
+}
+
+bool MeshCache::load() {
+    records.clear();
+    nodeRecords.clear();
+    mapping = std::make_unique<MappedFile>(cacheFilename);
+
+    bool const loaded = [&]() -> bool {
+        // '''''''''''''''''''''''''''''''''''''''''''''''' Validate header
+        if (!mapping->valid() || mapping->size() < sizeof(FileHeader)) {
+            return false;
+        }
+
+        FileHeader header;
+        std::memcpy(&header, mapping->data(), sizeof(FileHeader));
+
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header.version != VERSION ||
+            header.vertexSize != sizeof(Vertex)) {
+            return false;
+        }
+
+        // '''''''''''''''''''''''''''''''''''''''''''' Validate source key
+        if (!unchanged(sourceFilename, header.sourceSize, header.sourceTime,
+                       header.sourceHash)) {
+            return false;
+        }
+
+        size_t const nodesOffset =
+                sizeof(FileHeader) + header.meshCount * sizeof(FileRecord);
+        size_t const librariesOffset =
+                nodesOffset + header.nodeCount * sizeof(FileNode);
+        if (!fits(mapping->size(), sizeof(FileHeader),
+                  header.meshCount, sizeof(FileRecord)) ||
+            !fits(mapping->size(), nodesOffset, header.nodeCount,
+                  sizeof(FileNode)) ||
+            !fits(mapping->size(), librariesOffset, header.libraryCount,
+                  sizeof(FileLibrary))) {
+            return false;
+        }
+
+        // '''''''''''''''''''''''''''''''''''''''' Validate material keys
+        unsigned char const *const base = mapping->data();
+        for (uint32_t i = 0; i < header.libraryCount; ++i) {
+            FileLibrary library;
+            std::memcpy(&library,
+                        base + librariesOffset + i * sizeof(FileLibrary),
+                        sizeof(FileLibrary));
+            if (!fits(mapping->size(), library.nameOffset,
+                      library.nameLength, 1)) {
+                return false;
+            }
+
+            // A library that was missing must still be missing
+            string const name(
+                    reinterpret_cast<char const *>(base + library.nameOffset),
+                    library.nameLength);
+            SourceKey key;
+            if (library.size == MISSING_LIBRARY
+                ? querySource(name, key)
+                : !unchanged(name, library.size, library.time,
+                             library.hash)) {
+                return false;
+            }
+        }
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''''' Read mesh views
+        for (uint32_t i = 0; i < header.meshCount; ++i) {
+            FileRecord record;
+            std::memcpy(&record,
+                        base + sizeof(FileHeader) + i * sizeof(FileRecord),
+                        sizeof(FileRecord));
+
+            if (!fits(mapping->size(), record.vertexOffset,
+                      record.vertexCount, sizeof(Vertex)) ||
+                !fits(mapping->size(), record.indexOffset,
+                      record.indexCount, sizeof(unsigned int)) ||
+                !fits(mapping->size(), record.materialOffset,
+                      record.materialLength, 1) ||
+                !fits(mapping->size(), record.lodOffset, record.lodCount,
+                      sizeof(MeshLod)) ||
+                record.node >= header.nodeCount) {
+                return false;
+            }
+
+            // Every level must draw from the record's own indices
+            for (uint32_t level = 0; level < record.lodCount; ++level) {
+                MeshLod lod;
+                std::memcpy(&lod,
+                            base + record.lodOffset + level * sizeof(MeshLod),
+                            sizeof(MeshLod));
+                if (lod.indexCount < 0 ||
+                    lod.firstIndex > record.indexCount ||
+                    static_cast<uint32_t>(lod.indexCount) >
+                            record.indexCount - lod.firstIndex) {
+                    return false;
+                }
+            }
+
+            records.push_back({
+                    string(reinterpret_cast<char const *>(
+                                   base + record.materialOffset),
+                           record.materialLength),
+                    glm::vec3(record.boundsMin[0], record.boundsMin[1],
+                              record.boundsMin[2]),
+                    glm::vec3(record.boundsMax[0], record.boundsMax[1],
+                              record.boundsMax[2]),
+                    record.boundsRadius,
+                    (record.flags & RF_TWO_SIDED) != 0,
+                    reinterpret_cast<Vertex const *>(
+                            base + record.vertexOffset),
+                    record.vertexCount,
+                    reinterpret_cast<unsigned int const *>(
+                            base + record.indexOffset),
+                    record.indexCount,
+                    reinterpret_cast<MeshLod const *>(
+                            base + record.lodOffset),
+                    record.lodCount,
+                    record.node,
+                    {record.vertexCountBefore, record.vertexCount,
+                     {record.acmrBefore, record.atvrBefore},
+                     {record.acmrAfter, record.atvrAfter}}});
+        }
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''''''''' Read nodes
+        for (uint32_t i = 0; i < header.nodeCount; ++i) {
+            FileNode node;
+            std::memcpy(&node, base + nodesOffset + i * sizeof(FileNode),
+                        sizeof(FileNode));
+
+            // Parents must come first
+            if (!fits(mapping->size(), node.nameOffset, node.nameLength,
+                      1) ||
+                (node.parent != NodeData::NO_PARENT && node.parent >= i)) {
+                return false;
+            }
+
+            glm::mat4 transform;
+            std::memcpy(&transform, node.transform, sizeof(transform));
+            nodeRecords.push_back({
+                    string(reinterpret_cast<char const *>(
+                                   base + node.nameOffset),
+                           node.nameLength),
+                    transform,
+                    node.parent});
+        }
+
+        coldImportMilliseconds = header.importMilliseconds;
+        return true;
+    }();
+
+    if (!loaded) {
+        records.clear();
+        nodeRecords.clear();
+        mapping = nullptr;
+    }
+    return loaded;
+}
+
+void MeshCache::store(vector<MeshData> const &meshes,
+                      vector<NodeData> const &nodes,
+                      float const importMilliseconds) const {
+    SourceKey key;
+    if (!querySource(sourceFilename, key)) {
+        return;
+    }
+    vector<string> const libraries = materialLibraries(sourceFilename);
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''' Lay out blocks
+    FileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.sourceSize = key.size;
+    header.sourceTime = key.time;
+    header.sourceHash = hashFile(sourceFilename);
+    header.importMilliseconds = importMilliseconds;
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.libraryCount = static_cast<uint32_t>(libraries.size());
+
+    vector<FileRecord> fileRecords(meshes.size());
+    vector<FileNode> fileNodes(nodes.size());
+    vector<FileLibrary> fileLibraries(libraries.size());
+    size_t offset = align(sizeof(FileHeader) +
+                          meshes.size() * sizeof(FileRecord) +
+                          nodes.size() * sizeof(FileNode) +
+                          libraries.size() * sizeof(FileLibrary));
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        MeshData const &mesh = meshes[i];
+        FileRecord &record = fileRecords[i];
+        record = {};
+
+        record.vertexOffset = offset;
+        record.vertexCount = static_cast<uint32_t>(mesh.vertexCount);
+        offset = align(offset + mesh.vertexCount * sizeof(Vertex));
+
+        record.indexOffset = offset;
+        record.indexCount = static_cast<uint32_t>(mesh.indexCount);
+        offset = align(offset + mesh.indexCount * sizeof(unsigned int));
+
+        record.lodOffset = offset;
+        record.lodCount = static_cast<uint32_t>(mesh.lodCount);
+        offset = align(offset + mesh.lodCount * sizeof(MeshLod));
+
+        record.materialOffset = offset;
+        record.materialLength =
+                static_cast<uint32_t>(mesh.materialDirectory.size());
+        offset = align(offset + mesh.materialDirectory.size());
+
+        for (int axis = 0; axis < 3; ++axis) {
+            record.boundsMin[axis] = mesh.boundsMin[axis];
+            record.boundsMax[axis] = mesh.boundsMax[axis];
+        }
+        record.boundsRadius = mesh.boundsRadius;
+        record.flags = mesh.twoSided ? RF_TWO_SIDED : 0;
+        record.node = mesh.node;
+
+        MeshOptimizationReport const &report = mesh.optimization;
+        record.vertexCountBefore =
+                static_cast<uint32_t>(report.vertexCountBefore);
+        record.acmrBefore = report.before.acmr;
+        record.acmrAfter = report.after.acmr;
+        record.atvrBefore = report.before.atvr;
+        record.atvrAfter = report.after.atvr;
+    }
+
+    // Names go last
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        FileNode &node = fileNodes[i];
+        node = {};
+        std::memcpy(node.transform, &nodes[i].transform,
+                    sizeof(node.transform));
+        node.parent = nodes[i].parent;
+        node.nameOffset = offset;
+        node.nameLength = static_cast<uint32_t>(nodes[i].name.size());
+        offset = align(offset + nodes[i].name.size());
+    }
+    for (size_t i = 0; i < libraries.size(); ++i) {
+        FileLibrary &library = fileLibraries[i];
+        library = {};
+        SourceKey libraryKey;
+        if (querySource(libraries[i], libraryKey)) {
+            library.size = libraryKey.size;
+            library.time = libraryKey.time;
+            library.hash = hashFile(libraries[i]);
+        } else {
+            library.size = MISSING_LIBRARY;
+        }
+        library.nameOffset = offset;
+        library.nameLength = static_cast<uint32_t>(libraries[i].size());
+        offset = align(offset + libraries[i].size());
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''' Write to disk
+    // Written under a temporary name first, so that an interrupted run
+    // never leaves a truncated cache behind.
+    string const temporaryFilename = cacheFilename + ".tmp";
+    {
+        ofstream file(temporaryFilename, std::ios::binary);
+        if (!file) {
+            return;
+        }
+
+        auto const pad = [&file]() {
+            static char const zeros[ALIGNMENT] = {};
+            auto const position = static_cast<size_t>(file.tellp());
+            file.write(zeros, align(position) - position);
+        };
+
+        file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        file.write(reinterpret_cast<char const *>(fileRecords.data()),
+                   fileRecords.size() * sizeof(FileRecord));
+        file.write(reinterpret_cast<char const *>(fileNodes.data()),
+                   fileNodes.size() * sizeof(FileNode));
+        file.write(reinterpret_cast<char const *>(fileLibraries.data()),
+                   fileLibraries.size() * sizeof(FileLibrary));
+        pad();
+
+        for (MeshData const &mesh : meshes) {
+            file.write(reinterpret_cast<char const *>(mesh.vertices),
+                       mesh.vertexCount * sizeof(Vertex));
+            pad();
+            file.write(reinterpret_cast<char const *>(mesh.indices),
+                       mesh.indexCount * sizeof(unsigned int));
+            pad();
+            file.write(reinterpret_cast<char const *>(mesh.lods),
+                       mesh.lodCount * sizeof(MeshLod));
+            pad();
+            file.write(mesh.materialDirectory.data(),
+                       mesh.materialDirectory.size());
+            pad();
+        }
+        for (NodeData const &node : nodes) {
+            file.write(node.name.data(), node.name.size());
+            pad();
+        }
+        for (string const &library : libraries) {
+            file.write(library.data(), library.size());
+            pad();
+        }
+
+        if (!file) {
+            file.close();
+            std::remove(temporaryFilename.c_str());
+            return;
+        }
+    }
+
+    commitCacheFile(temporaryFilename, cacheFilename);
+}
+
+vector<MeshData> const &MeshCache::meshes() const {
+    return records;
+}
+
+vector<NodeData> const &MeshCache::nodes() const {
+    return nodeRecords;
+}
+
+float MeshCache::importMilliseconds() const {
+    return coldImportMilliseconds;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,78 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "mapped-file.hpp"
+#include "mesh.hpp"
+#include "mesh-optimizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// //////////////////////////////////////////////////// Struct: MeshData //
+// Non-owning view of one processed mesh. When it comes from the cache,
+// the pointers address the memory mapping and stay valid only as long as
+// the MeshCache that produced them.
+struct MeshData {
+    std::string materialDirectory;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    float boundsRadius;
+    bool twoSided;
+    Vertex const *vertices;
+    std::size_t vertexCount;
+    unsigned int const *indices;
+    std::size_t indexCount;         // of every level of detail
+    MeshLod const *lods;
+    std::size_t lodCount;
+    std::uint32_t node;             // the NodeData it hangs off
+    MeshOptimizationReport optimization;    // of the cold import
+};
+
+// //////////////////////////////////////////////////// Struct: NodeData //
+// One node of the model's tree, after every node it may refer to
+struct NodeData {
+    static constexpr std::uint32_t NO_PARENT = ~std::uint32_t(0);
+
+    std::string name;
+    glm::mat4 transform;            // relative to the parent
+    std::uint32_t parent;           // NO_PARENT for Assimp's root node
+};
+
+// //////////////////////////////////////////////////// Class: MeshCache //
+// Versioned binary image of a model after import. The file keeps the
+// final vertex and index arrays, so a warm start maps it and hands the
+// data directly to glBufferData instead of running Assimp again. It is
+// keyed by the source and the material libraries the source names, so
+// editing either one regenerates it.
+class MeshCache {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    explicit MeshCache(std::string const &sourceFilename);
+
+    bool load();
+    void store(std::vector<MeshData> const &meshes,
+               std::vector<NodeData> const &nodes,
+               float const importMilliseconds) const;
+
+    std::vector<MeshData> const &meshes() const;
+    std::vector<NodeData> const &nodes() const;
+    float importMilliseconds() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    std::string const sourceFilename;
+    std::string const cacheFilename;
+
+    std::unique_ptr<MappedFile> mapping;
+    std::vector<MeshData> records;
+    std::vector<NodeData> nodeRecords;
+    float coldImportMilliseconds;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // MESH_CACHE_H
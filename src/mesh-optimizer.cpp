@@ -0,0 +1,368 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "mesh-optimizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::unordered_map;
+using std::vector;
+
+using glm::vec3;
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    // Size of the LRU cache the Forsyth scores are tuned for. Larger than
+    // the FIFO used for reporting, as recommended by the original paper.
+    int const FORSYTH_CACHE_SIZE = 32;
+
+    float forsythScore(int const cachePosition,
+                       unsigned int const activeTriangles) {
+        if (activeTriangles == 0) {
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // The last triangle's vertices get a fixed score so the
+                // next triangle does not simply reuse the same edge
+                score = 0.75f;
+            } else {
+                score = std::pow(1.0f - (cachePosition - 3) /
+                                 static_cast<float>(FORSYTH_CACHE_SIZE - 3),
+                                 1.5f);
+            }
+        }
+
+        // Boost vertices with few remaining triangles to avoid leaving
+        // lone triangles behind
+        return score + 2.0f / std::sqrt(static_cast<float>(activeTriangles));
+    }
+
+    struct VertexHash {
+        size_t operator()(Vertex const &vertex) const {
+            unsigned char const *bytes =
+                    reinterpret_cast<unsigned char const *>(&vertex);
+            size_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); ++i) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct VertexEqual {
+        bool operator()(Vertex const &a, Vertex const &b) const {
+            return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+}
+
+// //////////////////////////////////////////////////////////// Analysis //
+VertexCacheStatistics analyzeVertexCache(vector<unsigned int> const &indices,
+                                         size_t const vertexCount,
+                                         unsigned int const cacheSize) {
+    VertexCacheStatistics statistics = {0.0f, 0.0f};
+    if (indices.empty() || vertexCount == 0) {
+        return statistics;
+    }
+
+    // A vertex is cached while fewer than cacheSize misses happened since
+    // it was inserted, which is exactly the FIFO replacement policy
+    vector<size_t> insertedAt(vertexCount, 0);
+    size_t misses = 0;
+    size_t time = cacheSize + 1;
+    for (unsigned int const index : indices) {
+        if (time - insertedAt[index] > cacheSize) {
+            insertedAt[index] = time++;
+            ++misses;
+        }
+    }
+
+    statistics.acmr = static_cast<float>(misses) / (indices.size() / 3);
+    statistics.atvr = static_cast<float>(misses) / vertexCount;
+    return statistics;
+}
+
+// /////////////////////////////////////////////////// Individual passes //
+void weldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices) {
+    unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> welded;
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        auto const inserted = unique.emplace(
+                vertices[i], static_cast<unsigned int>(welded.size()));
+        if (inserted.second) {
+            welded.push_back(vertices[i]);
+        }
+        remap[i] = inserted.first->second;
+    }
+
+    for (unsigned int &index : indices) {
+        index = remap[index];
+    }
+    vertices = std::move(welded);
+}
+
+void optimizeVertexCache(vector<unsigned int> &indices,
+                         size_t const vertexCount) {
+    size_t const triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Adjacency
+    vector<unsigned int> activeTriangles(vertexCount, 0);
+    for (unsigned int const index : indices) {
+        ++activeTriangles[index];
+    }
+
+    vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] = offsets[v] + activeTriangles[v];
+    }
+
+    vector<unsigned int> adjacency(indices.size());
+    vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            adjacency[fill[indices[3 * t + k]]++] =
+                    static_cast<unsigned int>(t);
+        }
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''''' Initial score
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vertexScore[v] = forsythScore(-1, activeTriangles[v]);
+    }
+
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScore[t] = vertexScore[indices[3 * t]] +
+                           vertexScore[indices[3 * t + 1]] +
+                           vertexScore[indices[3 * t + 2]];
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''' Greedy emission
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    vector<unsigned int> cache, nextCache;
+    size_t cursor = 0;
+    long best = -1;
+
+    while (result.size() < indices.size()) {
+        // Nothing useful in the cache, so restart at the first triangle
+        // that has not been emitted yet
+        if (best < 0) {
+            while (emitted[cursor]) {
+                ++cursor;
+            }
+            best = static_cast<long>(cursor);
+        }
+
+        size_t const triangle = static_cast<size_t>(best);
+        emitted[triangle] = true;
+
+        nextCache.clear();
+        for (int k = 0; k < 3; ++k) {
+            unsigned int const v = indices[3 * triangle + k];
+            result.push_back(v);
+
+            unsigned int *begin = &adjacency[offsets[v]];
+            unsigned int *end = begin + activeTriangles[v];
+            *std::find(begin, end, static_cast<unsigned int>(triangle)) =
+                    *(end - 1);
+            --activeTriangles[v];
+
+            if (std::find(nextCache.begin(), nextCache.end(), v) ==
+                nextCache.end()) {
+                nextCache.push_back(v);
+            }
+        }
+        size_t const emittedCount = nextCache.size();
+        for (unsigned int const v : cache) {
+            if (std::find(nextCache.begin(),
+                          nextCache.begin() + emittedCount, v) ==
+                nextCache.begin() + emittedCount) {
+                nextCache.push_back(v);
+            }
+        }
+
+        // Rescore every vertex whose cache position changed, including
+        // the ones that were just pushed out of the cache
+        for (size_t i = 0; i < nextCache.size(); ++i) {
+            unsigned int const v = nextCache[i];
+            cachePosition[v] =
+                    i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+            float const score =
+                    forsythScore(cachePosition[v], activeTriangles[v]);
+            float const delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            for (size_t j = 0; j < activeTriangles[v]; ++j) {
+                triangleScore[adjacency[offsets[v] + j]] += delta;
+            }
+        }
+        if (nextCache.size() > FORSYTH_CACHE_SIZE) {
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        std::swap(cache, nextCache);
+
+        // Only triangles touching the cache can have changed, so the
+        // next pick is searched among those
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int const v : cache) {
+            for (size_t j = 0; j < activeTriangles[v]; ++j) {
+                unsigned int const t = adjacency[offsets[v] + j];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = static_cast<long>(t);
+                }
+            }
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void optimizeOverdraw(vector<unsigned int> &indices,
+                      vector<Vertex> const &vertices) {
+    size_t const triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Clusters
+    // Split wherever all three vertices of a triangle miss the cache. At
+    // those points the cache is effectively cold anyway, so moving the
+    // runs around leaves the cache efficiency of the order intact.
+    unsigned int const cacheSize = 16;
+    vector<size_t> insertedAt(vertices.size(), 0);
+    size_t time = cacheSize + 1;
+
+    vector<size_t> clusterStarts;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int const v = indices[3 * t + k];
+            if (time - insertedAt[v] > cacheSize) {
+                insertedAt[v] = time++;
+                ++misses;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusterStarts.push_back(t);
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Ordering
+    // Area weighted centroid and normal of each cluster. Clusters facing
+    // away from the mesh centre are likely to occlude the rest.
+    size_t const clusterCount = clusterStarts.size() - 1;
+    vector<vec3> centroids(clusterCount, vec3(0.0f));
+    vector<vec3> normals(clusterCount, vec3(0.0f));
+    vector<float> areas(clusterCount, 0.0f);
+    vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; ++c) {
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            vec3 const &p0 = vertices[indices[3 * t]].position;
+            vec3 const &p1 = vertices[indices[3 * t + 1]].position;
+            vec3 const &p2 = vertices[indices[3 * t + 2]].position;
+
+            vec3 const normal = glm::cross(p1 - p0, p2 - p0);
+            float const area = glm::length(normal);
+
+            centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+    }
+    if (meshArea > 0.0f) {
+        meshCentroid /= meshArea;
+    }
+
+    vector<float> sortKeys(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        if (areas[c] > 0.0f && glm::length(normals[c]) > 0.0f) {
+            vec3 const centroid = centroids[c] / areas[c];
+            sortKeys[c] = glm::dot(centroid - meshCentroid,
+                                   glm::normalize(normals[c]));
+        }
+    }
+
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&sortKeys](size_t const a, size_t const b) {
+                         return sortKeys[a] > sortKeys[b];
+                     });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t const c : order) {
+        result.insert(result.end(),
+                      indices.begin() + 3 * clusterStarts[c],
+                      indices.begin() + 3 * clusterStarts[c + 1]);
+    }
+    indices = std::move(result);
+}
+
+void optimizeVertexFetch(vector<Vertex> &vertices,
+                         vector<unsigned int> &indices) {
+    unsigned int const unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (unsigned int &index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(ordered);
+}
+
+// /////////////////////////////////////////////////// Mesh optimization //
+MeshOptimizationReport optimizeMesh(vector<Vertex> &vertices,
+                                    vector<unsigned int> &indices) {
+    MeshOptimizationReport report;
+    report.vertexCountBefore = vertices.size();
+    report.before = analyzeVertexCache(indices, vertices.size());
+
+    weldVertices(vertices, indices);
+    optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices);
+    optimizeVertexFetch(vertices, indices);
+
+    report.vertexCountAfter = vertices.size();
+    report.after = analyzeVertexCache(indices, vertices.size());
+    return report;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,56 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "mesh.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// /////////////////////////////////////// Struct: VertexCacheStatistics //
+// Average cache miss ratio (misses per triangle) and average transform to
+// vertex ratio (misses per unique vertex) of an index buffer, measured
+// against a simulated FIFO post-transform cache.
+struct VertexCacheStatistics {
+    float acmr;
+    float atvr;
+};
+
+// //////////////////////////////////////////////////////////// Analysis //
+VertexCacheStatistics analyzeVertexCache(
+        std::vector<unsigned int> const &indices,
+        std::size_t const vertexCount,
+        unsigned int const cacheSize = 16);
+
+// /////////////////////////////////////////////////// Individual passes //
+// Merges bitwise identical vertices and rewrites the indices accordingly.
+void weldVertices(std::vector<Vertex> &vertices,
+                  std::vector<unsigned int> &indices);
+
+// Reorders triangles for post-transform cache locality (Forsyth).
+void optimizeVertexCache(std::vector<unsigned int> &indices,
+                         std::size_t const vertexCount);
+
+// Reorders runs of cache-coherent triangles so outward facing runs are
+// drawn first, which lets early depth testing reject more of the rest.
+void optimizeOverdraw(std::vector<unsigned int> &indices,
+                      std::vector<Vertex> const &vertices);
+
+// Renumbers vertices in order of first use and drops unreferenced ones.
+void optimizeVertexFetch(std::vector<Vertex> &vertices,
+                         std::vector<unsigned int> &indices);
+
+// /////////////////////////////////////////////////// Mesh optimization //
+// Runs all passes above in order, returning cache statistics before and
+// after so the import can report them.
+struct MeshOptimizationReport {
+    std::size_t vertexCountBefore;
+    std::size_t vertexCountAfter;
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+};
+
+MeshOptimizationReport optimizeMesh(std::vector<Vertex> &vertices,
+                                    std::vector<unsigned int> &indices);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,490 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "mesh-simplifier.hpp"
+#include "mesh-optimizer.hpp"
+#include "renderable.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::uint64_t;
+using std::unordered_map;
+using std::vector;
+
+using glm::vec2;
+using glm::vec3;
+using glm::vec4;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    // Each level aims at this share of the previous level's triangles
+    float const LEVEL_RATIO = 0.5f;
+
+    // A level that cannot get below this share of the previous one is
+    // not worth its indices, and neither are levels of tiny meshes
+    float const MIN_REDUCTION = 0.85f;
+    size_t const MIN_TRIANGLES = 16;
+
+    // Squared differences of unit normals and of texture coordinates are
+    // weighed like squared distances of this share of the mesh's size
+    double const ATTRIBUTE_WEIGHT = 0.05 * 0.05;
+}
+
+// ///////////////////////////////////////////////////// Struct: Quadric //
+namespace {
+    // Weighted sum of squared distances to a set of planes, as a
+    // symmetric 4x4 matrix; adding quadrics adds their planes
+    struct Quadric {
+        double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+        double weight;
+
+        static Quadric plane(vec3 const &normal, float const distance,
+                             float const weight) {
+            double const x = normal.x, y = normal.y, z = normal.z;
+            double const w = distance;
+            double const k = weight;
+            return {k * x * x, k * x * y, k * x * z, k * x * w, k * y * y,
+                    k * y * z, k * y * w, k * z * z, k * z * w, k * w * w,
+                    k};
+        }
+
+        void add(Quadric const &other) {
+            xx += other.xx; xy += other.xy; xz += other.xz;
+            xw += other.xw; yy += other.yy; yz += other.yz;
+            yw += other.yw; zz += other.zz; zw += other.zw;
+            ww += other.ww;
+            weight += other.weight;
+        }
+
+        // Mean squared distance, so costs stay in squared mesh units no
+        // matter how many planes were gathered; it orders collapses, but
+        // hides a far plane among near ones, so levels measure their
+        // error against the planes themselves
+        double error(vec3 const &point) const {
+            double const x = point.x, y = point.y, z = point.z;
+            double const value =
+                    xx * x * x + yy * y * y + zz * z * z + ww +
+                    2.0 * (xy * x * y + xz * x * z + yz * y * z +
+                           xw * x + yw * y + zw * z);
+            return weight > 0.0 ? std::max(value, 0.0) / weight : 0.0;
+        }
+    };
+}
+
+// /////////////////////////////////////////////////// Class: Simplifier //
+namespace {
+    struct PositionHash {
+        size_t operator()(vec3 const &position) const {
+            unsigned char const *bytes =
+                    reinterpret_cast<unsigned char const *>(&position);
+            size_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(vec3); ++i) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct PositionEqual {
+        bool operator()(vec3 const &a, vec3 const &b) const {
+            return std::memcmp(&a, &b, sizeof(vec3)) == 0;
+        }
+    };
+
+    // Collapses edges over a working copy of the indices, one pass of
+    // independent collapses at a time. Quadrics, the triangles each
+    // vertex stands for and the largest error carry over between calls,
+    // so successive targets make a chain.
+    class Simplifier {
+    public:
+        Simplifier(vector<Vertex> const &vertices,
+                   vector<unsigned int> const &indices)
+                : vertices(vertices),
+                  indices(indices),
+                  quadrics(vertices.size(), Quadric{}),
+                  planes(indices.size() / 3, vec4(0.0f)),
+                  covered(vertices.size()),
+                  positionOwner(vertices.size()),
+                  seam(vertices.size(), false),
+                  maxError(0.0f) {
+            // Vertices that share a position but not their attributes
+            // lie on a seam
+            unordered_map<vec3, unsigned int, PositionHash, PositionEqual>
+                    owners;
+            owners.reserve(vertices.size());
+            for (size_t v = 0; v < vertices.size(); ++v) {
+                auto const inserted = owners.emplace(
+                        vertices[v].position, static_cast<unsigned int>(v));
+                positionOwner[v] = inserted.first->second;
+                if (!inserted.second) {
+                    seam[v] = true;
+                    seam[inserted.first->second] = true;
+                }
+            }
+
+            vec3 boundsMin(0.0f), boundsMax(0.0f);
+            if (!vertices.empty()) {
+                boundsMin = boundsMax = vertices.front().position;
+            }
+            for (Vertex const &vertex : vertices) {
+                boundsMin = glm::min(boundsMin, vertex.position);
+                boundsMax = glm::max(boundsMax, vertex.position);
+            }
+            double const size = glm::length(boundsMax - boundsMin);
+            attributeScale = ATTRIBUTE_WEIGHT * size * size;
+
+            for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+                vec3 const &p0 = vertices[indices[t]].position;
+                vec3 const normal = glm::cross(
+                        vertices[indices[t + 1]].position - p0,
+                        vertices[indices[t + 2]].position - p0);
+                float const length = glm::length(normal);
+                if (length <= 0.0f) {
+                    continue;
+                }
+                // Weighted by area, so slivers do not outvote large faces
+                Quadric const plane = Quadric::plane(
+                        normal / length, -glm::dot(normal / length, p0),
+                        0.5f * length);
+                planes[t / 3] = vec4(normal / length,
+                                     -glm::dot(normal / length, p0));
+                for (int corner = 0; corner < 3; ++corner) {
+                    quadrics[indices[t + corner]].add(plane);
+                    covered[indices[t + corner]].push_back(
+                            static_cast<unsigned int>(t / 3));
+                }
+            }
+        }
+
+        void reduceTo(size_t const targetTriangles) {
+            while (indices.size() / 3 > targetTriangles &&
+                   collapsePass(targetTriangles)) {
+            }
+        }
+
+        vector<unsigned int> const &triangles() const {
+            return indices;
+        }
+
+        // Largest distance any collapse so far moved a vertex from the
+        // plane of a triangle it stood for
+        float error() const {
+            return maxError;
+        }
+
+    private:
+        struct Collapse {
+            unsigned int from;
+            unsigned int to;
+            double cost;
+        };
+
+        // The attribute penalty steers the order of collapses, but only
+        // distances count towards the level's error
+        Collapse collapse(unsigned int const from,
+                          unsigned int const to) const {
+            Vertex const &a = vertices[from];
+            Vertex const &b = vertices[to];
+            vec3 const normal = a.normal - b.normal;
+            vec2 const texCoords = a.texCoords - b.texCoords;
+            return {from, to,
+                    quadrics[from].error(b.position) +
+                    attributeScale * (glm::dot(normal, normal) +
+                                      glm::dot(texCoords, texCoords))};
+        }
+
+        // Farthest the position of to lies from the planes from stood for
+        float distance(unsigned int const from, unsigned int const to) const {
+            vec4 const point(vertices[to].position, 1.0f);
+            float farthest = 0.0f;
+            for (unsigned int const triangle : covered[from]) {
+                farthest = std::max(
+                        farthest, std::abs(glm::dot(planes[triangle], point)));
+            }
+            return farthest;
+        }
+
+        // Seam vertices, and both ends of every edge that is not shared
+        // by exactly two triangles, stay in place
+        void lockVertices() {
+            locked = seam;
+
+            unordered_map<uint64_t, unsigned int> edges;
+            edges.reserve(indices.size());
+            auto const key = [this](unsigned int const a,
+                                    unsigned int const b) {
+                return static_cast<uint64_t>(positionOwner[a]) << 32 |
+                       positionOwner[b];
+            };
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    ++edges[key(indices[t + corner],
+                                indices[t + (corner + 1) % 3])];
+                }
+            }
+
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    unsigned int const a = indices[t + corner];
+                    unsigned int const b = indices[t + (corner + 1) % 3];
+                    auto const reverse = edges.find(key(b, a));
+                    if (edges[key(a, b)] != 1 || reverse == edges.end() ||
+                        reverse->second != 1) {
+                        locked[a] = true;
+                        locked[b] = true;
+                    }
+                }
+            }
+        }
+
+        // Whether moving from onto to turns any of from's remaining
+        // triangles over
+        bool flips(unsigned int const from, unsigned int const to) const {
+            vec3 const &target = vertices[to].position;
+            for (unsigned int k = adjacencyOffsets[from];
+                 k < adjacencyOffsets[from + 1]; ++k) {
+                unsigned int const *triangle = &indices[3 * adjacency[k]];
+                if (triangle[0] == to || triangle[1] == to ||
+                    triangle[2] == to) {
+                    continue;
+                }
+
+                vec3 before[3], after[3];
+                for (int corner = 0; corner < 3; ++corner) {
+                    before[corner] = vertices[triangle[corner]].position;
+                    after[corner] = triangle[corner] == from
+                                    ? target : before[corner];
+                }
+                vec3 const normalBefore = glm::cross(before[1] - before[0],
+                                                     before[2] - before[0]);
+                vec3 const normalAfter = glm::cross(after[1] - after[0],
+                                                    after[2] - after[0]);
+                if (glm::dot(normalBefore, normalAfter) <= 0.0f) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // The distinct positions around position owner, other than
+        // skipped, in ascending order
+        void gatherRing(unsigned int const owner, unsigned int const skipped,
+                        vector<unsigned int> &ring) const {
+            ring.clear();
+            for (unsigned int k = ringOffsets[owner];
+                 k < ringOffsets[owner + 1]; ++k) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    unsigned int const other =
+                            positionOwner[indices[3 * ringTriangles[k] +
+                                                  corner]];
+                    if (other != owner && other != skipped) {
+                        ring.push_back(other);
+                    }
+                }
+            }
+            std::sort(ring.begin(), ring.end());
+            ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+        }
+
+        // The link condition: the ends of an interior edge may only have
+        // its two opposite corners as common neighbours, or collapsing it
+        // pinches the surface into a non-manifold edge or vertex
+        bool keepsManifold(unsigned int const from, unsigned int const to) {
+            unsigned int const a = positionOwner[from];
+            unsigned int const b = positionOwner[to];
+            gatherRing(a, b, fromRing);
+            gatherRing(b, a, toRing);
+
+            size_t shared = 0;
+            auto i = fromRing.begin();
+            auto j = toRing.begin();
+            while (i != fromRing.end() && j != toRing.end()) {
+                if (*i < *j) {
+                    ++i;
+                } else if (*j < *i) {
+                    ++j;
+                } else {
+                    ++shared;
+                    ++i;
+                    ++j;
+                }
+            }
+            return shared <= 2;
+        }
+
+        // Triangles around every vertex, as offsets into a flat list,
+        // with the vertices first mapped through key
+        template <typename Key>
+        void gatherTriangles(Key const &key, vector<unsigned int> &offsets,
+                             vector<unsigned int> &triangles) const {
+            offsets.assign(vertices.size() + 1, 0);
+            for (unsigned int const index : indices) {
+                ++offsets[key(index) + 1];
+            }
+            std::partial_sum(offsets.begin(), offsets.end(),
+                             offsets.begin());
+            triangles.resize(indices.size());
+            vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); ++i) {
+                triangles[cursor[key(indices[i])]++] =
+                        static_cast<unsigned int>(i / 3);
+            }
+        }
+
+        bool collapsePass(size_t const targetTriangles) {
+            size_t const triangleCount = indices.size() / 3;
+            lockVertices();
+
+            // '''''''''''''''''''''''''''''''''''''''''''''''''' Adjacency
+            // By vertex for the flip test, by position for the link
+            // condition, since the far end of an edge may lie on a seam
+            gatherTriangles([](unsigned int const index) { return index; },
+                            adjacencyOffsets, adjacency);
+            gatherTriangles([this](unsigned int const index) {
+                                return positionOwner[index];
+                            },
+                            ringOffsets, ringTriangles);
+
+            // ''''''''''''''''''''''''''''''''''''''''''''''''' Candidates
+            vector<Collapse> collapses;
+            collapses.reserve(indices.size() * 2);
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    unsigned int const a = indices[t + corner];
+                    unsigned int const b = indices[t + (corner + 1) % 3];
+                    if (!locked[a]) {
+                        collapses.push_back(collapse(a, b));
+                    }
+                    if (!locked[b]) {
+                        collapses.push_back(collapse(b, a));
+                    }
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(),
+                      [](Collapse const &a, Collapse const &b) {
+                          return a.cost < b.cost;
+                      });
+
+            // ''''''''''''''''''''''''''''''''''''''''''''''''''' Collapse
+            // Each collapse removes about two triangles. Collapses within
+            // a pass touch disjoint neighbourhoods, by position so that
+            // seams count as one, and the flip test and the link
+            // condition see the triangles as they will be.
+            size_t const budget =
+                    std::max<size_t>((triangleCount - targetTriangles) / 2,
+                                     1);
+            vector<unsigned int> remap(vertices.size());
+            std::iota(remap.begin(), remap.end(), 0u);
+            vector<bool> touched(vertices.size(), false);
+            size_t collapsed = 0;
+            for (Collapse const &candidate : collapses) {
+                if (collapsed >= budget) {
+                    break;
+                }
+                if (touched[positionOwner[candidate.from]] ||
+                    touched[positionOwner[candidate.to]] ||
+                    flips(candidate.from, candidate.to) ||
+                    !keepsManifold(candidate.from, candidate.to)) {
+                    continue;
+                }
+
+                remap[candidate.from] = candidate.to;
+                quadrics[candidate.to].add(quadrics[candidate.from]);
+                maxError = std::max(maxError,
+                                    distance(candidate.from, candidate.to));
+
+                // From is gone; to stands for its triangles from now on
+                vector<unsigned int> &into = covered[candidate.to];
+                vector<unsigned int> &moved = covered[candidate.from];
+                into.insert(into.end(), moved.begin(), moved.end());
+                vector<unsigned int>().swap(moved);
+                for (unsigned int k = adjacencyOffsets[candidate.from];
+                     k < adjacencyOffsets[candidate.from + 1]; ++k) {
+                    for (int corner = 0; corner < 3; ++corner) {
+                        touched[positionOwner[indices[3 * adjacency[k] +
+                                                      corner]]] = true;
+                    }
+                }
+                ++collapsed;
+            }
+            if (collapsed == 0) {
+                return false;
+            }
+
+            // '''''''''''''''''''''''''''''''''''''''''''''''''''' Compact
+            size_t kept = 0;
+            for (size_t t = 0; t < indices.size(); t += 3) {
+                unsigned int const a = remap[indices[t]];
+                unsigned int const b = remap[indices[t + 1]];
+                unsigned int const c = remap[indices[t + 2]];
+                if (a != b && b != c && c != a) {
+                    indices[kept++] = a;
+                    indices[kept++] = b;
+                    indices[kept++] = c;
+                }
+            }
+            indices.resize(kept);
+            return true;
+        }
+
+        vector<Vertex> const &vertices;
+        vector<unsigned int> indices;
+        vector<Quadric> quadrics;
+
+        // Plane of every original triangle, and the triangles whose
+        // surface each vertex now stands in for
+        vector<vec4> planes;
+        vector<vector<unsigned int>> covered;
+
+        // First vertex at each one's position, which stands for all
+        vector<unsigned int> positionOwner;
+        vector<bool> seam;
+        vector<bool> locked;
+
+        vector<unsigned int> adjacencyOffsets;
+        vector<unsigned int> adjacency;
+        vector<unsigned int> ringOffsets;
+        vector<unsigned int> ringTriangles;
+        vector<unsigned int> fromRing;
+        vector<unsigned int> toRing;
+
+        double attributeScale;
+        float maxError;
+    };
+}
+
+// //////////////////////////////////////////////////// Levels of detail //
+vector<MeshLod> generateLods(vector<Vertex> const &vertices,
+                             vector<unsigned int> &indices) {
+    vector<MeshLod> lods = {
+            {0, static_cast<GLsizei>(indices.size()), 0.0f}};
+
+    Simplifier simplifier(vertices, indices);
+    size_t triangles = indices.size() / 3;
+    while (lods.size() < static_cast<size_t>(MAX_LOD_LEVELS) &&
+           triangles >= MIN_TRIANGLES) {
+        simplifier.reduceTo(static_cast<size_t>(triangles * LEVEL_RATIO));
+
+        vector<unsigned int> level = simplifier.triangles();
+        if (level.size() / 3 > triangles * MIN_REDUCTION) {
+            break;
+        }
+        optimizeVertexCache(level, vertices.size());
+
+        lods.push_back({static_cast<GLuint>(indices.size()),
+                        static_cast<GLsizei>(level.size()),
+                        simplifier.error()});
+        indices.insert(indices.end(), level.begin(), level.end());
+        triangles = level.size() / 3;
+    }
+    return lods;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,20 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "mesh.hpp"
+
+#include <vector>
+
+// //////////////////////////////////////////////////// Levels of detail //
+// Simplifies a mesh by quadric edge collapse into up to MAX_LOD_LEVELS
+// levels, each with about half the triangles of the one before. Vertices
+// are only ever collapsed onto neighbours, so every level indexes the
+// same vertex buffer; seams and open borders stay where they are, and
+// differences in normals and texture coordinates add to the cost of a
+// collapse. The coarser levels are appended to indices, and the levels
+// are returned finest first, the full mesh included.
+std::vector<MeshLod> generateLods(std::vector<Vertex> const &vertices,
+                                  std::vector<unsigned int> &indices);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // MESH_SIMPLIFIER_H
@@ -3,76 +3,275 @@
 
 #include "opengl-headers.hpp"
 
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+
 // ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::uint16_t;
 using std::vector;
 using std::shared_ptr;
 
+using glm::mat4;
+using glm::vec3;
+using glm::vec4;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    Uniform<int> const TEX_ORM("texOrm");
+    Uniform<int> const TEX_ALBEDO("texAlbedo");
+    Uniform<int> const TEX_NORMAL("texNormal");
+    Uniform<vec3> const POSITION_SCALE("positionScale");
+    Uniform<vec3> const POSITION_OFFSET("positionOffset");
+    Uniform<mat4> const NODE_TRANSFORM("nodeTransform");
+    Uniform<mat4> const NODE_NORMAL("nodeNormal");
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    vector<CompactVertex> compactVertices(Vertex const *vertices,
+                                          size_t const count,
+                                          vec3 const &offset,
+                                          vec3 const &scale) {
+        vec3 inverseScale(0.0f);
+        for (int axis = 0; axis < 3; ++axis) {
+            if (scale[axis] > 0.0f) {
+                inverseScale[axis] = 1.0f / scale[axis];
+            }
+        }
+
+        vector<CompactVertex> result(count);
+        for (size_t i = 0; i < count; ++i) {
+            Vertex const &vertex = vertices[i];
+            CompactVertex &compact = result[i];
+
+            vec3 const position = glm::clamp(
+                    (vertex.position - offset) * inverseScale, 0.0f, 1.0f);
+            for (int axis = 0; axis < 3; ++axis) {
+                compact.position[axis] = static_cast<uint16_t>(
+                        std::lround(position[axis] * 65535.0f));
+            }
+            compact.position[3] = 0;
+
+            compact.normal = glm::packSnorm3x10_1x2(vec4(vertex.normal, 0.0f));
+            compact.tangent = glm::packSnorm3x10_1x2(vertex.tangent);
+            compact.texCoords = glm::packHalf2x16(vertex.texCoords);
+        }
+        return result;
+    }
+}
+
 // ///////////////////////////////////////////////////////////////////// // 
-Mesh::Mesh(vector<Vertex> const &vertices,
-           vector<unsigned int> const &indices,
-           vector<Texture> const &textures)
-        : vertices(vertices),
-          indices(indices),
-          textures(textures) {
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices)
+        : indexCount(0),
+          indexType(GL_UNSIGNED_INT),
+          bufferBytes(0),
+          format(VF_FULL),
+          positionScale(1.0f),
+          positionOffset(0.0f),
+          nodeTransform(1.0f),
+          nodeNormal(1.0f),
+          vertices(std::move(vertices)),
+          indices(std::move(indices)),
+          twoSided(false),
+          boundsMin(0.0f),
+          boundsMax(0.0f),
+          boundsRadius(0.0f) {
 }
 
 void Mesh::render(shared_ptr<Shader> shader, int instances,
-                  GLuint const overrideTexture) const {
-    shader->use();
-    shader->uniform1i("texAo", 0);
-    shader->uniform1i("texAlbedo", 1);
-    shader->uniform1i("texMetalness", 2);
-    shader->uniform1i("texRoughness", 3);
-    shader->uniform1i("texNormal", 4);
-
-    shader->uniform1i("instances", instances);
-
-    for (int i = 0; i < textures.size(); ++i) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
-    }
+                  GLuint const overrideTexture, int const lod) const {
+    bind(*shader, true);
+    draw(vertexArray.id(), instances, -1, lod);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    glBindVertexArray(vao);
-        glDrawElementsInstanced(GL_TRIANGLES, indices.size(),
-                       GL_UNSIGNED_INT, nullptr, instances);
-    glBindVertexArray(0);
+void Mesh::renderDepth(shared_ptr<Shader> shader, int instances,
+                       int const lod) const {
+    bind(*shader, false);
+    draw(positionArray.id(), instances, -1, lod);
+}
+
+void Mesh::renderIndirect(shared_ptr<Shader> shader, GLintptr command,
+                          GLuint const overrideTexture) const {
+    bind(*shader, true);
+    draw(vertexArray.id(), 0, command, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Mesh::setupMesh() {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+void Mesh::renderDepthIndirect(shared_ptr<Shader> shader,
+                               GLintptr command) const {
+    bind(*shader, false);
+    draw(positionArray.id(), 0, command, 0);
+}
+
+void Mesh::setupBuffers(Vertex const *vertexData, std::size_t vertexCount,
+                        unsigned int const *indexData,
+                        std::size_t indexCount,
+                        VertexFormat const format) {
+    // Coarser levels of detail follow the full one in indexData
+    this->indexCount = lods.empty() ? static_cast<GLsizei>(indexCount)
+                                    : lods.front().indexCount;
+    this->format = format;
 
-    glBindVertexArray(vao); {
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    vertexBuffer = GpuResource(RT_BUFFER, name + " vertices");
+    indexBuffer = GpuResource(RT_BUFFER, name + " indices");
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.id());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
 
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)nullptr);
+    if (format == VF_COMPACT) {
+        // ''''''''''''''''''''''''''''''''''''''''' Quantize within bounds
+        vec3 minimum(0.0f), maximum(0.0f);
+        if (vertexCount > 0) {
+            minimum = maximum = vertexData[0].position;
+        }
+        for (size_t i = 1; i < vertexCount; ++i) {
+            minimum = glm::min(minimum, vertexData[i].position);
+            maximum = glm::max(maximum, vertexData[i].position);
+        }
+        positionOffset = minimum;
+        positionScale = maximum - minimum;
 
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec3)));
+        vector<CompactVertex> const vertices = compactVertices(
+                vertexData, vertexCount, positionOffset, positionScale);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(CompactVertex), vertices.data(), GL_STATIC_DRAW);
+        bufferBytes = vertices.size() * sizeof(CompactVertex);
 
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(2 * sizeof(glm::vec3)));
+        // ''''''''''''''''''''''''''''''''''''''''''''' Narrow the indices
+        if (vertexCount <= std::numeric_limits<uint16_t>::max()) {
+            vector<uint16_t> const indices(indexData, indexData + indexCount);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+            bufferBytes += indices.size() * sizeof(uint16_t);
+            indexType = GL_UNSIGNED_SHORT;
+        } else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+            bufferBytes += indexCount * sizeof(unsigned int);
+            indexType = GL_UNSIGNED_INT;
+        }
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+        bufferBytes = vertexCount * sizeof(Vertex) +
+                      indexCount * sizeof(unsigned int);
+        indexType = GL_UNSIGNED_INT;
+        positionOffset = vec3(0.0f);
+        positionScale = vec3(1.0f);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
+void Mesh::setupVertexArray() {
+    vertexArray = GpuResource(RT_VERTEX_ARRAY, name);
+
+    glBindVertexArray(vertexArray.id()); {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.id());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
+
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
         glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(2 * sizeof(glm::vec3) + sizeof(glm::vec2)));
+
+        if (format == VF_COMPACT) {
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, position));
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, normal));
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, texCoords));
+            glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, tangent));
+        } else {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)nullptr);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec3)));
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(2 * sizeof(glm::vec3)));
+            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(2 * sizeof(glm::vec3) + sizeof(glm::vec2)));
+        }
+    }
+    glBindVertexArray(0);
+
+    // The depth pre-pass fetches nothing but positions
+    positionArray = GpuResource(RT_VERTEX_ARRAY, name + " positions");
+
+    glBindVertexArray(positionArray.id()); {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.id());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id());
+
+        glEnableVertexAttribArray(0);
+
+        if (format == VF_COMPACT) {
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, position));
+        } else {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)nullptr);
+        }
     }
     glBindVertexArray(0);
 }
 
-Mesh::~Mesh() {
-//    for (auto const &texture : textures) {
-//        glDeleteTextures(1, &texture.id);
-//    }
-//    glDeleteBuffers(1, &ebo);
-//    glDeleteBuffers(1, &vbo);
-//    glDeleteVertexArrays(1, &vao);
+void Mesh::releaseCpuData() {
+    vector<Vertex>().swap(vertices);
+    vector<unsigned int>().swap(indices);
+}
+
+void Mesh::bind(Shader &shader, bool const withMaterial) const {
+    shader.use();
+    shader.set(POSITION_SCALE, positionScale);
+    shader.set(POSITION_OFFSET, positionOffset);
+    shader.set(NODE_TRANSFORM, nodeTransform);
+    shader.set(NODE_NORMAL, nodeNormal);
+    if (!withMaterial) {
+        return;
+    }
+
+    shader.set(TEX_ORM, MM_ORM);
+    shader.set(TEX_ALBEDO, MM_ALBEDO);
+    shader.set(TEX_NORMAL, MM_NORMAL);
+    if (material) {
+        for (int map = 0; map < MM_COUNT; ++map) {
+            glActiveTexture(GL_TEXTURE0 + map);
+            glBindTexture(GL_TEXTURE_2D, material->maps[map]->id);
+        }
+    }
+}
+
+void Mesh::draw(GLuint const vertexArray, int const instances,
+                GLintptr const command, int const lod) const {
+    // Culling is switched per frame; two-sided meshes only suspend it
+    bool const suspendCulling = twoSided && glIsEnabled(GL_CULL_FACE);
+    if (suspendCulling) {
+        glDisable(GL_CULL_FACE);
+    }
+
+    glBindVertexArray(vertexArray);
+    if (command < 0) {
+        GLuint firstIndex = 0;
+        GLsizei count = indexCount;
+        if (lod > 0 && !lods.empty()) {
+            MeshLod const &level =
+                    lods[std::min<size_t>(lod, lods.size() - 1)];
+            firstIndex = level.firstIndex;
+            count = level.indexCount;
+        }
+        GLsizeiptr const indexSize =
+                indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t)
+                                               : sizeof(unsigned int);
+        glDrawElementsInstanced(GL_TRIANGLES, count, indexType,
+                                reinterpret_cast<void const *>(
+                                        firstIndex * indexSize),
+                                instances);
+    } else {
+        glDrawElementsIndirect(GL_TRIANGLES, indexType,
+                               reinterpret_cast<void const *>(command));
+    }
+    glBindVertexArray(0);
+
+    if (suspendCulling) {
+        glEnable(GL_CULL_FACE);
+    }
 }
 
 // ///////////////////////////////////////////////////////////////////// // 
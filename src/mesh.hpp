@@ -1,10 +1,14 @@
 #ifndef MESH_H
 #define MESH_H
 // //////////////////////////////////////////////////////////// Includes //
+#include "gpu-resources.hpp"
 #include "shader.hpp"
+#include "texture-registry.hpp"
 
 #include "opengl-headers.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -14,35 +18,107 @@ struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
     glm::vec2 texCoords;
-    glm::vec3 tangent;
+    glm::vec4 tangent;      // w is the bitangent sign
 };
 
-// ///////////////////////////////////////////////////// Struct: Texture //
-struct Texture {
-    GLuint id;
-    std::string filename;
+// ////////////////////////////////////////////////// Enum: VertexFormat //
+enum VertexFormat {
+    VF_FULL,        // Vertex as is, 32-bit indices
+    VF_COMPACT      // CompactVertex, 16-bit indices where they suffice
+};
+
+// /////////////////////////////////////////////// Struct: CompactVertex //
+// 20 byte GPU layout of a Vertex. Positions are 16-bit normalized offsets
+// within the mesh bounds, normals and tangents signed 10_10_10_2 and
+// texture coordinates half floats.
+struct CompactVertex {
+    std::uint16_t position[4];
+    std::uint32_t normal;
+    std::uint32_t tangent;
+    std::uint32_t texCoords;
+};
+
+// ///////////////////////////////////////////////////// Struct: MeshLod //
+// One level of detail: a range of the mesh's indices, which all levels
+// share along with its vertices
+struct MeshLod {
+    GLuint firstIndex;
+    GLsizei indexCount;
+    float error;            // largest deviation it makes, in mesh space
 };
 
 // ///////////////////////////////////////////////////////// Class: Mesh //
 class Mesh {
 public:
+    // Size of a DrawElementsIndirectCommand
+    static constexpr GLintptr INDIRECT_COMMAND_SIZE = 5 * sizeof(GLuint);
 
-    Mesh(std::vector<Vertex> const &vertices,
-         std::vector<unsigned int> const &indices,
-         std::vector<Texture> const &textures);
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
 
-    ~Mesh();
+    // GPU objects have a single owner, so meshes are moved, never copied
+    Mesh(Mesh const &) = delete;
+    Mesh &operator=(Mesh const &) = delete;
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
 
+    // Levels past the coarsest one draw the coarsest one
     void render(std::shared_ptr<Shader> shader, int instances = 1,
-                GLuint const overrideTexture = 0) const;
+                GLuint const overrideTexture = 0, int const lod = 0) const;
+    // Binds no material and fetches positions only
+    void renderDepth(std::shared_ptr<Shader> shader, int instances = 1,
+                     int const lod = 0) const;
+    // The same, with the instance count and index range taken from the
+    // command at the given offset into the bound GL_DRAW_INDIRECT_BUFFER
+    void renderIndirect(std::shared_ptr<Shader> shader, GLintptr command,
+                        GLuint const overrideTexture = 0) const;
+    void renderDepthIndirect(std::shared_ptr<Shader> shader,
+                             GLintptr command) const;
 
 public:
-    void setupMesh();
+    // Buffers are shared between contexts and may be filled on the
+    // streaming context; vertex arrays are not and belong to the one
+    // that renders.
+    void setupBuffers(Vertex const *vertexData, std::size_t vertexCount,
+                      unsigned int const *indexData, std::size_t indexCount,
+                      VertexFormat const format = VF_FULL);
+    void setupVertexArray();
+
+    // Drops the CPU copies once they are on the GPU
+    void releaseCpuData();
+
+    std::string name;
+    GpuResource vertexArray, positionArray, vertexBuffer, indexBuffer;
+    // Of the full level of detail
+    GLsizei indexCount;
+    GLenum indexType;
+    std::size_t bufferBytes;
+
+    // Maps the stored positions back to the mesh's own space
+    VertexFormat format;
+    glm::vec3 positionScale, positionOffset;
+    // And that to model space, from the node the mesh hangs off; normals
+    // take the inverse transpose
+    glm::mat4 nodeTransform, nodeNormal;
 
-    unsigned int vao, vbo, ebo;
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    // Finest first; the indices of every level follow each other
+    std::vector<MeshLod> lods;
+
+    std::string materialDirectory;
+    MaterialHandle material;
+    // Drawn with back-face culling suspended
+    bool twoSided;
+    glm::vec3 boundsMin, boundsMax;
+    // Of the bounding sphere around the centre of the box, usually tighter
+    // than half its diagonal
+    float boundsRadius;
+
+private:
+    void bind(Shader &shader, bool const withMaterial) const;
+    // Direct when command is negative
+    void draw(GLuint const vertexArray, int const instances,
+              GLintptr const command, int const lod) const;
 };
 // ///////////////////////////////////////////////////////////////////// //
 #endif // MESH_H
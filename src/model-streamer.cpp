@@ -0,0 +1,177 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "model-streamer.hpp"
+#include "thread-pool.hpp"
+
+#include <iostream>
+#include <utility>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::exception;
+using std::lock_guard;
+using std::make_shared;
+using std::make_unique;
+using std::mutex;
+using std::shared_ptr;
+using std::size_t;
+using std::string;
+using std::unique_lock;
+using std::unique_ptr;
+using std::vector;
+
+using steadyclock = std::chrono::steady_clock;
+using milliseconds = std::chrono::duration<float, std::milli>;
+
+// //////////////////////////////////////////////// Class: ModelStreamer //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+ModelStreamer::ModelStreamer(GLFWwindow *window)
+        : uploadWindow(nullptr),
+          stopping(false),
+          pending(0) {
+    // The hints from setupGLFW still apply, so both contexts match
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    uploadWindow = glfwCreateWindow(1, 1, "", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (uploadWindow == nullptr) {
+        throw exception("glfwCreateWindow error (streaming context)");
+    }
+
+    uploader = std::thread(&ModelStreamer::upload, this);
+}
+
+ModelStreamer::~ModelStreamer() {
+    {
+        lock_guard<mutex> lock(requestsMutex);
+        stopping = true;
+    }
+    requestAvailable.notify_all();
+    uploader.join();
+
+    for (unique_ptr<Request> const &request : uploaded) {
+        glDeleteSync(request->fence);
+    }
+
+    glfwDestroyWindow(uploadWindow);
+}
+
+shared_ptr<Model> ModelStreamer::load(string const &path,
+                                      VertexFormat const vertexFormat,
+                                      CpuData const cpuData) {
+    auto const model =
+            make_shared<Model>(path, LM_STREAMED, vertexFormat, cpuData);
+
+    auto request = make_unique<Request>();
+    request->model = model;
+    request->fence = nullptr;
+    request->startTime = steadyclock::now();
+    request->prepared = ThreadPool::shared().submit([model]() {
+        model->prepare();
+    });
+
+    {
+        lock_guard<mutex> lock(requestsMutex);
+        queued.push_back(std::move(request));
+    }
+    requestAvailable.notify_one();
+
+    ++pending;
+    return model;
+}
+
+size_t ModelStreamer::update() {
+    vector<unique_ptr<Request>> finished;
+    {
+        lock_guard<mutex> lock(requestsMutex);
+        for (auto it = uploaded.begin(); it != uploaded.end();) {
+            GLenum const status = glClientWaitSync((*it)->fence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED ||
+                status == GL_CONDITION_SATISFIED) {
+                finished.push_back(std::move(*it));
+                it = uploaded.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    size_t resident = 0;
+    for (unique_ptr<Request> const &request : finished) {
+        glDeleteSync(request->fence);
+        --pending;
+
+        // A model that failed to load stays non-resident and is skipped
+        // by rendering; the rest of the scene carries on
+        if (request->error) {
+            try {
+                std::rethrow_exception(request->error);
+            } catch (exception const &error) {
+                cerr << request->model->path << ": not loaded: "
+                     << error.what() << endl;
+            } catch (...) {
+                cerr << request->model->path << ": not loaded" << endl;
+            }
+            continue;
+        }
+
+        // Vertex arrays are not shared between contexts
+        request->model->setupVertexArrays();
+        ++resident;
+
+        milliseconds const residentTime =
+                steadyclock::now() - request->startTime;
+        cout << request->model->path << ": resident after "
+             << residentTime.count() << " ms" << endl;
+    }
+    return resident;
+}
+
+size_t ModelStreamer::pendingCount() const {
+    return pending;
+}
+
+// ============================================== Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+void ModelStreamer::upload() {
+    glfwMakeContextCurrent(uploadWindow);
+
+    while (true) {
+        unique_ptr<Request> request;
+        {
+            unique_lock<mutex> lock(requestsMutex);
+            requestAvailable.wait(lock, [this]() {
+                return stopping || !queued.empty();
+            });
+            if (stopping) {
+                break;
+            }
+            request = std::move(queued.front());
+            queued.pop_front();
+        }
+
+        try {
+            // '''''''''''''''''''''''''''''''''''''''' Wait for the worker
+            request->prepared.get();
+
+            // ''''''''''''''''''''''''''''''''''''''''''' Upload and fence
+            request->model->uploadBuffers();
+        } catch (...) {
+            request->error = std::current_exception();
+        }
+
+        // Flushing puts the fence in the GPU queue, so the main context
+        // can poll it without flushing this one
+        request->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        lock_guard<mutex> lock(requestsMutex);
+        uploaded.push_back(std::move(request));
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+// ///////////////////////////////////////////////////////////////////// //
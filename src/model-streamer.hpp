@@ -0,0 +1,73 @@
+#ifndef MODEL_STREAMER_H
+#define MODEL_STREAMER_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "model.hpp"
+#include "opengl-headers.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// //////////////////////////////////////////////// Class: ModelStreamer //
+// Loads models in the background. Import and decoding run on the thread
+// pool, buffer and texture uploads on a hidden window whose context is
+// shared with the main one, and the main thread only creates the vertex
+// arrays once the upload's fence has signalled.
+class ModelStreamer {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    explicit ModelStreamer(GLFWwindow *window);
+
+    ModelStreamer(ModelStreamer const &) = delete;
+    ModelStreamer &operator=(ModelStreamer const &) = delete;
+
+    ~ModelStreamer();
+
+    // The model is returned at once and stays non-resident until loaded
+    std::shared_ptr<Model> load(
+            std::string const &path,
+            VertexFormat const vertexFormat = VF_COMPACT,
+            CpuData const cpuData = CD_RELEASE);
+
+    // Call once per frame on the main context; returns how many models
+    // became resident
+    std::size_t update();
+
+    std::size_t pendingCount() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    struct Request {
+        std::shared_ptr<Model> model;
+        std::future<void> prepared;
+        GLsync fence;
+        std::exception_ptr error;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    // ------------------------------------------------------- Behaviour --
+    void upload();
+
+    // ------------------------------------------------------------ Data --
+    GLFWwindow *uploadWindow;
+    std::thread uploader;
+
+    std::deque<std::unique_ptr<Request>> queued;
+    std::vector<std::unique_ptr<Request>> uploaded;
+    std::mutex requestsMutex;
+    std::condition_variable requestAvailable;
+    bool stopping;
+
+    std::size_t pending;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // MODEL_STREAMER_H
@@ -1,5 +1,10 @@
 // //////////////////////////////////////////////////////////// Includes //
 #include "model.hpp"
+#include "mesh-cache.hpp"
+#include "mesh-optimizer.hpp"
+#include "mesh-simplifier.hpp"
+#include "tangent-generator.hpp"
+#include "texture-registry.hpp"
 
 #include <glad/glad.h>
 
@@ -10,35 +15,293 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <exception>
+#include <iostream>
 #include <vector>
 #include <memory>
+#include <utility>
 
 // ////////////////////////////////////////////////////////////// Usings //
+using std::cout;
+using std::endl;
 using std::exception;
+using std::size_t;
 using std::string;
 using std::vector;
 using std::shared_ptr;
 
+using glm::mat4;
 using glm::vec2;
 using glm::vec3;
+using glm::vec4;
 
-// ///////////////////////////////////////////////////////////////////// //
-GLuint loadTextureFromFile(string const &filename);
+using steadyclock = std::chrono::steady_clock;
+using milliseconds = std::chrono::duration<float, std::milli>;
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    // Assimp's matrices are row-major
+    mat4 toMat4(aiMatrix4x4 const &m) {
+        return mat4(vec4(m.a1, m.b1, m.c1, m.d1),
+                    vec4(m.a2, m.b2, m.c2, m.d2),
+                    vec4(m.a3, m.b3, m.c3, m.d3),
+                    vec4(m.a4, m.b4, m.c4, m.d4));
+    }
+
+    // Largest factor by which transform stretches a length
+    float maxScale(mat4 const &transform) {
+        return std::sqrt(std::max(
+                glm::dot(vec3(transform[0]), vec3(transform[0])),
+                std::max(glm::dot(vec3(transform[1]), vec3(transform[1])),
+                         glm::dot(vec3(transform[2]), vec3(transform[2])))));
+    }
+
+    // Model-space box around a mesh's box
+    void placeBox(Mesh const &mesh, vec3 &boundsMin, vec3 &boundsMax) {
+        for (int corner = 0; corner < 8; ++corner) {
+            vec3 const point(
+                    (corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+                    (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                    (corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+            vec3 const placed(mesh.nodeTransform * vec4(point, 1.0f));
+            boundsMin = corner == 0 ? placed : glm::min(boundsMin, placed);
+            boundsMax = corner == 0 ? placed : glm::max(boundsMax, placed);
+        }
+    }
+
+    void printOptimization(string const &name,
+                           MeshOptimizationReport const &report) {
+        cout << "    mesh " << name << ": "
+             << report.vertexCountBefore << " -> " << report.vertexCountAfter
+             << " vertices, ACMR " << report.before.acmr << " -> "
+             << report.after.acmr << ", ATVR " << report.before.atvr
+             << " -> " << report.after.atvr << endl;
+    }
+}
 
 // ///////////////////////////////////////////////////////////////////// //
-Model::Model(string const &path) {
-    loadModel(path);
+Model::Model(string const &path, LoadMode const mode,
+             VertexFormat const vertexFormat, CpuData const cpuData)
+        : nodeNames(1),
+          path(path),
+          vertexFormat(vertexFormat),
+          cpuData(cpuData),
+          resident(false) {
+    if (mode == LM_IMMEDIATE) {
+        prepare();
+        uploadBuffers();
+        setupVertexArrays();
+    }
 }
 
 void Model::render(shared_ptr<Shader> shader0, int instances,
-                   GLuint const overrideTexture) const {
+                   GLuint const overrideTexture, int const lod) const {
     for (auto const &mesh : meshes) {
-        mesh.render(shader0, instances, overrideTexture);
+        mesh.render(shader0, instances, overrideTexture, lod);
+    }
+}
+
+void Model::renderDepth(shared_ptr<Shader> shader, int instances,
+                        int const lod) const {
+    for (auto const &mesh : meshes) {
+        mesh.renderDepth(shader, instances, lod);
+    }
+}
+
+int Model::lodCount() const {
+    size_t count = 1;
+    for (auto const &mesh : meshes) {
+        count = std::max(count, mesh.lods.size());
+    }
+    return static_cast<int>(std::min<size_t>(count, MAX_LOD_LEVELS));
+}
+
+float Model::lodError(int const lod) const {
+    float error = 0.0f;
+    for (auto const &mesh : meshes) {
+        if (!mesh.lods.empty()) {
+            size_t const level = std::min<size_t>(lod, mesh.lods.size() - 1);
+            error = std::max(error, mesh.lods[level].error *
+                                    maxScale(mesh.nodeTransform));
+        }
+    }
+    return error;
+}
+
+vector<DrawRange> Model::drawRanges() const {
+    vector<DrawRange> ranges;
+    for (int lod = 0; lod < lodCount(); ++lod) {
+        for (auto const &mesh : meshes) {
+            if (mesh.lods.empty()) {
+                ranges.push_back({0, mesh.indexCount});
+                continue;
+            }
+            MeshLod const &level =
+                    mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)];
+            ranges.push_back({level.firstIndex, level.indexCount});
+        }
+    }
+    return ranges;
+}
+
+void Model::renderIndirect(shared_ptr<Shader> shader, GLintptr commands,
+                           GLuint const overrideTexture) const {
+    for (auto const &mesh : meshes) {
+        mesh.renderIndirect(shader, commands, overrideTexture);
+        commands += Mesh::INDIRECT_COMMAND_SIZE;
+    }
+}
+
+void Model::renderDepthIndirect(shared_ptr<Shader> shader,
+                                GLintptr commands) const {
+    for (auto const &mesh : meshes) {
+        mesh.renderDepthIndirect(shader, commands);
+        commands += Mesh::INDIRECT_COMMAND_SIZE;
+    }
+}
+
+SceneGraph const &Model::nodes() const {
+    return hierarchy;
+}
+
+string const &Model::nodeName(SceneGraph::NodeId const node) const {
+    return nodeNames[node];
+}
+
+void Model::setNodeTransform(SceneGraph::NodeId const node,
+                             mat4 const &transform) {
+    hierarchy.setLocal(node, transform);
+    placeMeshes();
+}
+
+bool Model::boundingBox(vec3 &boundsMin, vec3 &boundsMax) const {
+    if (meshes.empty()) {
+        return false;
+    }
+
+    placeBox(meshes.front(), boundsMin, boundsMax);
+    for (auto const &mesh : meshes) {
+        vec3 meshMin, meshMax;
+        placeBox(mesh, meshMin, meshMax);
+        boundsMin = glm::min(boundsMin, meshMin);
+        boundsMax = glm::max(boundsMax, meshMax);
+    }
+    return true;
+}
+
+// Centred on the box, so the CPU and GPU tests can share one centre
+vec4 Model::boundingSphere() const {
+    vec3 boundsMin, boundsMax;
+    if (!boundingBox(boundsMin, boundsMax)) {
+        return vec4(0.0f, 0.0f, 0.0f, -1.0f);
+    }
+
+    vec3 const center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (auto const &mesh : meshes) {
+        vec3 const meshCenter(mesh.nodeTransform *
+                              vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f,
+                                   1.0f));
+        radius = std::max(radius, glm::length(meshCenter - center) +
+                                  mesh.boundsRadius *
+                                  maxScale(mesh.nodeTransform));
+    }
+    return vec4(center,
+                std::min(radius, glm::length(boundsMax - boundsMin) * 0.5f));
+}
+
+bool Model::isResident() const {
+    return resident;
+}
+
+void Model::prepare() {
+    auto const startTime = steadyclock::now();
+
+    // ' Try the mesh cache
+    stagingCache = std::make_unique<MeshCache>(path);
+    if (stagingCache->load()) {
+        vector<SceneGraph::NodeId> nodeIds;
+        for (NodeData const &node : stagingCache->nodes()) {
+            nodeIds.push_back(hierarchy.add(
+                    node.parent == NodeData::NO_PARENT
+                    ? SceneGraph::ROOT : nodeIds[node.parent],
+                    node.transform));
+            nodeNames.push_back(node.name);
+        }
+
+        for (MeshData const &data : stagingCache->meshes()) {
+            Mesh mesh({}, {});
+            mesh.materialDirectory = data.materialDirectory;
+            mesh.boundsMin = data.boundsMin;
+            mesh.boundsMax = data.boundsMax;
+            mesh.boundsRadius = data.boundsRadius;
+            mesh.twoSided = data.twoSided;
+            mesh.lods.assign(data.lods, data.lods + data.lodCount);
+            if (cpuData == CD_KEEP) {
+                mesh.vertices.assign(data.vertices,
+                                     data.vertices + data.vertexCount);
+                mesh.indices.assign(data.indices,
+                                    data.indices + data.indexCount);
+            }
+            meshes.push_back(std::move(mesh));
+            meshNodes.push_back(nodeIds[data.node]);
+        }
+        staged = stagingCache->meshes();
+
+        milliseconds const loadTime = steadyclock::now() - startTime;
+        cout << path << ": loaded from mesh cache in "
+             << loadTime.count() << " ms (cold import took "
+             << stagingCache->importMilliseconds() << " ms)" << endl;
+        for (size_t i = 0; i < staged.size(); ++i) {
+            printOptimization(nodeNames[meshNodes[i]],
+                              staged[i].optimization);
+        }
+    } else {
+        importModel(path, *stagingCache);
     }
+    placeMeshes();
 }
 
-void Model::loadModel(string const &path) {
+void Model::uploadBuffers() {
+    size_t bufferBytes = 0, fullBytes = 0;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        meshes[i].name = path + "#" + std::to_string(i);
+        meshes[i].setupBuffers(staged[i].vertices, staged[i].vertexCount,
+                               staged[i].indices, staged[i].indexCount,
+                               vertexFormat);
+        bufferBytes += meshes[i].bufferBytes;
+        fullBytes += staged[i].vertexCount * sizeof(Vertex) +
+                     staged[i].indexCount * sizeof(unsigned int);
+    }
+    cout << path << ": geometry takes " << bufferBytes / 1024.0f
+         << " KiB on the GPU (" << fullBytes / 1024.0f
+         << " KiB uncompressed)" << endl;
+    staged.clear();
+    stagingCache = nullptr;
+
+    if (cpuData == CD_RELEASE) {
+        for (Mesh &mesh : meshes) {
+            mesh.releaseCpuData();
+        }
+    }
+
+    loadTextures();
+}
+
+void Model::setupVertexArrays() {
+    for (Mesh &mesh : meshes) {
+        mesh.setupVertexArray();
+    }
+    resident = true;
+}
+
+void Model::importModel(string const &path, MeshCache const &cache) {
+    auto const startTime = steadyclock::now();
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''' Import with Assimp
     Assimp::Importer importer;
 
     aiScene const *scene = importer.ReadFile(path,
@@ -51,29 +314,104 @@ void Model::loadModel(string const &path) {
                          string(importer.GetErrorString())).c_str());
     }
 
-    processNode(scene->mRootNode, scene);
+    processNode(scene->mRootNode, scene, SceneGraph::ROOT);
+
+    milliseconds const importTime = steadyclock::now() - startTime;
+    cout << path << ": imported with Assimp in "
+         << importTime.count() << " ms" << endl;
+
+    // '''''''''''''''''''''''''''''''''''''''''''''' Write the mesh cache
+    // The cache leaves out the hierarchy's root, so its node i is node
+    // i + 1 here
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        Mesh const &mesh = meshes[i];
+        staged.push_back({mesh.materialDirectory,
+                          mesh.boundsMin, mesh.boundsMax, mesh.boundsRadius,
+                          mesh.twoSided,
+                          mesh.vertices.data(), mesh.vertices.size(),
+                          mesh.indices.data(), mesh.indices.size(),
+                          mesh.lods.data(), mesh.lods.size(),
+                          meshNodes[i] - 1,
+                          optimizationReports[i]});
+    }
+    optimizationReports.clear();
+
+    vector<NodeData> nodes;
+    for (SceneGraph::NodeId node = 1; node < hierarchy.size(); ++node) {
+        SceneGraph::NodeId const parent = hierarchy.parent(node);
+        nodes.push_back({nodeNames[node], hierarchy.local(node),
+                         parent == SceneGraph::ROOT ? NodeData::NO_PARENT
+                                                    : parent - 1});
+    }
+    cache.store(staged, nodes, importTime.count());
 }
 
-void Model::processNode(aiNode *node, const aiScene *scene) {
+void Model::loadTextures() {
+    auto const startTime = steadyclock::now();
+
+    TextureRegistry &registry = TextureRegistry::shared();
+
+    vector<string> directories;
+    for (Mesh const &mesh : meshes) {
+        directories.push_back(mesh.materialDirectory);
+    }
+
+    vector<MaterialHandle> const materials =
+            registry.acquireMaterials(directories);
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        meshes[i].material = materials[i];
+    }
+
+    milliseconds const loadTime = steadyclock::now() - startTime;
+    TextureRegistry::Statistics const stats = registry.statistics();
+    cout << "    materials resolved in " << loadTime.count() << " ms ("
+         << stats.hits << " texture hits, " << stats.misses << " misses)"
+         << endl
+         << "    textures: " << stats.residentBytes / (1024.0f * 1024.0f)
+         << " MiB resident, " << stats.uncompressedBytes / (1024.0f * 1024.0f)
+         << " MiB uncompressed, uploads took " << stats.uploadMilliseconds
+         << " ms in total" << endl;
+}
+
+// Meshes used by several nodes are processed once for each, so every
+// copy can be placed on its own
+void Model::processNode(aiNode *node, const aiScene *scene,
+                        SceneGraph::NodeId const parent) {
     if (!node) {
         return;
     }
+    SceneGraph::NodeId const id =
+            hierarchy.add(parent, toMat4(node->mTransformation));
+    nodeNames.push_back(node->mName.C_Str());
+
     for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-        Mesh m = processMesh(scene->mMeshes[node->mMeshes[i]], scene);
+        MeshOptimizationReport report;
+        Mesh m = processMesh(scene->mMeshes[node->mMeshes[i]], scene,
+                             report);
         if (m.vertices.size() > 0) {
-            m.setupMesh();
-            meshes.push_back(m);
+            meshes.push_back(std::move(m));
+            meshNodes.push_back(id);
+            optimizationReports.push_back(report);
         }
     }
     for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, id);
+    }
+}
+
+void Model::placeMeshes() {
+    hierarchy.update();
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        mat4 const &world = hierarchy.world(meshNodes[i]);
+        meshes[i].nodeTransform = world;
+        meshes[i].nodeNormal = glm::transpose(glm::inverse(world));
     }
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
+Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene,
+                        MeshOptimizationReport &report) {
     vector<Vertex> vertices;
     vector<unsigned int> indices;
-    vector<Texture> textures;
 
     for (int i = 0; i < mesh->mNumVertices; ++i) {
         Vertex vertex;
@@ -99,63 +437,79 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
             vertex.texCoords = vec2(0.0f, 0.0f);
         }
 
+        // Welding compares whole vertices, so no member may stay undefined
+        vertex.tangent = vec4(0.0f);
+
         vertices.push_back(vertex);
     }
-    //--------------------
-    for (int i = 0; i < indices.size(); i += 3) {
-        Vertex &v0 = vertices[indices[i]];
-        Vertex &v1 = vertices[indices[i + 1]];
-        Vertex &v2 = vertices[indices[i + 2]];
 
-        vec3 edge1 = v1.position - v0.position;
-        vec3 edge2 = v2.position - v0.position;
+    for (int i = 0; i < mesh->mNumFaces; ++i) {
+        aiFace face = mesh->mFaces[i];
 
-        vec2 delta1 = v1.texCoords - v0.texCoords;
-        vec2 delta2 = v2.texCoords - v0.texCoords;
+        for (int j = 0; j < face.mNumIndices; ++j)
+            indices.push_back(face.mIndices[j]);
+    }
 
-        vec3 tangent = ((delta2.y * edge1 - delta1.y * edge2)
-                        / (delta1.x * delta2.y - delta2.x * delta1.y));
+    report = optimizeMesh(vertices, indices);
+    printOptimization(mesh->mName.C_Str(), report);
 
-        v0.tangent += tangent;
-        v1.tangent += tangent;
-        v2.tangent += tangent;
-    }
+    // Tangents come last, once welding has joined the triangles around
+    // each vertex
+    auto const tangentStart = steadyclock::now();
+    size_t const fallbacks = generateTangents(vertices, indices);
+    milliseconds const tangentTime = steadyclock::now() - tangentStart;
 
-    for (unsigned int i = 0; i < vertices.size(); i++) {
-        vertices[i].tangent /= vertices[i].tangent.length();
-    }
-    //--------------------
+    TangentStatistics const tangents = checkTangents(vertices);
+    cout << "    tangents in " << tangentTime.count() << " ms, max |N.T| "
+         << tangents.maxNormalDot << ", max ||T|-1| "
+         << tangents.maxLengthError << ", " << fallbacks
+         << " without UV gradient" << endl;
 
-    for (int i = 0; i < mesh->mNumFaces; ++i) {
-        aiFace face = mesh->mFaces[i];
+    // Coarser levels only drop triangles, so they come after everything
+    // that changes the vertices
+    auto const lodStart = steadyclock::now();
+    vector<MeshLod> lods = generateLods(vertices, indices);
+    milliseconds const lodTime = steadyclock::now() - lodStart;
 
-        for (int j = 0; j < face.mNumIndices; ++j)
-            indices.push_back(face.mIndices[j]);
+    cout << "    levels of detail in " << lodTime.count() << " ms:";
+    for (MeshLod const &lod : lods) {
+        cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
     }
+    cout << " triangles (error)" << endl;
 
     aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
 
     aiString dirPath;
     material->GetTexture(aiTextureType_AMBIENT, 0, &dirPath);
-    textures.push_back(
-            {loadTextureFromFile(string(dirPath.C_Str()) + "\\ao.jpg"),
-                    string(dirPath.C_Str()) + "\\ao.jpg"});
-    textures.push_back(
-            {loadTextureFromFile(string(dirPath.C_Str()) + "\\albedo.jpg"),
-                    string(dirPath.C_Str()) + "\\albedo.jpg"});
-    textures.push_back({loadTextureFromFile(
-            string(dirPath.C_Str()) + "\\metalness.jpg"),
-                               string(dirPath.C_Str()) +
-                               "\\metalness.jpg"});
-    textures.push_back({loadTextureFromFile(
-            string(dirPath.C_Str()) + "\\roughness.jpg"),
-                               string(dirPath.C_Str()) +
-                               "\\roughness.jpg"});
-    textures.push_back(
-            {loadTextureFromFile(string(dirPath.C_Str()) + "\\normal.jpg"),
-                    string(dirPath.C_Str()) + "\\normal.jpg"});
-
-    return Mesh(vertices, indices, textures);
+
+    Mesh result(std::move(vertices), std::move(indices));
+    result.lods = std::move(lods);
+    result.materialDirectory = dirPath.C_Str();
+
+    // Back faces of open or double-sided surfaces must stay visible
+    int twoSided = 0;
+    material->Get(AI_MATKEY_TWOSIDED, twoSided);
+    result.twoSided = twoSided != 0;
+
+    // Axis-aligned bounds and bounding sphere of the mesh, stored
+    // alongside it in the cache
+    if (!result.vertices.empty()) {
+        result.boundsMin = result.boundsMax = result.vertices.front().position;
+        for (Vertex const &vertex : result.vertices) {
+            result.boundsMin = glm::min(result.boundsMin, vertex.position);
+            result.boundsMax = glm::max(result.boundsMax, vertex.position);
+        }
+
+        vec3 const center = (result.boundsMin + result.boundsMax) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (Vertex const &vertex : result.vertices) {
+            vec3 const offset = vertex.position - center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        result.boundsRadius = std::sqrt(radiusSquared);
+    }
+
+    return result;
 }
 
 // ///////////////////////////////////////////////////////////////////// //
@@ -4,6 +4,8 @@
 #include "shader.hpp"
 #include "mesh.hpp"
 #include "renderable.hpp"
+#include "mesh-cache.hpp"
+#include "scene-graph.hpp"
 
 #include "assimp/scene.h"
 
@@ -11,21 +13,89 @@
 #include <vector>
 #include <memory>
 
+// ////////////////////////////////////////////////////// Enum: LoadMode //
+enum LoadMode {
+    LM_IMMEDIATE,   // load everything in the constructor
+    LM_STREAMED     // leave loading to a ModelStreamer
+};
+
+// /////////////////////////////////////////////////////// Enum: CpuData //
+enum CpuData {
+    CD_RELEASE,     // free vertices and indices once uploaded
+    CD_KEEP         // keep them, e.g. for picking or CPU culling
+};
+
 // //////////////////////////////////////////////////////// Class: Model //
+// Loading runs in three stages so a ModelStreamer can spread them over
+// threads: prepare() on any thread, uploadBuffers() on any context of
+// the share group, setupVertexArrays() on the rendering context.
 class Model : public Renderable {
+    friend class ModelStreamer;
+
 private:
     std::vector<Mesh> meshes;
 
+    // Assimp's node tree below the model's own space; nodeNames is by
+    // node, meshNodes by mesh
+    SceneGraph hierarchy;
+    std::vector<std::string> nodeNames;
+    std::vector<SceneGraph::NodeId> meshNodes;
+    // By mesh, until the cold import is stored
+    std::vector<MeshOptimizationReport> optimizationReports;
+
+    std::string const path;
+    VertexFormat const vertexFormat;
+    CpuData const cpuData;
+    std::unique_ptr<MeshCache> stagingCache;
+    std::vector<MeshData> staged;
+    bool resident;
+
 public:
-    Model(std::string const &path);
+    Model(std::string const &path, LoadMode const mode = LM_IMMEDIATE,
+          VertexFormat const vertexFormat = VF_COMPACT,
+          CpuData const cpuData = CD_RELEASE);
 
     void render(std::shared_ptr<Shader> shader, int instances = 1,
-                GLuint const overrideTexture = 0) const;
-    
+                GLuint const overrideTexture = 0, int const lod = 0) const;
+    void renderDepth(std::shared_ptr<Shader> shader, int instances = 1,
+                     int const lod = 0) const;
+
+    // Meshes with fewer levels repeat their coarsest one
+    int lodCount() const;
+    float lodError(int const lod) const;
+
+    std::vector<DrawRange> drawRanges() const;
+    void renderIndirect(std::shared_ptr<Shader> shader, GLintptr commands,
+                        GLuint const overrideTexture = 0) const;
+    void renderDepthIndirect(std::shared_ptr<Shader> shader,
+                             GLintptr commands) const;
+
+    // Every mesh is placed by the world matrix of the node it hangs off,
+    // which is in model space
+    SceneGraph const &nodes() const;
+    std::string const &nodeName(SceneGraph::NodeId const node) const;
+    // Poses a node once the model is resident; the meshes below follow
+    void setNodeTransform(SceneGraph::NodeId const node,
+                          glm::mat4 const &transform);
+
+    // Around the bounds of all meshes, as placed by their nodes
+    bool boundingBox(glm::vec3 &boundsMin, glm::vec3 &boundsMax) const;
+    glm::vec4 boundingSphere() const;
+
+    bool isResident() const;
+
 private:
-    void loadModel(std::string const &path);
-    void processNode(aiNode *node, const aiScene *scene);
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+    void prepare();
+    void uploadBuffers();
+    void setupVertexArrays();
+
+    void importModel(std::string const &path, MeshCache const &cache);
+    void loadTextures();
+    void placeMeshes();
+    void processNode(aiNode *node, const aiScene *scene,
+                     SceneGraph::NodeId const parent);
+    Mesh processMesh(aiMesh *mesh, const aiScene *scene,
+                     MeshOptimizationReport &report);
 };
 
 // ///////////////////////////////////////////////////////////////////// //
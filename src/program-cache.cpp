@@ -0,0 +1,138 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "program-cache.hpp"
+#include "cache-file.hpp"
+#include "mapped-file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::ofstream;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    char const MAGIC[4] = {'F', 'P', 'P', 'B'};
+
+    // Bump whenever the layout changes
+    uint32_t const VERSION = 2;
+}
+
+// ////////////////////////////////////////////////////// File structure //
+namespace {
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+        float buildMilliseconds;
+        uint32_t reserved;
+    };
+}
+
+// ///////////////////////////////////////////////// Class: ProgramCache //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+ProgramCache::ProgramCache(string const &identity)
+        : cacheFilename(cacheFilenameFor(identity, ".program")),
+          coldBuildMilliseconds(0.0f) {
+}
+
+bool ProgramCache::load(uint64_t const key, GLuint const program) {
+    if (!supported()) {
+        return false;
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''''' Validate header
+    MappedFile const file(cacheFilename);
+    if (!file.valid() || file.size() < sizeof(FileHeader)) {
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, file.data(), sizeof(FileHeader));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION || header.key != key ||
+        header.binaryLength > file.size() - sizeof(FileHeader)) {
+        return false;
+    }
+
+    // ''''''''''''''''''''''''''''''''''''''''''''''''''''' Hand to driver
+    // Drivers may still refuse a binary, e.g. after an update that kept
+    // the version string
+    glProgramBinary(program, header.binaryFormat,
+                    file.data() + sizeof(FileHeader),
+                    static_cast<GLsizei>(header.binaryLength));
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        return false;
+    }
+
+    coldBuildMilliseconds = header.buildMilliseconds;
+    return true;
+}
+
+void ProgramCache::store(uint64_t const key, GLuint const program,
+                         float const buildMilliseconds) const {
+    if (!supported()) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    FileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+    header.binaryFormat = format;
+    header.binaryLength = static_cast<uint32_t>(length);
+    header.buildMilliseconds = buildMilliseconds;
+
+    // Written under a temporary name first, like the mesh cache
+    string const temporaryFilename = cacheFilename + ".tmp";
+    {
+        ofstream file(temporaryFilename, std::ios::binary);
+        if (!file) {
+            return;
+        }
+
+        file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        file.write(binary.data(), length);
+
+        if (!file) {
+            file.close();
+            std::remove(temporaryFilename.c_str());
+            return;
+        }
+    }
+
+    commitCacheFile(temporaryFilename, cacheFilename);
+}
+
+float ProgramCache::buildMilliseconds() const {
+    return coldBuildMilliseconds;
+}
+
+bool ProgramCache::supported() {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
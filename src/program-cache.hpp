@@ -0,0 +1,39 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+#include <cstdint>
+#include <string>
+
+// ///////////////////////////////////////////////// Class: ProgramCache //
+// glGetProgramBinary image of a linked program. Entries are named after
+// the program's stage files; the key stored inside covers the
+// preprocessed sources and the driver, so an edited shader or an updated
+// driver simply misses and the program is compiled again.
+class ProgramCache {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    explicit ProgramCache(std::string const &identity);
+
+    // Loads the binary into program; false if missing, stale or rejected
+    // by the driver, in which case the program must be linked from source
+    bool load(std::uint64_t const key, GLuint const program);
+    void store(std::uint64_t const key, GLuint const program,
+               float const buildMilliseconds) const;
+
+    // Wall time of the whole batch the cached program was built from
+    // source in; its compiles may have overlapped with others
+    float buildMilliseconds() const;
+
+    // At least one binary format, which core profiles may lack
+    static bool supported();
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    std::string const cacheFilename;
+    float coldBuildMilliseconds;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // PROGRAM_CACHE_H
@@ -2,15 +2,75 @@
 #define RENDERABLE_H
 
 #include <memory>
+#include <vector>
 #include "opengl-headers.hpp"
 #include "shader.hpp"
 
+// Levels of detail a renderable may have; the GPU culler picks among at
+// most this many per instance
+constexpr int MAX_LOD_LEVELS = 4;
+
+// Index range of one draw, counted in indices rather than bytes
+struct DrawRange {
+    GLuint firstIndex;
+    GLsizei indexCount;
+};
+
 class Renderable {
 public:
     std::shared_ptr<Shader> shader;
+    // Writes the G-buffer on the deferred path; null keeps the renderable
+    // forward there too
+    std::shared_ptr<Shader> gbufferShader;
+    // Lays down depth in the pre-pass; null leaves the renderable out of
+    // it, so it is shaded with a regular depth test
+    std::shared_ptr<Shader> depthShader;
 
+    // Level 0 is full detail; renderables without levels ignore lod
     virtual void render(std::shared_ptr<Shader> shader, int instances,
-                        GLuint const overrideTexture) const = 0;
+                        GLuint const overrideTexture,
+                        int const lod = 0) const = 0;
+
+    // Positions only; the full draw is correct, just slower
+    virtual void renderDepth(std::shared_ptr<Shader> shader,
+                             int instances, int const lod = 0) const {
+        render(shader, instances, 0, lod);
+    }
+
+    // Levels of detail, finest first, with the largest model-space error
+    // each one makes
+    virtual int lodCount() const { return 1; }
+    virtual float lodError(int const lod) const { return 0.0f; }
+
+    // Index ranges of the draws render issues, in order, for every level
+    // of detail in turn. Renderables that return none are never drawn
+    // indirectly.
+    virtual std::vector<DrawRange> drawRanges() const { return {}; }
+
+    // Like render and renderDepth, but draw i takes its command from the
+    // bound GL_DRAW_INDIRECT_BUFFER at commands + i * 20 bytes; the
+    // commands of each level of detail follow those of the previous one
+    virtual void renderIndirect(std::shared_ptr<Shader> shader,
+                                GLintptr commands,
+                                GLuint const overrideTexture) const {}
+    virtual void renderDepthIndirect(std::shared_ptr<Shader> shader,
+                                     GLintptr commands) const {
+        renderIndirect(shader, commands, 0);
+    }
+
+    // Model-space bounds. False, or a negative sphere radius, means they
+    // are unknown, and such renderables are never culled.
+    virtual bool boundingBox(glm::vec3 &boundsMin,
+                             glm::vec3 &boundsMax) const {
+        return false;
+    }
+    virtual glm::vec4 boundingSphere() const {
+        return glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+    }
+
+    // False while the GPU data is still streaming in
+    virtual bool isResident() const { return true; }
+
     virtual ~Renderable() {}
 };
 
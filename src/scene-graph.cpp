@@ -0,0 +1,99 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "scene-graph.hpp"
+
+#include <algorithm>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::size_t;
+using std::vector;
+
+using glm::mat4;
+
+// /////////////////////////////////////////////////// Class: SceneGraph //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+SceneGraph::SceneGraph()
+        : locals(1, mat4(1.0f)),
+          worlds(1, mat4(1.0f)),
+          parents(1, NO_NODE),
+          firstChildren(1, NO_NODE),
+          nextSiblings(1, NO_NODE),
+          dirty(1, false) {
+}
+
+SceneGraph::NodeId SceneGraph::add(NodeId const parent, mat4 const &local) {
+    NodeId const node = static_cast<NodeId>(locals.size());
+    locals.push_back(local);
+    worlds.push_back(worlds[parent] * local);
+    parents.push_back(parent);
+    firstChildren.push_back(NO_NODE);
+    nextSiblings.push_back(firstChildren[parent]);
+    firstChildren[parent] = node;
+
+    // A dirty parent recomputes its new child along with itself
+    dirty.push_back(false);
+    return node;
+}
+
+void SceneGraph::setLocal(NodeId const node, mat4 const &local) {
+    locals[node] = local;
+    if (!dirty[node]) {
+        dirty[node] = true;
+        dirtyNodes.push_back(node);
+    }
+}
+
+mat4 const &SceneGraph::local(NodeId const node) const {
+    return locals[node];
+}
+
+mat4 const &SceneGraph::world(NodeId const node) const {
+    return worlds[node];
+}
+
+SceneGraph::NodeId SceneGraph::parent(NodeId const node) const {
+    return parents[node];
+}
+
+vector<SceneGraph::NodeId> const &SceneGraph::update() {
+    changedNodes.clear();
+
+    // Parents come first, so a dirty node below another dirty one is
+    // recomputed by its ancestor's walk and skipped here
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+    for (NodeId const top : dirtyNodes) {
+        if (!dirty[top]) {
+            continue;
+        }
+
+        stack.assign(1, top);
+        while (!stack.empty()) {
+            NodeId const node = stack.back();
+            stack.pop_back();
+
+            NodeId const parent = parents[node];
+            worlds[node] = parent == NO_NODE
+                           ? locals[node]
+                           : worlds[parent] * locals[node];
+            dirty[node] = false;
+            changedNodes.push_back(node);
+
+            for (NodeId child = firstChildren[node]; child != NO_NODE;
+                 child = nextSiblings[child]) {
+                stack.push_back(child);
+            }
+        }
+    }
+    dirtyNodes.clear();
+    return changedNodes;
+}
+
+vector<SceneGraph::NodeId> const &SceneGraph::changed() const {
+    return changedNodes;
+}
+
+size_t SceneGraph::size() const {
+    return locals.size();
+}
+
+// ///////////////////////////////////////////////////////////////////// //
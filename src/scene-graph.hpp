@@ -0,0 +1,63 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// /////////////////////////////////////////////////// Class: SceneGraph //
+// Parent/child transforms with cached world matrices. Nodes are never
+// removed and always come after their parents. Setting a local transform
+// only marks the node dirty; update() then recomputes the dirty subtrees
+// and nothing else, so a frame costs as much as what moved in it, however
+// many nodes stand still.
+class SceneGraph {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------------ Data --
+    using NodeId = std::uint32_t;
+
+    // Created with the graph; everything else hangs off it
+    static constexpr NodeId ROOT = 0;
+    // The root's parent, and the end of child lists
+    static constexpr NodeId NO_NODE = ~NodeId(0);
+
+    // ------------------------------------------------------- Behaviour --
+    SceneGraph();
+
+    // The new node's world matrix is current at once, unless one of its
+    // ancestors is waiting for an update
+    NodeId add(NodeId const parent,
+               glm::mat4 const &local = glm::mat4(1.0f));
+
+    void setLocal(NodeId const node, glm::mat4 const &local);
+    glm::mat4 const &local(NodeId const node) const;
+    // As of the last update
+    glm::mat4 const &world(NodeId const node) const;
+    NodeId parent(NodeId const node) const;
+
+    // Returns the nodes whose world matrix was recomputed, parents before
+    // their children; valid until the next update
+    std::vector<NodeId> const &update();
+    std::vector<NodeId> const &changed() const;
+
+    std::size_t size() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------------ Data --
+    // By node
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<NodeId> parents;
+    std::vector<NodeId> firstChildren;
+    std::vector<NodeId> nextSiblings;
+    std::vector<bool> dirty;
+
+    std::vector<NodeId> dirtyNodes;
+    std::vector<NodeId> changedNodes;
+    std::vector<NodeId> stack;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // SCENE_GRAPH_H
@@ -1,18 +1,43 @@
 // //////////////////////////////////////////////////////////// Includes //
 #include "shader.hpp"
+#include "cache-file.hpp"
 #include "opengl-headers.hpp"
+#include "program-cache.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
+#include <vector>
 
 // ////////////////////////////////////////////////////////////// Usings //
 using std::endl;
 using std::exception;
+using std::filesystem::path;
 using std::ifstream;
 using std::ios;
+using std::lock_guard;
+using std::make_shared;
+using std::make_unique;
+using std::mutex;
+using std::set;
+using std::shared_ptr;
 using std::string;
 using std::stringstream;
+using std::to_string;
+using std::uint64_t;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+using steadyclock = std::chrono::steady_clock;
+using milliseconds = std::chrono::duration<float, std::milli>;
 
 // ///////////////////////////////////////////////////////////// Helpers //
 string loadFile(string const &filename) {
@@ -35,7 +60,64 @@ string loadFile(string const &filename) {
     return buffer;
 }
 
-void checkForCompileErrors(int const shader) {
+// Inlines '#include "file"' lines, resolved against the directory of the
+// including file. Every file is inlined once, which also breaks cycles.
+string preprocess(string const &filename, set<string> &included) {
+    path const directory = path(filename).parent_path();
+
+    stringstream source(loadFile(filename));
+    stringstream output;
+    string line;
+    for (int number = 1; getline(source, line); ++number) {
+        size_t const start = line.find_first_not_of(" \t");
+        if (start == string::npos || line.compare(start, 8, "#include") != 0) {
+            output << line << '\n';
+            continue;
+        }
+
+        size_t const open = line.find('"', start);
+        size_t const close = open == string::npos
+                             ? string::npos : line.find('"', open + 1);
+        if (close == string::npos) {
+            throw exception((filename + ":" + to_string(number) +
+                             ": malformed #include").c_str());
+        }
+
+        string const includedFilename =
+                (directory / line.substr(open + 1, close - open - 1))
+                        .lexically_normal().generic_string();
+        if (included.insert(includedFilename).second) {
+            output << preprocess(includedFilename, included);
+        }
+    }
+    return output.str();
+}
+
+string preprocess(string const &filename) {
+    set<string> included = {
+            path(filename).lexically_normal().generic_string()};
+    return preprocess(filename, included);
+}
+
+// Puts a '#define' line per key right after the #version directive,
+// which has to stay first
+string define(string const &source, vector<string> const &defines) {
+    string lines;
+    for (string const &name : defines) {
+        lines += "#define " + name + "\n";
+    }
+
+    size_t const version = source.find("#version");
+    size_t const end = version == string::npos
+                       ? string::npos : source.find('\n', version);
+    if (end == string::npos) {
+        return version == string::npos ? lines + source
+                                       : source + "\n" + lines;
+    }
+    return source.substr(0, end + 1) + lines + source.substr(end + 1);
+}
+
+void checkForCompileErrors(int const shader, string const &filename) {
     int compiledSuccessfully;
 
     constexpr int INFO_LOG_LENGTH = 512;
@@ -47,20 +129,20 @@ void checkForCompileErrors(int const shader) {
         glGetShaderInfoLog(shader, INFO_LOG_LENGTH, nullptr, infoLog);
 
         stringstream message;
-        message << "Failed to compile shader!" << endl
+        message << "Failed to compile shader " << filename << "!" << endl
                 << infoLog;
 
         throw exception(message.str().c_str());
     }
 }
 
+// Status is checked separately, so several programs can be in flight
 void compile(int const shader,
              string const &source) {
     char const *shaderSource = source.c_str();
     glShaderSource(shader, 1, &shaderSource, nullptr);
 
     glCompileShader(shader);
-    checkForCompileErrors(shader);
 }
 
 void checkForLinkingErrors(int const shader) {
@@ -82,82 +164,477 @@ void checkForLinkingErrors(int const shader) {
     }
 }
 
-int link(int const vertex,
-         int const geometry,
-         int const fragment) {
-    int shader = glCreateProgram();
-
-    glAttachShader(shader, vertex);
-    glAttachShader(shader, geometry);
-    glAttachShader(shader, fragment);
+void link(int const shader, vector<int> const &stages) {
+    for (int const stage : stages) {
+        glAttachShader(shader, stage);
+    }
 
+    glProgramParameteri(shader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(shader);
-    checkForLinkingErrors(shader);
+}
+
+namespace {
+    void validate(vector<ShaderStage> const &stages) {
+        if (stages.empty()) {
+            throw exception("Shader without stages");
+        }
+
+        set<GLenum> types;
+        for (ShaderStage const &stage : stages) {
+            if (!types.insert(stage.type).second) {
+                throw exception(("Shader stage given twice: " +
+                                 stage.filename).c_str());
+            }
+        }
+
+        bool const compute = types.count(GL_COMPUTE_SHADER) != 0;
+        if (compute && types.size() > 1) {
+            throw exception("Compute shaders link alone");
+        }
+        if (!compute && types.count(GL_VERTEX_SHADER) == 0) {
+            throw exception(("Shader without a vertex stage: " +
+                             stages.back().filename).c_str());
+        }
+    }
+
+    // Binaries are only valid for the driver that produced them
+    uint64_t hashDriver(uint64_t hash) {
+        for (GLenum const name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            char const *const value =
+                    reinterpret_cast<char const *>(glGetString(name));
+            if (value) {
+                hash = hashBytes(value, std::strlen(value) + 1, hash);
+            }
+        }
+        return hash;
+    }
+
+    // Lets the driver compile on its own threads where it can; a program
+    // is then only waited for when its status is first queried
+    bool enableParallelCompile() {
+        static bool const enabled = []() {
+            using MaxThreads = void (APIENTRYP)(GLuint);
+            char const *const variants[][2] = {
+                    {"GL_KHR_parallel_shader_compile",
+                     "glMaxShaderCompilerThreadsKHR"},
+                    {"GL_ARB_parallel_shader_compile",
+                     "glMaxShaderCompilerThreadsARB"}};
+            for (auto const &variant : variants) {
+                if (!glfwExtensionSupported(variant[0])) {
+                    continue;
+                }
+                auto const maxThreads = reinterpret_cast<MaxThreads>(
+                        glfwGetProcAddress(variant[1]));
+                if (maxThreads) {
+                    // As many as the driver likes
+                    maxThreads(0xFFFFFFFFu);
+                    return true;
+                }
+            }
+            return false;
+        }();
+        return enabled;
+    }
+
+    struct PendingProgram {
+        vector<ShaderStage> stages;
+        unique_ptr<ProgramCache> cache;
+        uint64_t key;
+        int program;
+        vector<int> shaders;
+        bool cached;
+    };
+
+    Shader::BuildStatistics buildCounters = {0, 0, 0.0f, 0.0f, false};
+
+    // Loads the program from the binary cache, or issues its compile and
+    // link without waiting for them
+    PendingProgram startBuild(vector<ShaderStage> const &stages,
+                              vector<string> const &defines) {
+        validate(stages);
+
+        PendingProgram pending;
+        pending.stages = stages;
+
+        // '''''''''''''''''''''''''''''''''''''''''''''''''''''''' Sources
+        string identity;
+        vector<string> sources;
+        uint64_t key = hashDriver(hashBytes(nullptr, 0));
+        for (ShaderStage const &stage : stages) {
+            identity += (identity.empty() ? "" : "+") + stage.filename;
+            sources.push_back(define(preprocess(stage.filename), defines));
+            key = hashBytes(&stage.type, sizeof(stage.type), key);
+            key = hashBytes(sources.back().data(), sources.back().size(),
+                            key);
+        }
+        for (string const &name : defines) {
+            identity += "-" + name;
+        }
+        pending.key = key;
+        pending.cache = make_unique<ProgramCache>(identity);
+        pending.program = glCreateProgram();
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''''''' Binary cache
+        pending.cached = pending.cache->load(key, pending.program);
+        if (pending.cached) {
+            return pending;
+        }
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''' Compile and link
+        // A rejected binary leaves the program unlinked but reusable
+        for (size_t i = 0; i < stages.size(); ++i) {
+            pending.shaders.push_back(glCreateShader(stages[i].type));
+            compile(pending.shaders.back(), sources[i]);
+        }
+        link(pending.program, pending.shaders);
+        return pending;
+    }
+
+    // Waits for the program; it is labelled after its last stage
+    GpuHandle finishBuild(PendingProgram &pending) {
+        if (pending.cached) {
+            ++buildCounters.loaded;
+        } else {
+            try {
+                for (size_t i = 0; i < pending.shaders.size(); ++i) {
+                    checkForCompileErrors(pending.shaders[i],
+                                          pending.stages[i].filename);
+                }
+                checkForLinkingErrors(pending.program);
+            } catch (...) {
+                for (int const stage : pending.shaders) {
+                    glDeleteShader(stage);
+                }
+                glDeleteProgram(pending.program);
+                throw;
+            }
+
+            for (int const stage : pending.shaders) {
+                glDeleteShader(stage);
+            }
+            ++buildCounters.compiled;
+        }
+
+        return GpuResources::shared().adopt(RT_PROGRAM, pending.program,
+                                            pending.stages.back().filename);
+    }
+
+    // Every program is issued before the first one is waited for
+    vector<GpuHandle> build(vector<vector<ShaderStage>> const &programs,
+                            vector<vector<string>> const &defines) {
+        auto const startTime = steadyclock::now();
+        buildCounters.parallel = enableParallelCompile();
+
+        vector<PendingProgram> pending;
+        vector<GpuHandle> handles;
+        try {
+            for (size_t i = 0; i < programs.size(); ++i) {
+                pending.push_back(startBuild(
+                        programs[i],
+                        i < defines.size() ? defines[i] : vector<string>()));
+            }
+            for (PendingProgram &program : pending) {
+                handles.push_back(finishBuild(program));
+            }
+        } catch (...) {
+            for (size_t i = handles.size(); i < pending.size(); ++i) {
+                for (int const stage : pending[i].shaders) {
+                    glDeleteShader(stage);
+                }
+                glDeleteProgram(pending[i].program);
+            }
+            for (GpuHandle const handle : handles) {
+                GpuResources::shared().destroy(handle);
+            }
+            throw;
+        }
+
+        milliseconds const elapsed = steadyclock::now() - startTime;
+        buildCounters.milliseconds += elapsed.count();
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''''''''' Cold time
+        // Compiles overlap under parallel compilation, so a cold build
+        // costs the batch's wall time, not the sum of its programs'. A
+        // batch with cached programs costs at least what theirs did.
+        float coldTime = 0.0f;
+        for (PendingProgram const &built : pending) {
+            if (built.cached) {
+                coldTime = std::max(coldTime,
+                                    built.cache->buildMilliseconds());
+            } else {
+                coldTime = std::max(coldTime, elapsed.count());
+                built.cache->store(built.key, built.program,
+                                   elapsed.count());
+            }
+        }
+        buildCounters.coldMilliseconds += coldTime;
+        return handles;
+    }
+
+    Shader::Statistics counters = {0, 0, 0};
+
+    struct UniformNames {
+        unordered_map<string, unsigned int> ids;
+        vector<string> names;
+        mutex namesMutex;
+    };
+
+    // Handles are usually built during static initialization, so the
+    // table has to exist before any of them asks for it
+    UniformNames &uniformNames() {
+        static UniformNames table;
+        return table;
+    }
+}
+
+// /////////////////////////////////////////////////////// Uniform names //
+unsigned int internUniformName(string const &name) {
+    UniformNames &table = uniformNames();
+    lock_guard<mutex> lock(table.namesMutex);
 
-    return shader;
+    auto const found = table.ids.find(name);
+    if (found != table.ids.end()) {
+        return found->second;
+    }
+
+    unsigned int const id = static_cast<unsigned int>(table.names.size());
+    table.ids.emplace(name, id);
+    table.names.push_back(name);
+    return id;
 }
 
 // /////////////////////////////////////////////////////// Class: Shader //
 // ==================================================== Public interface ==
 // ----------------------------------------------------------- Behaviour --
+Shader::Shader(vector<ShaderStage> const &stages,
+               vector<string> const &defines)
+    : Shader(build({stages}, {defines}).front()) {
+}
+
 Shader::Shader(string const &vertexShaderFilename,
                string const &geometryShaderFilename,
                string const &fragmentShaderFilename)
-    : shader([&]() -> int {
-          int const vertex = glCreateShader(GL_VERTEX_SHADER),
-                    geometry = glCreateShader(GL_GEOMETRY_SHADER),
-                    fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    : Shader({{GL_VERTEX_SHADER, vertexShaderFilename},
+              {GL_GEOMETRY_SHADER, geometryShaderFilename},
+              {GL_FRAGMENT_SHADER, fragmentShaderFilename}}) {
+}
 
-          compile(vertex, loadFile(vertexShaderFilename));
-          compile(geometry, loadFile(geometryShaderFilename));
-          compile(fragment, loadFile(fragmentShaderFilename));
+Shader::Shader(string const &vertexShaderFilename,
+               string const &fragmentShaderFilename)
+    : Shader({{GL_VERTEX_SHADER, vertexShaderFilename},
+              {GL_FRAGMENT_SHADER, fragmentShaderFilename}}) {
+}
 
-          int const shader = link(vertex, geometry, fragment);
+Shader::Shader(string const &computeShaderFilename)
+    : Shader({{GL_COMPUTE_SHADER, computeShaderFilename}}) {
+}
 
-          glDeleteShader(fragment);
-          glDeleteShader(geometry);
-          glDeleteShader(vertex);
+vector<shared_ptr<Shader>> Shader::buildAll(
+        vector<vector<ShaderStage>> const &programs,
+        vector<vector<string>> const &defines) {
+    vector<shared_ptr<Shader>> shaders;
+    for (GpuHandle const handle : build(programs, defines)) {
+        shaders.push_back(shared_ptr<Shader>(new Shader(handle)));
+    }
+    return shaders;
+}
 
-          return shader;
-      }()) {
+void Shader::use() const {
+    glUseProgram(program.id());
 }
 
-Shader::~Shader() {
-    glDeleteProgram(shader);
+void Shader::set(Uniform<int> const &uniform, int const value) {
+    ++counters.handleUpdates;
+    glUniform1i(location(uniform.id), value);
 }
 
-void Shader::use() const {
-    glUseProgram(shader);
+void Shader::set(Uniform<float> const &uniform, float const value) {
+    ++counters.handleUpdates;
+    glUniform1f(location(uniform.id), value);
+}
+
+void Shader::set(Uniform<glm::vec3> const &uniform, glm::vec3 const &value) {
+    ++counters.handleUpdates;
+    glUniform3f(location(uniform.id), value.x, value.y, value.z);
+}
+
+void Shader::set(Uniform<glm::mat4> const &uniform, glm::mat4 const &value) {
+    ++counters.handleUpdates;
+    glUniformMatrix4fv(location(uniform.id), 1, false, &value[0][0]);
 }
 
 void Shader::uniformMatrix4fv(string const &name,
                               float const *value) {
-    glUniformMatrix4fv(
-        glGetUniformLocation(shader, name.c_str()), 1, false, value);
+    glUniformMatrix4fv(location(name), 1, false, value);
 }
 
 void Shader::uniform3f(string const &name,
                        float const a,
                        float const b,
                        float const c) {
-    glUniform3f(
-        glGetUniformLocation(shader, name.c_str()),
-        a, b, c);
+    glUniform3f(location(name), a, b, c);
 }
 
 void Shader::uniform3f(std::string const &name, glm::vec3 const &abc) {
-    glUniform3f(
-            glGetUniformLocation(shader, name.c_str()),
-            abc.x, abc.y, abc.z);
+    glUniform3f(location(name), abc.x, abc.y, abc.z);
 }
 
 
 void Shader::uniform1i(string const &name, int const a) {
-    glUniform1i(
-        glGetUniformLocation(shader, name.c_str()), a);
+    glUniform1i(location(name), a);
 }
 
 void Shader::uniform1f(std::string const &name, float const a) {
-    glUniform1f(
-            glGetUniformLocation(shader, name.c_str()), a);
+    glUniform1f(location(name), a);
+}
+
+Shader::Statistics Shader::statistics() {
+    return counters;
+}
+
+void Shader::resetStatistics() {
+    counters = {0, 0, 0};
+}
+
+Shader::BuildStatistics Shader::buildStatistics() {
+    return buildCounters;
+}
+
+// ============================================= Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+Shader::Shader(GpuHandle const handle)
+    : program(handle) {
+    reflectUniforms();
+    resolveUniformNames();
+}
+
+void Shader::reflectUniforms() {
+    GLuint const id = program.id();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    auto const query = [this, id](string const &name) {
+        ++counters.locationQueries;
+        locations[name] = glGetUniformLocation(id, name.c_str());
+    };
+
+    vector<GLchar> buffer(maxLength + 1);
+    for (GLuint i = 0; i < static_cast<GLuint>(count); ++i) {
+        // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Blocks
+        // Members of uniform blocks have no location of their own
+        GLint block = -1;
+        glGetActiveUniformsiv(id, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block);
+        if (block != -1) {
+            continue;
+        }
+
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(id, i, static_cast<GLsizei>(buffer.size()),
+                           &length, &size, &type, buffer.data());
+        string const name(buffer.data(), length);
+
+        // ''''''''''''''''''''''''''''''''''''''''''''''''''''''''' Arrays
+        // Reported as "name[0]"; every element gets its own entry and the
+        // bare name aliases the first one, as glGetUniformLocation does
+        size_t const bracket = name.rfind("[0]");
+        if (bracket == string::npos || bracket + 3 != name.size()) {
+            query(name);
+            continue;
+        }
+
+        string const base = name.substr(0, bracket);
+        for (GLint element = 0; element < size; ++element) {
+            query(base + "[" + to_string(element) + "]");
+        }
+        locations[base] = locations[name];
+    }
+}
+
+GLint Shader::location(string const &name) const {
+    ++counters.nameLookups;
+    return reflectedLocation(name);
+}
+
+GLint Shader::reflectedLocation(string const &name) const {
+    auto const found = locations.find(name);
+    return found != locations.end() ? found->second : -1;
+}
+
+void Shader::resolveUniformNames() {
+    UniformNames &table = uniformNames();
+    lock_guard<mutex> lock(table.namesMutex);
+
+    for (size_t i = locationsById.size(); i < table.names.size(); ++i) {
+        locationsById.push_back(reflectedLocation(table.names[i]));
+    }
+}
+
+GLint Shader::location(unsigned int const id) {
+    // Names interned after linking are resolved on their first use
+    if (id >= locationsById.size()) {
+        resolveUniformNames();
+    }
+    return locationsById[id];
+}
+
+// /////////////////////////////////////////// Class: ShaderPermutations //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+ShaderPermutations::ShaderPermutations(vector<ShaderStage> const &stages,
+                                       vector<string> const &defines,
+                                       unsigned int const relevant)
+    : stages(stages),
+      defines(defines),
+      relevant(relevant) {
+}
+
+shared_ptr<Shader> const &ShaderPermutations::variant(unsigned int key) {
+    key &= relevant;
+
+    auto found = variants.find(key);
+    if (found == variants.end()) {
+        found = variants.emplace(
+                key, make_shared<Shader>(stages, definesFor(key))).first;
+    }
+    return found->second;
+}
+
+void ShaderPermutations::prepare(vector<unsigned int> const &keys) {
+    vector<unsigned int> missing;
+    vector<vector<string>> missingDefines;
+    for (unsigned int key : keys) {
+        key &= relevant;
+        if (variants.count(key) == 0 &&
+            std::find(missing.begin(), missing.end(), key) == missing.end()) {
+            missing.push_back(key);
+            missingDefines.push_back(definesFor(key));
+        }
+    }
+
+    vector<shared_ptr<Shader>> const built = Shader::buildAll(
+            vector<vector<ShaderStage>>(missing.size(), stages),
+            missingDefines);
+    for (size_t i = 0; i < missing.size(); ++i) {
+        variants.emplace(missing[i], built[i]);
+    }
+}
+
+size_t ShaderPermutations::variantCount() const {
+    return variants.size();
+}
+
+// ============================================= Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+vector<string> ShaderPermutations::definesFor(unsigned int const key) const {
+    vector<string> result;
+    for (size_t bit = 0; bit < defines.size(); ++bit) {
+        if (key & (1u << bit)) {
+            result.push_back(defines[bit]);
+        }
+    }
+    return result;
 }
@@ -1,20 +1,89 @@
 #ifndef SHADER_H
 #define SHADER_H
+#include "gpu-resources.hpp"
+
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 
+// /////////////////////////////////////////////////////// Uniform names //
+// Gives every distinct uniform name a small, process-wide id
+unsigned int internUniformName(std::string const &name);
+
+// ////////////////////////////////////////////////////// Class: Uniform //
+// Typed handle for a uniform name. The string is interned once when the
+// handle is built, so setting a uniform through it is an array lookup in
+// the shader instead of a hash or a glGetUniformLocation call.
+template <typename T>
+class Uniform {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    explicit Uniform(std::string const &name)
+            : id(internUniformName(name)) {
+    }
+
+    // ------------------------------------------------------------ Data --
+    unsigned int const id;
+};
+
+// ///////////////////////////////////////////////// Struct: ShaderStage //
+struct ShaderStage {
+    GLenum type;            // GL_VERTEX_SHADER, GL_COMPUTE_SHADER, ...
+    std::string filename;
+};
+
 // /////////////////////////////////////////////////////// Class: Shader //
+// Active uniforms are reflected once after linking; neither the string
+// nor the handle setters query the driver for locations afterwards.
 class Shader {
 public: // ============================================ Public interface ==
+    // ------------------------------------------------------------ Data --
+    struct Statistics {
+        std::size_t nameLookups;        // uniforms resolved from a string
+        std::size_t locationQueries;    // glGetUniformLocation calls
+        std::size_t handleUpdates;      // uniforms set through a Uniform
+    };
+
+    struct BuildStatistics {
+        std::size_t compiled;           // programs built from source
+        std::size_t loaded;             // programs from the binary cache
+        float milliseconds;             // spent building, all programs
+        float coldMilliseconds;         // the same, had nothing been cached
+        bool parallel;                  // driver compiles in parallel
+    };
+
     // ------------------------------------------------------- Behaviour --
+    // Any pipeline the driver links: graphics stages in any combination
+    // that includes a vertex shader, or a compute shader alone. Every
+    // stage is compiled with a '#define' for each of the given names.
+    explicit Shader(std::vector<ShaderStage> const &stages,
+                    std::vector<std::string> const &defines = {});
+
     Shader(std::string const &vertexShaderFilename,
            std::string const &geometryShaderFilename,
            std::string const &fragmentShaderFilename);
+    Shader(std::string const &vertexShaderFilename,
+           std::string const &fragmentShaderFilename);
+    explicit Shader(std::string const &computeShaderFilename);
 
-    ~Shader();
+    // Issues every compile and link before waiting for any, which lets
+    // drivers with KHR_parallel_shader_compile overlap them. defines[i]
+    // belong to programs[i]; programs past its end get none.
+    static std::vector<std::shared_ptr<Shader>>
+    buildAll(std::vector<std::vector<ShaderStage>> const &programs,
+             std::vector<std::vector<std::string>> const &defines = {});
 
     void use() const;
 
+    void set(Uniform<int> const &uniform, int const value);
+    void set(Uniform<float> const &uniform, float const value);
+    void set(Uniform<glm::vec3> const &uniform, glm::vec3 const &value);
+    void set(Uniform<glm::mat4> const &uniform, glm::mat4 const &value);
+
     void uniformMatrix4fv(std::string const &name,
                           float const *value);
 
@@ -25,9 +94,67 @@ public: // ============================================ Public interface ==
     void uniform1i(std::string const &name, int const a);
     void uniform1f(std::string const &name, float const a);
 
-private: // ===================================== Private implementation == 
+    // Counted over all shaders since the last reset
+    static Statistics statistics();
+    static void resetStatistics();
+
+    // Accumulated since startup
+    static BuildStatistics buildStatistics();
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------- Behaviour --
+    explicit Shader(GpuHandle const handle);
+
+    void reflectUniforms();
+    void resolveUniformNames();
+
+    // Counted as a name lookup; resolving handles uses reflectedLocation
+    // instead, so the count only shows the string setters' lookups
+    GLint location(std::string const &name) const;
+    GLint location(unsigned int const id);
+    GLint reflectedLocation(std::string const &name) const;
+
+    // ------------------------------------------------------------ Data --
+    GpuResource const program;
+
+    std::unordered_map<std::string, GLint> locations;
+    // Indexed by interned name id; -1 for names the program lacks
+    std::vector<GLint> locationsById;
+};
+// /////////////////////////////////////////// Class: ShaderPermutations //
+// Variants of one program, each compiled with the '#define' of every bit
+// set in its key, so settings that hold for a whole draw are resolved by
+// the preprocessor instead of branching in the shader. Variants are built
+// on first use and kept; the program cache makes later runs cheap.
+class ShaderPermutations {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    // Bit i of a key stands for defines[i]; bits outside relevant are
+    // ignored, so programs that do not care share a variant
+    ShaderPermutations(std::vector<ShaderStage> const &stages,
+                       std::vector<std::string> const &defines,
+                       unsigned int const relevant);
+
+    ShaderPermutations(ShaderPermutations const &) = delete;
+    ShaderPermutations &operator=(ShaderPermutations const &) = delete;
+
+    std::shared_ptr<Shader> const &variant(unsigned int const key);
+    // Builds the missing variants among keys in one batch
+    void prepare(std::vector<unsigned int> const &keys);
+
+    std::size_t variantCount() const;
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------- Behaviour --
+    std::vector<std::string> definesFor(unsigned int const key) const;
+
     // ------------------------------------------------------------ Data --
-    int const shader;
+    std::vector<ShaderStage> const stages;
+    std::vector<std::string> const defines;
+    unsigned int const relevant;
+
+    std::unordered_map<unsigned int, std::shared_ptr<Shader>> variants;
 };
+
 // ///////////////////////////////////////////////////////////////////// //
-#endif // SHADER_H
\ No newline at end of file
+#endif // SHADER_H
@@ -0,0 +1,37 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "shading-features.hpp"
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::string;
+using std::vector;
+
+// //////////////////////////////////////////////////// Shading features //
+vector<string> const &shadingFeatureDefines() {
+    static vector<string> const defines = {
+            "LIGHTING_PBR",
+            "DIRECTIONAL_LIGHTS",
+            "POINT_LIGHTS",
+            "SPOT_LIGHTS",
+            "NORMAL_MAPPING"};
+    return defines;
+}
+
+unsigned int lightTypeFeatures(vector<LightData> const &lights) {
+    unsigned int features = 0;
+    for (LightData const &light : lights) {
+        switch (light.type) {
+            case LT_DIRECTIONAL:
+                features |= SF_DIRECTIONAL_LIGHTS;
+                break;
+            case LT_POINT:
+                features |= SF_POINT_LIGHTS;
+                break;
+            case LT_SPOT:
+                features |= SF_SPOT_LIGHTS;
+                break;
+        }
+    }
+    return features;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
@@ -0,0 +1,31 @@
+#ifndef SHADING_FEATURES_H
+#define SHADING_FEATURES_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "light-buffer.hpp"
+
+#include <string>
+#include <vector>
+
+// //////////////////////////////////////////////// Enum: ShadingFeature //
+// Permutation keys of the lit programs; the shaders see them as the
+// defines from shadingFeatureDefines()
+enum ShadingFeature {
+    SF_PBR                  = 1 << 0,   // else Lambert + Blinn-Phong
+    SF_DIRECTIONAL_LIGHTS   = 1 << 1,
+    SF_POINT_LIGHTS         = 1 << 2,
+    SF_SPOT_LIGHTS          = 1 << 3,
+    SF_NORMAL_MAPPING       = 1 << 4,
+
+    SF_LIGHT_TYPES = SF_DIRECTIONAL_LIGHTS | SF_POINT_LIGHTS | SF_SPOT_LIGHTS,
+    SF_ALL = SF_PBR | SF_LIGHT_TYPES | SF_NORMAL_MAPPING
+};
+
+// //////////////////////////////////////////////////// Shading features //
+// Define names in bit order, for ShaderPermutations
+std::vector<std::string> const &shadingFeatureDefines();
+
+// The light type features a light list needs
+unsigned int lightTypeFeatures(std::vector<LightData> const &lights);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // SHADING_FEATURES_H
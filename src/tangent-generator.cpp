@@ -0,0 +1,260 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "tangent-generator.hpp"
+#include "thread-pool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENT_GENERATOR_SSE
+#include <emmintrin.h>
+#endif
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::atomic;
+using std::size_t;
+using std::vector;
+
+using glm::vec3;
+using glm::vec4;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    // Triangles per job; smaller meshes are handled on the calling thread
+    size_t const TRIANGLE_GRAIN = 8192;
+    size_t const VERTEX_GRAIN = 8192;
+
+    float const EPSILON = 1e-12f;
+}
+
+// ///////////////////////////////////////////////////////////// Helpers //
+namespace {
+    // Unnormalized tangent and bitangent of every triangle, as separate
+    // component arrays so the SSE path can store four at once
+    struct TriangleFrames {
+        vector<float> tx, ty, tz;
+        vector<float> bx, by, bz;
+
+        explicit TriangleFrames(size_t const count)
+                : tx(count), ty(count), tz(count),
+                  bx(count), by(count), bz(count) {
+        }
+    };
+
+    void computeFramesScalar(vector<Vertex> const &vertices,
+                             vector<unsigned int> const &indices,
+                             size_t const begin, size_t const end,
+                             TriangleFrames &frames) {
+        for (size_t t = begin; t < end; ++t) {
+            Vertex const &v0 = vertices[indices[3 * t]];
+            Vertex const &v1 = vertices[indices[3 * t + 1]];
+            Vertex const &v2 = vertices[indices[3 * t + 2]];
+
+            vec3 const edge1 = v1.position - v0.position;
+            vec3 const edge2 = v2.position - v0.position;
+            glm::vec2 const delta1 = v1.texCoords - v0.texCoords;
+            glm::vec2 const delta2 = v2.texCoords - v0.texCoords;
+
+            float const determinant =
+                    delta1.x * delta2.y - delta2.x * delta1.y;
+            float const inverse = std::abs(determinant) > EPSILON
+                                  ? 1.0f / determinant : 0.0f;
+
+            vec3 const tangent =
+                    (edge1 * delta2.y - edge2 * delta1.y) * inverse;
+            vec3 const bitangent =
+                    (edge2 * delta1.x - edge1 * delta2.x) * inverse;
+
+            frames.tx[t] = tangent.x;
+            frames.ty[t] = tangent.y;
+            frames.tz[t] = tangent.z;
+            frames.bx[t] = bitangent.x;
+            frames.by[t] = bitangent.y;
+            frames.bz[t] = bitangent.z;
+        }
+    }
+
+#ifdef TANGENT_GENERATOR_SSE
+    void computeFramesSSE(vector<Vertex> const &vertices,
+                          vector<unsigned int> const &indices,
+                          size_t const begin, size_t const end,
+                          TriangleFrames &frames) {
+        size_t t = begin;
+        for (; t + 4 <= end; t += 4) {
+            Vertex const *v[4][3];
+            for (int lane = 0; lane < 4; ++lane) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    v[lane][corner] =
+                            &vertices[indices[3 * (t + lane) + corner]];
+                }
+            }
+
+            // Gather one component of one corner across the four lanes
+            auto const position = [&v](int const corner, int const axis) {
+                return _mm_setr_ps(v[0][corner]->position[axis],
+                                   v[1][corner]->position[axis],
+                                   v[2][corner]->position[axis],
+                                   v[3][corner]->position[axis]);
+            };
+            auto const texCoord = [&v](int const corner, int const axis) {
+                return _mm_setr_ps(v[0][corner]->texCoords[axis],
+                                   v[1][corner]->texCoords[axis],
+                                   v[2][corner]->texCoords[axis],
+                                   v[3][corner]->texCoords[axis]);
+            };
+
+            __m128 edge1[3], edge2[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                __m128 const p0 = position(0, axis);
+                edge1[axis] = _mm_sub_ps(position(1, axis), p0);
+                edge2[axis] = _mm_sub_ps(position(2, axis), p0);
+            }
+
+            __m128 const u0 = texCoord(0, 0), w0 = texCoord(0, 1);
+            __m128 const delta1x = _mm_sub_ps(texCoord(1, 0), u0);
+            __m128 const delta1y = _mm_sub_ps(texCoord(1, 1), w0);
+            __m128 const delta2x = _mm_sub_ps(texCoord(2, 0), u0);
+            __m128 const delta2y = _mm_sub_ps(texCoord(2, 1), w0);
+
+            // Lanes with a degenerate UV mapping contribute nothing
+            __m128 const determinant = _mm_sub_ps(
+                    _mm_mul_ps(delta1x, delta2y),
+                    _mm_mul_ps(delta2x, delta1y));
+            __m128 const magnitude =
+                    _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+            __m128 const usable =
+                    _mm_cmpgt_ps(magnitude, _mm_set1_ps(EPSILON));
+            __m128 const inverse = _mm_and_ps(
+                    usable, _mm_div_ps(_mm_set1_ps(1.0f), determinant));
+
+            __m128 tangent[3], bitangent[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                tangent[axis] = _mm_mul_ps(
+                        _mm_sub_ps(_mm_mul_ps(edge1[axis], delta2y),
+                                   _mm_mul_ps(edge2[axis], delta1y)),
+                        inverse);
+                bitangent[axis] = _mm_mul_ps(
+                        _mm_sub_ps(_mm_mul_ps(edge2[axis], delta1x),
+                                   _mm_mul_ps(edge1[axis], delta2x)),
+                        inverse);
+            }
+
+            _mm_storeu_ps(&frames.tx[t], tangent[0]);
+            _mm_storeu_ps(&frames.ty[t], tangent[1]);
+            _mm_storeu_ps(&frames.tz[t], tangent[2]);
+            _mm_storeu_ps(&frames.bx[t], bitangent[0]);
+            _mm_storeu_ps(&frames.by[t], bitangent[1]);
+            _mm_storeu_ps(&frames.bz[t], bitangent[2]);
+        }
+
+        computeFramesScalar(vertices, indices, t, end, frames);
+    }
+#endif
+
+    // Any unit vector orthogonal to the normal, for vertices whose UVs
+    // give no direction
+    vec3 perpendicular(vec3 const &normal) {
+        vec3 const axis = std::abs(normal.x) < 0.9f ? vec3(1.0f, 0.0f, 0.0f)
+                                                    : vec3(0.0f, 1.0f, 0.0f);
+        return glm::normalize(axis - normal * glm::dot(normal, axis));
+    }
+}
+
+// ////////////////////////////////////////////////// Tangent generation //
+size_t generateTangents(vector<Vertex> &vertices,
+                        vector<unsigned int> const &indices) {
+    size_t const triangleCount = indices.size() / 3;
+    ThreadPool &pool = ThreadPool::shared();
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''' Per-triangle frames
+    TriangleFrames frames(triangleCount);
+    pool.parallelFor(triangleCount, TRIANGLE_GRAIN,
+                     [&](size_t const begin, size_t const end) {
+#ifdef TANGENT_GENERATOR_SSE
+                         computeFramesSSE(vertices, indices, begin, end,
+                                          frames);
+#else
+                         computeFramesScalar(vertices, indices, begin, end,
+                                             frames);
+#endif
+                     });
+
+    // ''''''''''''''''''''''''''''''''''''''' Triangles around each vertex
+    // Gathering per vertex instead of scattering per triangle keeps the
+    // vertex pass free of write conflicts between threads
+    vector<size_t> offsets(vertices.size() + 1, 0);
+    for (unsigned int const index : indices) {
+        ++offsets[index + 1];
+    }
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    vector<unsigned int> adjacency(indices.size());
+    vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''''' Per-vertex frames
+    atomic<size_t> fallbacks(0);
+    pool.parallelFor(vertices.size(), VERTEX_GRAIN,
+                     [&](size_t const begin, size_t const end) {
+        size_t chunkFallbacks = 0;
+        for (size_t v = begin; v < end; ++v) {
+            vec3 tangent(0.0f), bitangent(0.0f);
+            for (size_t i = offsets[v]; i < offsets[v + 1]; ++i) {
+                unsigned int const t = adjacency[i];
+                tangent += vec3(frames.tx[t], frames.ty[t], frames.tz[t]);
+                bitangent += vec3(frames.bx[t], frames.by[t], frames.bz[t]);
+            }
+
+            vec3 normal = vertices[v].normal;
+            float const normalLength = glm::length(normal);
+            normal = normalLength > 0.0f ? normal / normalLength
+                                         : vec3(0.0f, 0.0f, 1.0f);
+
+            // Gram-Schmidt against the normal
+            tangent -= normal * glm::dot(normal, tangent);
+            float const tangentLength = glm::length(tangent);
+            if (tangentLength > 1e-6f) {
+                tangent /= tangentLength;
+            } else {
+                tangent = perpendicular(normal);
+                ++chunkFallbacks;
+            }
+
+            float const handedness =
+                    glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f
+                    ? -1.0f : 1.0f;
+            vertices[v].tangent = vec4(tangent, handedness);
+        }
+        fallbacks += chunkFallbacks;
+    });
+
+    return fallbacks;
+}
+
+// ////////////////////////////////////////////////////////// Validation //
+TangentStatistics checkTangents(vector<Vertex> const &vertices) {
+    TangentStatistics statistics = {0.0f, 0.0f};
+
+    for (Vertex const &vertex : vertices) {
+        vec3 const tangent(vertex.tangent);
+        vec3 const normal = glm::normalize(vertex.normal);
+
+        statistics.maxNormalDot = std::max(statistics.maxNormalDot,
+                                           std::abs(glm::dot(normal, tangent)));
+        statistics.maxLengthError = std::max(
+                statistics.maxLengthError,
+                std::abs(glm::length(tangent) - 1.0f));
+    }
+
+    return statistics;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
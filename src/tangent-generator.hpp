@@ -0,0 +1,32 @@
+#ifndef TANGENT_GENERATOR_H
+#define TANGENT_GENERATOR_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "mesh.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// /////////////////////////////////////////// Struct: TangentStatistics //
+struct TangentStatistics {
+    float maxNormalDot;         // largest |N.T|, zero when orthogonal
+    float maxLengthError;       // largest ||T| - 1|
+};
+
+// ////////////////////////////////////////////////// Tangent generation //
+// Fills Vertex::tangent with a unit tangent orthogonal to the normal and
+// the bitangent sign in w, the bitangent being w * cross(normal,
+// tangent). Each vertex sums the unnormalised frames of its triangles;
+// there is no angle weighting and no vertex splitting, so the result is
+// not MikkTSpace's and maps baked against it may shade slightly apart.
+// Triangle frames are computed four at a time with SSE and split over
+// the thread pool on large meshes.
+// Returns how many vertices had no usable UV gradient and got an
+// arbitrary tangent instead.
+std::size_t generateTangents(std::vector<Vertex> &vertices,
+                             std::vector<unsigned int> const &indices);
+
+// ////////////////////////////////////////////////////////// Validation //
+TangentStatistics checkTangents(std::vector<Vertex> const &vertices);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // TANGENT_GENERATOR_H
@@ -0,0 +1,292 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "texture-registry.hpp"
+#include "compressed-texture.hpp"
+#include "texture.hpp"
+#include "thread-pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <system_error>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::array;
+using std::error_code;
+using std::future;
+using std::lock_guard;
+using std::recursive_mutex;
+using std::shared_ptr;
+using std::size_t;
+using std::string;
+using std::unique_lock;
+using std::unordered_map;
+using std::vector;
+
+namespace filesystem = std::filesystem;
+
+using steadyclock = std::chrono::steady_clock;
+using milliseconds = std::chrono::duration<float, std::milli>;
+
+// /////////////////////////////////////////////////////////// Constants //
+namespace {
+    // A map with channel files is packed from them, one file per channel
+    struct MapLayout {
+        char const *filename;
+        vector<char const *> channels;
+        TextureEncoding encoding;
+    };
+
+    array<MapLayout, MM_COUNT> const MAP_LAYOUTS = {{
+            {"orm", {"ao.jpg", "roughness.jpg", "metalness.jpg"}, TE_BC7},
+            {"albedo.jpg", {}, TE_BC1},
+            {"normal.jpg", {}, TE_BC5}}};
+
+    // Drivers pad RGB8 to four bytes per texel; the mip chain adds a third
+    size_t residentSize(Image const &image) {
+        return static_cast<size_t>(image.width) * image.height * 4 * 4 / 3;
+    }
+}
+
+// ////////////////////////////////////////////// Class: TextureRegistry //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+TextureRegistry &TextureRegistry::shared() {
+    static TextureRegistry registry;
+    return registry;
+}
+
+string TextureRegistry::canonicalPath(string const &filename) {
+    string normalized = filename;
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+    error_code error;
+    filesystem::path const canonical =
+            filesystem::weakly_canonical(normalized, error);
+
+    return error ? normalized : canonical.generic_string();
+}
+
+TextureHandle TextureRegistry::acquireTexture(string const &filename) {
+    string const path = canonicalPath(filename);
+
+    unique_lock<recursive_mutex> lock(registryMutex);
+    auto const cached = textures.find(path);
+    if (cached != textures.end()) {
+        if (TextureHandle texture = cached->second.lock()) {
+            ++stats.hits;
+            return texture;
+        }
+    }
+
+    ++stats.misses;
+    lock.unlock();
+
+    Image const image = decodeImage(path);
+    GLuint const id = uploadTexture(image);
+
+    lock.lock();
+    return track(path, id, image.width, image.height,
+                 residentSize(image), residentSize(image));
+}
+
+MaterialHandle TextureRegistry::acquireMaterial(string const &directory) {
+    return acquireMaterials({directory}).front();
+}
+
+vector<MaterialHandle> TextureRegistry::acquireMaterials(
+        vector<string> const &directories) {
+    ThreadPool &pool = ThreadPool::shared();
+
+    vector<MaterialHandle> result(directories.size());
+    unordered_map<string, shared_ptr<Material>> created;
+    unordered_map<string, future<CompressedImage>> decoding;
+
+    unique_lock<recursive_mutex> lock(registryMutex);
+
+    // ''''''''''''''''''''''''''''''''''''''''''' Resolve or schedule maps
+    for (size_t i = 0; i < directories.size(); ++i) {
+        string const key = canonicalPath(directories[i]);
+
+        auto const cached = materials.find(key);
+        if (cached != materials.end()) {
+            if (MaterialHandle material = cached->second.lock()) {
+                stats.hits += MM_COUNT;
+                result[i] = material;
+                continue;
+            }
+        }
+
+        auto const fresh = created.find(key);
+        if (fresh != created.end()) {
+            stats.hits += MM_COUNT;
+            result[i] = fresh->second;
+            continue;
+        }
+
+        shared_ptr<Material> material(new Material,
+                                      [this](Material const *material) {
+                                          release(material);
+                                      });
+        material->directory = key;
+        created[key] = material;
+        result[i] = material;
+
+        for (int map = 0; map < MM_COUNT; ++map) {
+            MapLayout const &layout = MAP_LAYOUTS[map];
+            string const path = key + "/" + layout.filename;
+
+            auto const texture = textures.find(path);
+            if (texture != textures.end()) {
+                if ((material->maps[map] = texture->second.lock())) {
+                    ++stats.hits;
+                    continue;
+                }
+            }
+
+            if (decoding.count(path) != 0) {
+                ++stats.hits;
+                continue;
+            }
+
+            ++stats.misses;
+            if (layout.channels.empty()) {
+                decoding[path] = pool.submit([path, layout]() {
+                    return loadCompressedImage(path, layout.encoding);
+                });
+            } else {
+                vector<string> sources;
+                for (char const *channel : layout.channels) {
+                    sources.push_back(key + "/" + channel);
+                }
+                decoding[path] = pool.submit([path, sources, layout]() {
+                    return loadPackedImage(sources, path, layout.encoding);
+                });
+            }
+        }
+    }
+
+    // '''''''''''''''''''''''''''''''''''''''''''''''' Upload decoded maps
+    lock.unlock();
+
+    unordered_map<string, TextureHandle> loaded;
+    for (auto &entry : decoding) {
+        CompressedImage const image = entry.second.get();
+
+        auto const startTime = steadyclock::now();
+        GLuint const id = uploadCompressedTexture(image);
+        milliseconds const uploadTime = steadyclock::now() - startTime;
+
+        lock_guard<recursive_mutex> guard(registryMutex);
+        stats.uploadMilliseconds += uploadTime.count();
+        loaded[entry.first] = track(entry.first, id,
+                                    image.levels.front().width,
+                                    image.levels.front().height,
+                                    image.size(), image.uncompressedSize());
+    }
+
+    lock.lock();
+    for (auto &entry : created) {
+        Material &material = *entry.second;
+        for (int map = 0; map < MM_COUNT; ++map) {
+            if (!material.maps[map]) {
+                material.maps[map] = loaded.at(
+                        material.directory + "/" + MAP_LAYOUTS[map].filename);
+            }
+        }
+        materials[entry.first] = entry.second;
+    }
+
+    return result;
+}
+
+TextureRegistry::Statistics TextureRegistry::statistics() const {
+    lock_guard<recursive_mutex> lock(registryMutex);
+    return stats;
+}
+
+float TextureRegistry::measureUncompressedUploads() {
+    lock_guard<recursive_mutex> lock(registryMutex);
+
+    // Upload time does not depend on the texels, so blank images of the
+    // same size stand in for the decoded files
+    float total = 0.0f;
+    for (auto const &entry : textures) {
+        TextureHandle const texture = entry.second.lock();
+        if (!texture) {
+            continue;
+        }
+
+        Image const image{texture->width, texture->height, 3,
+                          {static_cast<unsigned char *>(std::calloc(
+                                   static_cast<size_t>(texture->width) *
+                                           texture->height, 3)),
+                           std::free}};
+
+        auto const startTime = steadyclock::now();
+        GLuint const id = uploadTexture(image);
+        milliseconds const uploadTime = steadyclock::now() - startTime;
+
+        glDeleteTextures(1, &id);
+        total += uploadTime.count();
+    }
+
+    stats.uncompressedUploadMilliseconds = total;
+    return total;
+}
+
+// ============================================== Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+TextureRegistry::TextureRegistry()
+        : stats{0, 0, 0, 0, 0, 0.0f, 0.0f} {
+}
+
+TextureHandle TextureRegistry::track(string const &path, GLuint const id,
+                                     int const width, int const height,
+                                     size_t const bytes,
+                                     size_t const uncompressedBytes) {
+    GpuHandle const handle =
+            GpuResources::shared().adopt(RT_TEXTURE, id, path);
+    TextureHandle texture(new GpuTexture{id, handle, path, width, height,
+                                         bytes, uncompressedBytes},
+                          [this](GpuTexture const *texture) {
+                              release(texture);
+                          });
+    textures[path] = texture;
+
+    ++stats.residentTextures;
+    stats.residentBytes += bytes;
+    stats.uncompressedBytes += uncompressedBytes;
+
+    return texture;
+}
+
+void TextureRegistry::release(GpuTexture const *texture) {
+    GpuResources::shared().destroy(texture->handle);
+
+    lock_guard<recursive_mutex> lock(registryMutex);
+    --stats.residentTextures;
+    stats.residentBytes -= texture->bytes;
+    stats.uncompressedBytes -= texture->uncompressedBytes;
+
+    auto const entry = textures.find(texture->path);
+    if (entry != textures.end() && entry->second.expired()) {
+        textures.erase(entry);
+    }
+
+    delete texture;
+}
+
+void TextureRegistry::release(Material const *material) {
+    lock_guard<recursive_mutex> lock(registryMutex);
+    auto const entry = materials.find(material->directory);
+    if (entry != materials.end() && entry->second.expired()) {
+        materials.erase(entry);
+    }
+
+    // Drops the maps, which may release textures in turn
+    delete material;
+}
+
+// ///////////////////////////////////////////////////////////////////// //
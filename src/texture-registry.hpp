@@ -0,0 +1,115 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "gpu-resources.hpp"
+#include "opengl-headers.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ////////////////////////////////////////////////// Struct: GpuTexture //
+// Texture object shared by every user of the same file. It is deleted
+// from the GPU as soon as the last handle to it is released.
+struct GpuTexture {
+    GLuint id;
+    GpuHandle handle;
+    std::string path;
+    int width;
+    int height;
+    std::size_t bytes;
+    std::size_t uncompressedBytes;
+};
+
+using TextureHandle = std::shared_ptr<GpuTexture const>;
+
+// /////////////////////////////////////////////////// Enum: MaterialMap //
+enum MaterialMap {
+    MM_ORM,     // ambient occlusion, roughness, metalness in R, G, B
+    MM_ALBEDO,
+    MM_NORMAL,
+    MM_COUNT
+};
+
+// //////////////////////////////////////////////////// Struct: Material //
+// Set of PBR maps stored in one directory, indexed by MaterialMap, which
+// is also the texture unit each map is bound to. The three grayscale
+// maps are packed into one ORM texture at import and stored as BC7, so
+// the channels keep 8-bit endpoints and barely bleed into each other.
+// Albedo is BC1, the normal map BC5 (X and Y only).
+struct Material {
+    std::string directory;
+    std::array<TextureHandle, MM_COUNT> maps;
+};
+
+using MaterialHandle = std::shared_ptr<Material const>;
+
+// ////////////////////////////////////////////// Class: TextureRegistry //
+// Deduplicates textures and materials by canonical path. The registry
+// only keeps weak references, so resources live exactly as long as the
+// meshes using them. It may be used from the streaming thread while the
+// main thread renders; the lock is not held while images decode.
+class TextureRegistry {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------------ Data --
+    struct Statistics {
+        std::size_t hits;
+        std::size_t misses;
+        std::size_t residentTextures;
+        std::size_t residentBytes;
+        std::size_t uncompressedBytes;
+        float uploadMilliseconds;
+        // Of the last measureUncompressedUploads()
+        float uncompressedUploadMilliseconds;
+    };
+
+    // ------------------------------------------------------- Behaviour --
+    TextureRegistry(TextureRegistry const &) = delete;
+    TextureRegistry &operator=(TextureRegistry const &) = delete;
+
+    static TextureRegistry &shared();
+
+    static std::string canonicalPath(std::string const &filename);
+
+    TextureHandle acquireTexture(std::string const &filename);
+    MaterialHandle acquireMaterial(std::string const &directory);
+    std::vector<MaterialHandle> acquireMaterials(
+            std::vector<std::string> const &directories);
+
+    Statistics statistics() const;
+
+    // Times uploading every resident texture the way it was before block
+    // compression (RGB8 and glGenerateMipmap), for comparison with
+    // uploadMilliseconds. Only the cost is kept; the copies are deleted.
+    float measureUncompressedUploads();
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------- Behaviour --
+    TextureRegistry();
+
+    TextureHandle track(std::string const &path, GLuint const id,
+                        int const width, int const height,
+                        std::size_t const bytes,
+                        std::size_t const uncompressedBytes);
+    void release(GpuTexture const *texture);
+    void release(Material const *material);
+
+    // ------------------------------------------------------------ Data --
+    std::unordered_map<std::string, std::weak_ptr<GpuTexture const>>
+            textures;
+    std::unordered_map<std::string, std::weak_ptr<Material const>>
+            materials;
+
+    Statistics stats;
+
+    // Recursive because dropping a handle inside a locked section may
+    // run release() on the same thread
+    mutable std::recursive_mutex registryMutex;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // TEXTURE_REGISTRY_H
@@ -0,0 +1,86 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "texture.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::exception;
+using std::string;
+
+// ///////////////////////////////////////////////////////////// Loading //
+Image decodeImage(string const &filename) {
+    // Load texture from file
+    int imageWidth, imageHeight, imageNumberOfChannels;
+    unsigned char *textureData = stbi_load(
+        filename.c_str(),
+        &imageWidth, &imageHeight,
+        &imageNumberOfChannels, 0);
+
+    if (textureData == nullptr) {
+        throw exception(("Failed to load texture " + filename + "!").c_str());
+    }
+
+    // Flip rows in place instead of relying on the process-wide
+    // stbi_set_flip_vertically_on_load, which is not thread-safe
+    int const rowSize = imageWidth * imageNumberOfChannels;
+    for (int row = 0; row < imageHeight / 2; ++row) {
+        std::swap_ranges(textureData + row * rowSize,
+                         textureData + (row + 1) * rowSize,
+                         textureData + (imageHeight - 1 - row) * rowSize);
+    }
+
+    return {imageWidth, imageHeight, imageNumberOfChannels,
+            {textureData, stbi_image_free}};
+}
+
+GLuint uploadTexture(Image const &image) {
+    // Generate OpenGL resource
+    GLuint texture;
+    glGenTextures(1, &texture);
+
+    // Setup the texture
+    glBindTexture(GL_TEXTURE_2D, texture);
+    {
+        // Set texture parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // Rows of 1- and 3-channel images are not 4-byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        // Pass image to OpenGL
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
+                     image.width, image.height, 0,
+                     [&]() -> GLenum {
+                         switch (image.channels) {
+                             case 1:
+                                 return GL_RED;
+                             case 3:
+                                 return GL_RGB;
+                             case 4:
+                                 return GL_RGBA;
+                             default:
+                                 return GL_RGB;
+                         }
+                     }(),
+                     GL_UNSIGNED_BYTE, image.pixels.get());
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        // Generate mipmap for loaded texture
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    // Return texture's ID
+    return texture;
+}
+
+GLuint loadTextureFromFile(string const &filename) {
+    return uploadTexture(decodeImage(filename));
+}
+
+// ///////////////////////////////////////////////////////////////////// //
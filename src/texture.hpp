@@ -0,0 +1,29 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+// //////////////////////////////////////////////////////////// Includes //
+#include "opengl-headers.hpp"
+
+#include <memory>
+#include <string>
+
+// /////////////////////////////////////////////////////// Struct: Image //
+// Decoded 8-bit image, rows stored bottom-up as OpenGL expects them.
+struct Image {
+    int width;
+    int height;
+    int channels;
+    std::unique_ptr<unsigned char, void (*)(void *)> pixels;
+};
+
+// ///////////////////////////////////////////////////////////// Loading //
+// Safe to call from worker threads; it never touches stb_image's global
+// flip setting and never issues OpenGL calls.
+Image decodeImage(std::string const &filename);
+
+// Must be called on the thread owning the OpenGL context.
+GLuint uploadTexture(Image const &image);
+
+GLuint loadTextureFromFile(std::string const &filename);
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // TEXTURE_H
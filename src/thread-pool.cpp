@@ -0,0 +1,117 @@
+// //////////////////////////////////////////////////////////// Includes //
+#include "thread-pool.hpp"
+
+#include <algorithm>
+#include <memory>
+
+// ////////////////////////////////////////////////////////////// Usings //
+using std::atomic;
+using std::condition_variable;
+using std::function;
+using std::lock_guard;
+using std::make_shared;
+using std::mutex;
+using std::size_t;
+using std::thread;
+using std::unique_lock;
+
+// /////////////////////////////////////////////////// Class: ThreadPool //
+// ==================================================== Public interface ==
+// ----------------------------------------------------------- Behaviour --
+ThreadPool::ThreadPool(unsigned int const threadCount)
+        : stopping(false) {
+    for (unsigned int i = 0; i < std::max(threadCount, 1u); ++i) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(jobsMutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (thread &worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool(thread::hardware_concurrency());
+    return pool;
+}
+
+unsigned int ThreadPool::size() const {
+    return static_cast<unsigned int>(workers.size());
+}
+
+void ThreadPool::parallelFor(size_t const count, size_t const grain,
+                             function<void(size_t, size_t)> const &body) {
+    size_t const chunkSize = std::max<size_t>(grain, 1);
+    size_t const chunks = (count + chunkSize - 1) / chunkSize;
+    if (chunks <= 1) {
+        if (count > 0) {
+            body(0, count);
+        }
+        return;
+    }
+
+    // Helpers that only start after the loop finished find no chunk left
+    // and never touch body, so it may safely go out of scope by then
+    struct Loop {
+        atomic<size_t> next{0};
+        atomic<size_t> done{0};
+        mutex doneMutex;
+        condition_variable finished;
+    };
+    auto const loop = make_shared<Loop>();
+
+    auto const run = [loop, chunks, chunkSize, count, &body]() {
+        size_t chunk;
+        while ((chunk = loop->next++) < chunks) {
+            size_t const begin = chunk * chunkSize;
+            body(begin, std::min(count, begin + chunkSize));
+
+            if (++loop->done == chunks) {
+                lock_guard<mutex> lock(loop->doneMutex);
+                loop->finished.notify_all();
+            }
+        }
+    };
+
+    size_t const helpers = std::min<size_t>(size(), chunks - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        submit(run);
+    }
+    run();
+
+    unique_lock<mutex> lock(loop->doneMutex);
+    loop->finished.wait(lock, [&loop, chunks]() {
+        return loop->done == chunks;
+    });
+}
+
+// ============================================== Private implementation ==
+// ----------------------------------------------------------- Behaviour --
+void ThreadPool::work() {
+    while (true) {
+        function<void()> job;
+        {
+            unique_lock<mutex> lock(jobsMutex);
+            jobAvailable.wait(lock, [this]() {
+                return stopping || !jobs.empty();
+            });
+
+            if (jobs.empty()) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+        job();
+    }
+}
+
+// ///////////////////////////////////////////////////////////////////// //
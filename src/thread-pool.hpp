@@ -0,0 +1,69 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+// //////////////////////////////////////////////////////////// Includes //
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// /////////////////////////////////////////////////// Class: ThreadPool //
+// Fixed set of worker threads draining a FIFO of jobs. Only CPU work
+// belongs here; everything touching OpenGL stays on the context thread.
+class ThreadPool {
+public: // ============================================ Public interface ==
+    // ------------------------------------------------------- Behaviour --
+    explicit ThreadPool(unsigned int const threadCount);
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    ~ThreadPool();
+
+    static ThreadPool &shared();
+
+    unsigned int size() const;
+
+    template <typename Function>
+    auto submit(Function &&function) -> std::future<decltype(function())> {
+        using Result = decltype(function());
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(
+                std::forward<Function>(function));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+            jobs.push([task]() { (*task)(); });
+        }
+        jobAvailable.notify_one();
+
+        return result;
+    }
+
+    // Runs body over [0, count) in chunks of grain items, on the pool and
+    // on the calling thread. The caller never waits for a queued job, so
+    // this is safe to use from inside a job. Body must not throw.
+    void parallelFor(
+            std::size_t const count, std::size_t const grain,
+            std::function<void(std::size_t, std::size_t)> const &body);
+
+private: // ===================================== Private implementation ==
+    // ------------------------------------------------------- Behaviour --
+    void work();
+
+    // ------------------------------------------------------------ Data --
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex jobsMutex;
+    std::condition_variable jobAvailable;
+    bool stopping;
+};
+
+// ///////////////////////////////////////////////////////////////////// //
+#endif // THREAD_POOL_H